@@ -0,0 +1,58 @@
+// File: ballBench.cpp
+
+// Speed of the many-ball simulation of manyBalls (ballPhysics.h): for
+// growing numbers of balls, in a box grown with them so the balls are
+// always as crowded as 2000 balls in manyBalls' box, it reports the time of
+// a step, the number of balls simulated per millisecond, and how many
+// ball pairs the uniform grid tests for contact, against the n (n - 1) / 2
+// that testing every pair would take.
+// Usage: ballBench [steps]   (default 200)
+// Build: g++ -O2 -std=c++11 ballBench.cpp -o ballBench
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/ballPhysics.h"
+#include <chrono>
+#include <cstdlib>
+
+//----------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+double
+msSince( Clock::time_point start )
+{
+    return std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+}
+
+int
+main( int argc, char **argv )
+{
+    int steps = (argc >= 2) ? atoi( argv[1] ) : 200;
+    if ( steps < 1 ) {
+	fprintf( stderr, "usage: ballBench [steps], steps >= 1\n" );
+	return 1;
+    }
+    const int warmUp = 20;               // steps before timing, to mix the balls
+    const int sizes[] = { 500, 2000, 8000, 32000, 128000 };
+
+    printf( "%8s %10s %12s %14s %12s %10s\n", "balls", "ms/step", "balls/ms",
+	    "pairs/step", "of all pairs", "contacts" );
+    for ( int s = 0; s < (int) (sizeof(sizes) / sizeof(sizes[0])); s++ ) {
+	int n = sizes[s];
+	GLfloat grow = pow( n / 2000.0, 1.0 / 3.0 );
+	BallSystem balls( n, 0.02, 0.04, 0.875 * grow, 1.0 * grow, 0.5 * grow );
+	for ( int i = 0; i < warmUp; i++ ) balls.step();
+
+	balls.resetCounts();
+	Clock::time_point start = Clock::now();
+	for ( int i = 0; i < steps; i++ ) balls.step();
+	double ms = msSince( start ) / steps;
+
+	double pairs = (double) balls.numPairsTested() / steps;
+	double allPairs = 0.5 * n * (n - 1.0);
+	printf( "%8d %10.3f %12.0f %14.0f %11.4f%% %10.1f\n", n, ms, n / ms,
+		pairs, 100.0 * pairs / allPairs,
+		(double) balls.numContacts() / steps );
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+// File: globeBench.cpp
+
+// Benchmark of globe generation at high tessellation, comparing the vertex
+// grid computed with sin/cos for every (row, i) pair, as globe() used to,
+// against the shared ring tables, and timing the full soup and indexed
+// globe() calls.
+// Usage: globeBench [longDivs latDivs [repeats]]   (default 1024 512 10)
+// Build: g++ -O2 -std=c++11 globeBench.cpp -o globeBench
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/holeyShapes.h"
+#include <chrono>
+#include <cstdlib>
+
+//----------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+double
+msSince( Clock::time_point start )
+{
+    return std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+}
+
+//  The vertex grid between the poles with trig for every vertex
+void
+gridPerVertexTrig( int longDivs, int latDivs, point4 *vertices )
+{
+    const GLfloat longAngleDiv = 2 * M_PI / longDivs;
+    const GLfloat latAngleDiv  = M_PI / latDivs;
+    for ( int row = 1; row < latDivs; row++ ) {
+	GLfloat latAngle = row * latAngleDiv;
+	GLfloat latCos = cos(latAngle);
+	GLfloat latSin = sin(latAngle);
+	for ( int i = 0; i < longDivs; i++ ) {
+	    GLfloat longAngle = i * longAngleDiv;
+	    vertices[(row-1) * longDivs + i] =
+		point4( latSin * cos(longAngle), latCos, latSin * sin(longAngle), 1.0 );
+	}
+    }
+}
+
+//  The same grid from the ring tables
+void
+gridRingTables( int longDivs, int latDivs, point4 *vertices )
+{
+    const RingTable longRing = ringTable( longDivs );
+    const RingTable latRing  = ringTable( 2 * latDivs );
+    for ( int row = 1; row < latDivs; row++ ) {
+	GLfloat latCos = latRing.cosines[row];
+	GLfloat latSin = latRing.sines[row];
+	point4 *rowVertices = vertices + (row-1) * longDivs;
+	for ( int i = 0; i < longDivs; i++ ) {
+	    rowVertices[i] = point4( latSin * longRing.cosines[i], latCos,
+				     latSin * longRing.sines[i], 1.0 );
+	}
+    }
+}
+
+int
+main( int argc, char **argv )
+{
+    int longDivs = (argc >= 3) ? atoi( argv[1] ) : 1024;
+    int latDivs  = (argc >= 3) ? atoi( argv[2] ) : 512;
+    int repeats  = (argc >= 4) ? atoi( argv[3] ) : 10;
+    if ( longDivs < 3 || latDivs < 2 || repeats < 1 ) {
+	fprintf( stderr, "usage: globeBench [longDivs latDivs [repeats]]\n" );
+	return 1;
+    }
+
+    const int numGrid     = longDivs * (latDivs - 1);
+    const int numVertices = 2 + numGrid;
+    const int numPoints   = 6 * numGrid;
+    point4 *grid     = new point4[numGrid];
+    point4 *points   = new point4[numPoints];
+    point4 *vertices = new point4[numVertices];
+    GLuint *indices  = new GLuint[numPoints];
+
+    // first calls build the ring tables and the scratch arena
+    globe( longDivs, latDivs, points, 0 );
+    globe( longDivs, latDivs, vertices, 0, indices, 0 );
+
+    double trigMs = 0.0, tableMs = 0.0, soupMs = 0.0, indexedMs = 0.0;
+    for ( int r = 0; r < repeats; r++ ) {
+	Clock::time_point start = Clock::now();
+	gridPerVertexTrig( longDivs, latDivs, grid );
+	trigMs += msSince( start );
+
+	start = Clock::now();
+	gridRingTables( longDivs, latDivs, grid );
+	tableMs += msSince( start );
+
+	start = Clock::now();
+	globe( longDivs, latDivs, points, 0 );
+	soupMs += msSince( start );
+
+	start = Clock::now();
+	globe( longDivs, latDivs, vertices, 0, indices, 0 );
+	indexedMs += msSince( start );
+    }
+
+    printf( "globe %d x %d: %d grid vertices, %d triangles\n",
+	    longDivs, latDivs, numGrid, numPoints / 3 );
+    printf( "%-28s %10s\n", "", "ms" );
+    printf( "%-28s %10.3f\n", "grid, sin/cos per vertex",   trigMs / repeats );
+    printf( "%-28s %10.3f\n", "grid, ring tables",          tableMs / repeats );
+    printf( "%-28s %10.3f\n", "globe(), triangle soup",     soupMs / repeats );
+    printf( "%-28s %10.3f\n", "globe(), indexed",           indexedMs / repeats );
+
+    delete [] grid;
+    delete [] points;
+    delete [] vertices;
+    delete [] indices;
+    return 0;
+}
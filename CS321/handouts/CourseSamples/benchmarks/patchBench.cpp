@@ -0,0 +1,89 @@
+// File: patchBench.cpp
+
+// Benchmark for divide_patches in bezier.h; tessellates a set of random
+// Bezier patches on 1, 2, ... N threads, checks that every run produces
+// exactly the same bytes as divide_patch called on each patch in turn,
+// and reports the time and speedup for each thread count.
+// Usage: patchBench [numPatches [subdivisions]]   (default 32 patches, 6)
+// Build: g++ -O2 -std=c++11 -pthread patchBench.cpp -o patchBench
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/bezier.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+//----------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+double
+msSince( Clock::time_point start )
+{
+    return std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+}
+
+//----------------------------------------------------------------------------
+
+int
+main( int argc, char **argv )
+{
+    int numPatches   = (argc >= 2) ? atoi( argv[1] ) : 32;
+    int subdivisions = (argc >= 3) ? atoi( argv[2] ) : 6;
+
+    // random, gently curved patches over the unit square
+    point4 (*patches)[4][4] = new point4[numPatches][4][4];
+    int *subdivs = new int[numPatches];
+    srandom( 321 );
+    for (int k = 0; k < numPatches; k++) {
+      for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+          patches[k][i][j] = point4( i / 3.0, (GLfloat) random() / RAND_MAX - 0.5, j / 3.0, 1.0 );
+        }
+      }
+      subdivs[k] = subdivisions;
+    }
+
+    const int numPoints = numPatches * 6 * numQuadsPerPatch( subdivisions );
+    point4 *serialPoints  = new point4[numPoints];
+    vec3   *serialNormals = new vec3[numPoints];
+    point4 *points  = new point4[numPoints];
+    vec3   *normals = new vec3[numPoints];
+
+    // reference: one patch at a time
+    Clock::time_point start = Clock::now();
+    int next = 0;
+    for (int k = 0; k < numPatches; k++) {
+      next = divide_patch( patches[k], subdivisions, FRONT_TO_BACK,
+                           serialPoints, serialNormals, NULL, next,
+                           0.0, 1.0, 0.0, 1.0 );
+    }
+    double serialMs = msSince( start );
+    printf( "%d patches, %d vertices\n", numPatches, numPoints );
+    printf( "%8s %10s %8s %10s\n", "threads", "ms", "speedup", "identical" );
+    printf( "%8s %10.2f %8.2f %10s\n", "serial", serialMs, 1.0, "-" );
+
+    unsigned int maxThreads = std::thread::hardware_concurrency();
+    if (maxThreads == 0) maxThreads = 1;
+    for (unsigned int t = 1; t <= maxThreads; t++) {
+      ThreadPool pool( t );
+      std::fill( points, points + numPoints, point4() );
+      std::fill( normals, normals + numPoints, vec3() );
+      start = Clock::now();
+      divide_patches( numPatches, patches, subdivs, FRONT_TO_BACK,
+                      points, normals, NULL, 0, pool );
+      double ms = msSince( start );
+      bool same = memcmp( points, serialPoints, numPoints * sizeof(point4) ) == 0 &&
+                  memcmp( normals, serialNormals, numPoints * sizeof(vec3) ) == 0;
+      printf( "%8u %10.2f %8.2f %10s\n", t, ms, serialMs / ms, same ? "yes" : "NO" );
+    }
+
+    delete [] patches;
+    delete [] subdivs;
+    delete [] serialPoints;
+    delete [] serialNormals;
+    delete [] points;
+    delete [] normals;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+// File: regenerateBench.cpp
+
+// Benchmark that regenerates shapes every "frame", animating their
+// divisions, and counts heap allocations by replacing operator new.
+// After the first frames have built the ring tables and grown the thread's
+// ScratchArena to its largest size, regenerating should not allocate at
+// all; the program exits with status 1 if it does.
+// Usage: regenerateBench [frames]   (default 1000)
+// Build: g++ -O2 -std=c++11 regenerateBench.cpp -o regenerateBench
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/holeyShapes.h"
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+//----------------------------------------------------------------------------
+
+// Every heap allocation in the program goes through these.  operator new
+// and operator delete are kept out of line so that GCC cannot inline one
+// into a caller without the other and then warn that the malloc'd memory
+// is freed by a mismatched function (-Wmismatched-new-delete).
+#ifdef _MSC_VER
+#  define NOINLINE  __declspec(noinline)
+#else
+#  define NOINLINE  __attribute__((noinline))
+#endif
+
+unsigned long heapAllocations = 0;
+
+NOINLINE void *
+operator new( size_t size )
+{
+    heapAllocations++;
+    void *p = malloc( size > 0 ? size : 1 );
+    if ( p == NULL ) throw std::bad_alloc();
+    return p;
+}
+
+void *
+operator new[]( size_t size )
+{
+    return operator new( size );
+}
+
+NOINLINE void
+operator delete( void *p ) noexcept
+{
+    free( p );
+}
+
+void
+operator delete[]( void *p ) noexcept
+{
+    operator delete( p );
+}
+
+//----------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+const int maxK        = 64;   // largest pyramid and cylinder base
+const int maxLongDivs = 72;   // largest globe
+const int maxLatDivs  = 36;
+const int maxDivs     = 5;    // largest indexed spherichedron
+
+//  Generates one set of shapes
+void
+generateShapes( int k, int longDivs, int latDivs, int divs,
+                point4 *points, color4 *colors, point4 *vertices, GLuint *indices )
+{
+    int start = 0;
+    start = pyramid( k, points, start );
+    start = cylinder( k, points, start );
+    start = globe( longDivs, latDivs, points, start );
+    globeColors( longDivs, latDivs, colors, 0 );
+    spherichedron( divs, vertices, 0, indices, 0 );
+}
+
+//  Generates one frame's shapes; the divisions cycle with the frame number
+void
+generateFrame( int frame, point4 *points, color4 *colors,
+               point4 *vertices, GLuint *indices )
+{
+    generateShapes( 3 + frame % (maxK - 2),
+                    3 + frame % (maxLongDivs - 2),
+                    2 + frame % (maxLatDivs - 1),
+                    frame % (maxDivs + 1),
+                    points, colors, vertices, indices );
+}
+
+int
+main( int argc, char **argv )
+{
+    int frames = (argc >= 2) ? atoi( argv[1] ) : 1000;
+    if ( frames < 1 ) frames = 1;
+
+    const int maxPoints   = 6 * maxK + 12 * maxK + 6 * maxLongDivs * (maxLatDivs - 1);
+    const int maxVertices = 4 * (1 << (2 * maxDivs)) + 2;
+    const int maxIndices  = 24 * (1 << (2 * maxDivs));
+    point4 *points   = new point4[maxPoints];
+    color4 *colors   = new color4[maxPoints];
+    point4 *vertices = new point4[maxVertices];
+    GLuint *indices  = new GLuint[maxIndices];
+
+    // One cycle of every animation builds the ring table for each
+    // division count, and the largest shapes grow the arena to the size
+    // every frame needs
+    for ( int frame = 0; frame < maxLongDivs; frame++ ) {
+	generateFrame( frame, points, colors, vertices, indices );
+    }
+    generateShapes( maxK, maxLongDivs, maxLatDivs, maxDivs,
+                    points, colors, vertices, indices );
+
+    unsigned long before = heapAllocations;
+    Clock::time_point start = Clock::now();
+    for ( int frame = 0; frame < frames; frame++ ) {
+	generateFrame( frame, points, colors, vertices, indices );
+    }
+    double ms = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+    unsigned long allocations = heapAllocations - before;
+
+    ScratchArena& arena = ScratchArena::threadLocal();
+    printf( "%d frames, %.3f ms per frame\n", frames, ms / frames );
+    printf( "heap allocations while regenerating: %lu\n", allocations );
+    printf( "scratch arena: %lu blocks, %lu bytes\n",
+	    arena.allocations(), (unsigned long) arena.capacity() );
+
+    delete [] points;
+    delete [] colors;
+    delete [] vertices;
+    delete [] indices;
+    return allocations == 0 ? 0 : 1;
+}
@@ -0,0 +1,245 @@
+// File: simdCheck.cpp
+
+// Check that the SIMD backend of vec4 and mat4 (simd.h) gives bit-for-bit
+// the same results as the scalar code.  The program computes mat4 * mat4,
+// mat4 * vec4, the vec4 operators, mat4c and the batched transforms for
+// the same pseudo-random inputs every run, and for directions under a
+// matrix with Inf and NaN in its translation column, and either writes
+// the results to a file or compares them, byte for byte, with a file
+// written before.
+// Build it twice, once with the scalar code and once with the SIMD
+// backend, write the results with the first and compare with the second;
+// the program exits with status 1 if any result differs.
+// Usage: simdCheck -w file   (write the results)
+//        simdCheck file      (compare the results with file)
+// Build: g++ -O2 -std=c++11 -ffp-contract=off -DANGEL_NO_SIMD simdCheck.cpp -o simdCheckScalar
+//        g++ -O2 -std=c++11 -ffp-contract=off simdCheck.cpp -o simdCheck
+// Run:   ./simdCheckScalar -w scalar.bin && ./simdCheck scalar.bin
+// (-ffp-contract=off keeps the compiler from fusing the scalar code's
+// multiplies and adds, which the SIMD kernels do not do.)
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+//----------------------------------------------------------------------------
+
+const int numMatrices = 10000;   // pairs of matrices, and vectors
+const int numPoints   = 4099;    // not a multiple of 4, for the batch tails
+
+//  The same sequence on every run and every platform (xorshift32)
+unsigned int seed = 2463534242u;
+
+GLfloat
+randomFloat( GLfloat lo, GLfloat hi )
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return lo + (hi - lo) * GLfloat( (seed >> 8) * (1.0 / 16777216.0) );
+}
+
+vec4
+randomVec4()
+{
+    GLfloat x = randomFloat( -4.0, 4.0 ), y = randomFloat( -4.0, 4.0 ),
+            z = randomFloat( -4.0, 4.0 ), w = randomFloat( -4.0, 4.0 );
+    return vec4( x, y, z, w );
+}
+
+mat4
+randomMat4()
+{
+    mat4 m;
+    for ( int i = 0; i < 4; ++i ) m[i] = randomVec4();
+    return m;
+}
+
+//----------------------------------------------------------------------------
+
+//  The results of one kind of operation, as raw bytes
+struct Section {
+    const char*          name;
+    std::vector<GLfloat> values;
+};
+
+std::vector<Section> sections;
+
+void
+begin( const char* name )
+{
+    Section s;
+    s.name = name;
+    sections.push_back( s );
+}
+
+void
+put( const vec4& v )
+{
+    for ( int i = 0; i < 4; ++i ) sections.back().values.push_back( v[i] );
+}
+
+void
+put( const mat4& m )
+{
+    for ( int i = 0; i < 4; ++i ) put( m[i] );
+}
+
+void
+put( const mat4c& m )
+{
+    for ( int i = 0; i < 16; ++i ) sections.back().values.push_back( m.m[i] );
+}
+
+//  Computes every section's results
+void
+compute()
+{
+    std::vector<mat4> a( numMatrices ), b( numMatrices );
+    std::vector<vec4> u( numMatrices ), v( numMatrices );
+    std::vector<GLfloat> s( numMatrices );
+    for ( int k = 0; k < numMatrices; ++k ) {
+	a[k] = randomMat4();
+	b[k] = randomMat4();
+	u[k] = randomVec4();
+	v[k] = randomVec4();
+	s[k] = randomFloat( -4.0, 4.0 );
+    }
+
+    begin( "mat4 * mat4" );
+    for ( int k = 0; k < numMatrices; ++k ) put( a[k] * b[k] );
+
+    begin( "mat4 *= mat4" );
+    for ( int k = 0; k < numMatrices; ++k ) {
+	mat4 m = a[k];
+	m *= b[k];
+	put( m );
+    }
+
+    begin( "mat4 * vec4" );
+    for ( int k = 0; k < numMatrices; ++k ) put( a[k] * u[k] );
+
+    begin( "-vec4" );
+    for ( int k = 0; k < numMatrices; ++k ) put( -u[k] );
+
+    begin( "vec4 + vec4" );
+    for ( int k = 0; k < numMatrices; ++k ) put( u[k] + v[k] );
+
+    begin( "vec4 - vec4" );
+    for ( int k = 0; k < numMatrices; ++k ) put( u[k] - v[k] );
+
+    begin( "vec4 * vec4" );
+    for ( int k = 0; k < numMatrices; ++k ) put( u[k] * v[k] );
+
+    begin( "vec4 * GLfloat" );
+    for ( int k = 0; k < numMatrices; ++k ) put( u[k] * s[k] );
+
+    begin( "vec4 / GLfloat" );
+    for ( int k = 0; k < numMatrices; ++k ) put( u[k] / s[k] );
+
+    begin( "vec4 += -= *=" );
+    for ( int k = 0; k < numMatrices; ++k ) {
+	vec4 w = u[k];
+	w += v[k];  put( w );
+	w -= u[k];  put( w );
+	w *= v[k];  put( w );
+	w *= s[k];  put( w );
+    }
+
+    begin( "mat4c" );
+    for ( int k = 0; k < numMatrices; ++k ) put( mat4c( a[k] ) );
+
+    std::vector<vec4> points( numPoints ), out( numPoints );
+    for ( int i = 0; i < numPoints; ++i ) points[i] = randomVec4();
+
+    begin( "transformPoints" );
+    transformPoints( a[0], &points[0], &out[0], numPoints );
+    for ( int i = 0; i < numPoints; ++i ) put( out[i] );
+
+    begin( "transformDirections" );
+    transformDirections( a[1], &points[0], &out[0], numPoints );
+    for ( int i = 0; i < numPoints; ++i ) put( out[i] );
+
+    // Directions ignore the translation column only as far as adding
+    // m[i][3] * 0 does: an Inf or a NaN there makes a NaN, and a negative
+    // entry can change the sign of a zero result
+    mat4 special = a[2];
+    special[0][3] = std::numeric_limits<GLfloat>::infinity();
+    special[1][3] = std::numeric_limits<GLfloat>::quiet_NaN();
+    special[2][3] = -1.0;
+    special[3][3] = -0.0;
+    special[2][0] = special[2][1] = special[2][2] = 0.0;
+    points[0] = vec4(  0.0,  0.0,  0.0, 1.0 );
+    points[1] = vec4( -0.0, -0.0, -0.0, 1.0 );
+    begin( "transformDirs Inf/NaN" );
+    transformDirections( special, &points[0], &out[0], numPoints );
+    for ( int i = 0; i < numPoints; ++i ) put( out[i] );
+}
+
+//----------------------------------------------------------------------------
+
+int
+main( int argc, char **argv )
+{
+    bool write = argc == 3 && strcmp( argv[1], "-w" ) == 0;
+    if ( !write && argc != 2 ) {
+	fprintf( stderr, "usage: %s -w file | %s file\n", argv[0], argv[0] );
+	return EXIT_FAILURE;
+    }
+    const char* fileName = argv[argc - 1];
+
+#ifdef ANGEL_SIMD_SSE
+    printf( "backend: SSE\n" );
+#elif defined(ANGEL_SIMD_NEON)
+    printf( "backend: NEON\n" );
+#else
+    printf( "backend: scalar\n" );
+#endif
+
+    compute();
+
+    FILE* file = fopen( fileName, write ? "wb" : "rb" );
+    if ( file == NULL ) {
+	perror( fileName );
+	return EXIT_FAILURE;
+    }
+
+    int mismatches = 0;
+    for ( size_t i = 0; i < sections.size(); ++i ) {
+	const Section& section = sections[i];
+	size_t n = section.values.size();
+	if ( write ) {
+	    fwrite( &section.values[0], sizeof(GLfloat), n, file );
+	    continue;
+	}
+
+	std::vector<GLfloat> expected( n );
+	if ( fread( &expected[0], sizeof(GLfloat), n, file ) != n ) {
+	    fprintf( stderr, "%s: too short\n", fileName );
+	    fclose( file );
+	    return EXIT_FAILURE;
+	}
+	if ( memcmp( &expected[0], &section.values[0], n * sizeof(GLfloat) ) == 0 ) {
+	    printf( "%-22s %7lu values, identical\n", section.name, (unsigned long) n );
+	    continue;
+	}
+
+	size_t first = n, differ = 0;
+	for ( size_t j = 0; j < n; ++j ) {
+	    if ( memcmp( &expected[j], &section.values[j], sizeof(GLfloat) ) != 0 ) {
+		if ( first == n ) first = j;
+		differ++;
+	    }
+	}
+	printf( "%-22s %7lu values, %lu DIFFER (first at %lu: %.9g, expected %.9g)\n",
+		section.name, (unsigned long) n, (unsigned long) differ,
+		(unsigned long) first, section.values[first], expected[first] );
+	mismatches++;
+    }
+    fclose( file );
+
+    if ( write ) printf( "results written to %s\n", fileName );
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
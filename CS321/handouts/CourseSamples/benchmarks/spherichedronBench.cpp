@@ -0,0 +1,67 @@
+// File: spherichedronBench.cpp
+
+// Benchmark comparing the recursive triangle-soup spherichedron with the
+// indexed version that shares edge midpoints through a MidpointCache;
+// reports generation time and vertex/index memory for each subdivision level,
+// and the scratch memory the cache's slots take.
+// Usage: spherichedronBench [maxDivs]   (default 8; the soup needs
+//        24 * 4^maxDivs points, 400 MB at divs = 10)
+// Build: g++ -O2 -std=c++11 spherichedronBench.cpp -o spherichedronBench
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/holeyShapes.h"
+#include <chrono>
+#include <cstdlib>
+
+//----------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+double
+msSince( Clock::time_point start )
+{
+    return std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+}
+
+//----------------------------------------------------------------------------
+
+int
+main( int argc, char **argv )
+{
+    int maxDivs = (argc >= 2) ? atoi( argv[1] ) : 8;
+
+    printf( "%4s %10s %10s %10s %10s %10s %10s\n", "divs",
+            "soup ms", "soup MB", "cache ms", "cache MB", "vertices", "slots MB" );
+
+    for (int divs = 0; divs <= maxDivs; divs++) {
+      int numPoints = 24;
+      for (int i = 0; i < divs; i++) numPoints *= 4;
+      int numVertices = numPoints / 6 + 2;
+
+      // current recursion, triangle soup
+      point4 *points = new point4[numPoints];
+      Clock::time_point start = Clock::now();
+      spherichedron( divs, points, 0 );
+      double soupMs = msSince( start );
+      delete [] points;
+
+      // indexed, one unit() per edge midpoint
+      point4 *vertices = new point4[numVertices];
+      GLuint *indices  = new GLuint[numPoints];
+      spherichedron( divs, vertices, 0, indices, 0 );     // grow the arena first
+      start = Clock::now();
+      spherichedron( divs, vertices, 0, indices, 0 );
+      double cacheMs = msSince( start );
+      double slotsMB = ScratchArena::threadLocal().capacity() / 1048576.0;
+      delete [] vertices;
+      delete [] indices;
+
+      double soupMB  = numPoints * sizeof(point4) / 1048576.0;
+      double cacheMB = (numVertices * sizeof(point4) +
+                        numPoints * sizeof(GLuint)) / 1048576.0;
+      printf( "%4d %10.3f %10.2f %10.3f %10.2f %10d %10.2f\n", divs,
+              soupMs, soupMB, cacheMs, cacheMB, numVertices, slotsMB );
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+// File: taskBench.cpp
+
+// Scaling of the work-stealing task scheduler in taskScheduler.h: for 1, 2,
+// 4, ... threads, up to twice the hardware threads, it times three
+// per-frame updates and reports each one's speedup over one thread:
+//   field   - the model matrices of a field of turning pyramids, as in
+//             movingGlobe with a field (1000 x 1000 of them)
+//   balls   - one step of 32000 balls of manyBalls (ballPhysics.h), whose
+//             ball-ball collisions stay on one thread
+//   uneven  - batches whose cost grows from nothing to a lot, which only
+//             balance because idle threads steal from busy ones
+// Usage: taskBench [repeats]   (default 10)
+// Build: g++ -O2 -std=c++11 taskBench.cpp -o taskBench -pthread
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/ballPhysics.h"
+#include "/usr/people/classes/CS321/include/taskScheduler.h"
+#include <chrono>
+#include <cstdlib>
+
+//----------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+double
+msSince( Clock::time_point start )
+{
+    return std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+}
+
+const int fieldDivs  = 1000;
+const int numBalls   = 32000;
+const int numUneven  = 4096;
+
+//  The field pyramids' matrices at turn position pos, as movingGlobe
+//    builds them
+void
+updateField( TaskScheduler& tasks, std::vector<mat4>& field, int pos )
+{
+    tasks.parallelFor( 0, fieldDivs * fieldDivs, 1024, [&field, pos]( int begin, int end ) {
+	GLfloat spacing = 8.0 / fieldDivs;
+	mat4 fieldScale = Scale( 0.4 * spacing, 0.5 * spacing, 0.4 * spacing );
+	GLfloat turn = pos * 2.0;
+	for ( int k = begin; k < end; k++ ) {
+	    int i = k / fieldDivs, j = k % fieldDivs;
+	    GLfloat angle = 45.0 + (((i + j) % 2 == 0) ? turn : -turn);
+	    field[k] = Translate( -4.0 + (i + 0.5) * spacing, -0.8,
+				  -4.0 + (j + 0.5) * spacing ) *
+		       fieldScale * RotateY( angle );
+	}
+    } );
+}
+
+//  Items whose cost grows with their number, in batches of 16
+double
+updateUneven( TaskScheduler& tasks, std::vector<double>& out )
+{
+    tasks.parallelFor( 0, numUneven, 16, [&out]( int begin, int end ) {
+	for ( int k = begin; k < end; k++ ) {
+	    double x = k;
+	    for ( int r = 0; r < k; r++ ) x = sqrt( x + r );
+	    out[k] = x;
+	}
+    } );
+    return out[numUneven - 1];
+}
+
+int
+main( int argc, char **argv )
+{
+    int repeats = (argc >= 2) ? atoi( argv[1] ) : 10;
+    if ( repeats < 1 ) {
+	fprintf( stderr, "usage: taskBench [repeats], repeats >= 1\n" );
+	return 1;
+    }
+    unsigned int hardware = std::thread::hardware_concurrency();
+    if ( hardware == 0 ) hardware = 1;
+    printf( "%u hardware threads, best of %d\n\n", hardware, repeats );
+
+    std::vector<mat4>   field( fieldDivs * fieldDivs );
+    std::vector<double> uneven( numUneven );
+    double baseField = 0.0, baseBalls = 0.0, baseUneven = 0.0;
+
+    printf( "%7s %10s %7s %10s %7s %10s %7s\n", "threads", "field ms", "speed",
+	    "balls ms", "speed", "uneven ms", "speed" );
+    for ( unsigned int threads = 1; threads <= 2 * hardware; threads *= 2 ) {
+	TaskScheduler tasks( threads );
+	BallSystem balls( numBalls, 0.02, 0.04, 2.2, 2.5, 1.25 );
+	for ( int i = 0; i < 10; i++ ) balls.step( &tasks );
+
+	double fieldMs = 1e30, ballsMs = 1e30, unevenMs = 1e30;
+	for ( int r = 0; r < repeats; r++ ) {
+	    Clock::time_point start = Clock::now();
+	    updateField( tasks, field, r );
+	    fieldMs = std::min( fieldMs, msSince( start ) );
+
+	    start = Clock::now();
+	    balls.step( &tasks );
+	    ballsMs = std::min( ballsMs, msSince( start ) );
+
+	    start = Clock::now();
+	    updateUneven( tasks, uneven );
+	    unevenMs = std::min( unevenMs, msSince( start ) );
+	}
+	if ( threads == 1 ) {
+	    baseField = fieldMs;  baseBalls = ballsMs;  baseUneven = unevenMs;
+	}
+	printf( "%7u %10.3f %6.2fx %10.3f %6.2fx %10.3f %6.2fx\n", threads,
+		fieldMs, baseField / fieldMs, ballsMs, baseBalls / ballsMs,
+		unevenMs, baseUneven / unevenMs );
+    }
+    return 0;
+}
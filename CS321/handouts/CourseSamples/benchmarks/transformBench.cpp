@@ -0,0 +1,89 @@
+// File: transformBench.cpp
+
+// Benchmark for the batched point transforms in mat.h and parallel.h;
+// transforms the vertices of a high-resolution globe with a typical
+// model_view chain and reports throughput in points per second.
+// Usage: transformBench [longDivs latDivs [repetitions]]
+// Build: g++ -O2 -std=c++11 -pthread transformBench.cpp -o transformBench
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/holeyShapes.h"
+#include "/usr/people/classes/CS321/include/parallel.h"
+#include <chrono>
+#include <cstdlib>
+
+//----------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+double
+secondsSince( Clock::time_point start )
+{
+    return std::chrono::duration<double>( Clock::now() - start ).count();
+}
+
+void
+report( const char* label, size_t numPoints, int reps, double seconds )
+{
+    double pointsPerSec = (double) numPoints * reps / seconds;
+    printf( "%-28s %10.1f Mpoints/s  (%.3f ms per pass)\n",
+            label, pointsPerSec / 1.0e6, 1000.0 * seconds / reps );
+}
+
+//----------------------------------------------------------------------------
+
+int
+main( int argc, char **argv )
+{
+    int longDivs = 1024, latDivs = 512, reps = 20;
+    if (argc >= 3) {
+      longDivs = atoi( argv[1] );
+      latDivs  = atoi( argv[2] );
+    }
+    if (argc >= 4) reps = atoi( argv[3] );
+
+    const size_t numPoints = 6 * longDivs * (latDivs - 1);
+    point4 *points = new point4[numPoints];
+    point4 *result = new point4[numPoints];
+    if (globe( longDivs, latDivs, points, 0 ) < 0) {
+      fprintf( stderr, "globe needs longDivs >= 3 and latDivs >= 2\n" );
+      return EXIT_FAILURE;
+    }
+
+    mat4 mv = LookAt( point4( 0.0, 0.0, 4.0, 1.0 ), point4( 0.0, 0.0, 0.0, 1.0 ),
+                      vec4( 0.0, 1.0, 0.0, 0.0 ) ) *
+              RotateY( -45.0 ) * RotateZ( 30.0 ) * RotateX( 60.0 ) *
+              Translate( 0.5, 0.0, 0.0 ) * Scale( 0.4, 0.2, 0.2 );
+
+    printf( "%lu points, %d passes\n", (unsigned long) numPoints, reps );
+
+    // one point at a time through mat4 * vec4
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < reps; r++) {
+      for (size_t i = 0; i < numPoints; i++) result[i] = mv * points[i];
+    }
+    report( "mat4 * vec4 loop", numPoints, reps, secondsSince( start ) );
+
+    // batched, single thread
+    start = Clock::now();
+    for (int r = 0; r < reps; r++) {
+      transformPoints( mv, points, result, numPoints );
+    }
+    report( "transformPoints", numPoints, reps, secondsSince( start ) );
+
+    // batched, 2, 4, ... hardware threads
+    unsigned int maxThreads = std::thread::hardware_concurrency();
+    for (unsigned int t = 2; t <= maxThreads; t *= 2) {
+      start = Clock::now();
+      for (int r = 0; r < reps; r++) {
+        transformPoints( mv, points, result, numPoints, t );
+      }
+      char label[64];
+      sprintf( label, "transformPoints, %u threads", t );
+      report( label, numPoints, reps, secondsSince( start ) );
+    }
+
+    delete [] points;
+    delete [] result;
+    return EXIT_SUCCESS;
+}
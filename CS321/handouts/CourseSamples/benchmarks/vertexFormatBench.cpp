@@ -0,0 +1,128 @@
+// File: vertexFormatBench.cpp
+
+// Memory and bandwidth report for vertex formats: an indexed spherichedron
+// with positions, normals and colors is stored as planar float arrays, as
+// one interleaved float array, and in two compact interleaved formats
+// (packed 10:10:10:2 normals and RGBA8 colors, with float or half-float
+// positions).  For each it reports bytes per vertex, buffer size, the
+// vertex fetch bandwidth of drawing it every frame at 60 Hz, the time to
+// pack it, and the largest error the packing introduces.
+// Usage: vertexFormatBench [divs]   (default 7)
+// Build: g++ -O2 -std=c++11 vertexFormatBench.cpp -o vertexFormatBench
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/holeyShapes.h"
+#include "/usr/people/classes/CS321/include/vertexFormat.h"
+#include <chrono>
+#include <cstdlib>
+
+//----------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock Clock;
+
+double
+msSince( Clock::time_point start )
+{
+    return std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+}
+
+//  Largest difference between attribute a of packed and of full, over the
+//    first size components
+double
+maxError( const InterleavedVertices& full, const InterleavedVertices& packed,
+	  const char *name, int size )
+{
+    int a = full.format().find( name ), b = packed.format().find( name );
+    double error = 0.0;
+    for ( int i = 0; i < full.numVertices(); i++ ) {
+	vec4 u = full.get( a, i ), v = packed.get( b, i );
+	for ( int c = 0; c < size; c++ ) {
+	    double e = fabs( u[c] - v[c] );
+	    if ( e > error ) error = e;
+	}
+    }
+    return error;
+}
+
+void
+report( const char *name, double bytesPerVertex, int numVertices,
+	double baseBytes, double packMs )
+{
+    double mb = bytesPerVertex * numVertices / 1048576.0;
+    printf( "%-34s %6.0f %9.2f %7.2fx %10.1f", name, bytesPerVertex, mb,
+	    baseBytes / bytesPerVertex, 60.0 * mb );
+    if ( packMs >= 0.0 ) printf( " %9.2f", packMs );
+    printf( "\n" );
+}
+
+int
+main( int argc, char **argv )
+{
+    int divs = (argc >= 2) ? atoi( argv[1] ) : 7;
+    if ( divs < 0 || divs > 10 ) {
+	fprintf( stderr, "usage: vertexFormatBench [divs], 0 <= divs <= 10\n" );
+	return 1;
+    }
+    const int numVertices = 4 * (1 << (2 * divs)) + 2;
+    const int numIndices  = 24 * (1 << (2 * divs));
+    GLuint *indices = new GLuint[numIndices];
+
+    // Full-precision interleaved vertices, built by the generators
+    VertexFormat fullFormat;
+    fullFormat.add( "vPosition", 4, GL_FLOAT )
+	      .add( "vNormal",   3, GL_FLOAT )
+	      .add( "vColor",    4, GL_FLOAT );
+    InterleavedVertices full( fullFormat, numVertices );
+    Strided<point4> points  = full.attribute<point4>( "vPosition" );
+    Strided<vec3>   normals = full.attribute<vec3>( "vNormal" );
+    spherichedron( divs, points, 0, indices, 0 );
+    for ( int i = 0; i < numVertices; i++ ) {
+	normals[i] = vec3( points[i].x, points[i].y, points[i].z );
+    }
+    randomColors( numVertices, full.attribute<color4>( "vColor" ), 0 );
+
+    // The compact formats
+    VertexFormat compactFormat;
+    compactFormat.add( "vPosition", 3, GL_FLOAT )
+		 .add( "vNormal",   4, GL_INT_2_10_10_10_REV, GL_TRUE )
+		 .add( "vColor",    4, GL_UNSIGNED_BYTE, GL_TRUE );
+    VertexFormat halfFormat;
+    halfFormat.add( "vPosition", 4, GL_HALF_FLOAT )
+	      .add( "vNormal",   4, GL_INT_2_10_10_10_REV, GL_TRUE )
+	      .add( "vColor",    4, GL_UNSIGNED_BYTE, GL_TRUE );
+    InterleavedVertices compact( compactFormat, numVertices );
+    InterleavedVertices half( halfFormat, numVertices );
+
+    Clock::time_point start = Clock::now();
+    convertVertices( full, compact );
+    double compactMs = msSince( start );
+    start = Clock::now();
+    convertVertices( full, half );
+    double halfMs = msSince( start );
+
+    const double planarBytes = sizeof(point4) + sizeof(vec3) + sizeof(color4);
+
+    printf( "spherichedron, divs %d: %d vertices, %d indices (%.2f MB of GLuint)\n\n",
+	    divs, numVertices, numIndices, numIndices * sizeof(GLuint) / 1048576.0 );
+    printf( "%-34s %6s %9s %8s %10s %9s\n", "format", "bytes", "MB",
+	    "smaller", "MB/s@60Hz", "pack ms" );
+    report( "planar point4 + vec3 + color4", planarBytes, numVertices, planarBytes, -1.0 );
+    report( "interleaved floats", fullFormat.stride(), numVertices, planarBytes, -1.0 );
+    report( "vec3 + 10:10:10:2 + RGBA8", compactFormat.stride(), numVertices,
+	    planarBytes, compactMs );
+    report( "half4 + 10:10:10:2 + RGBA8", halfFormat.stride(), numVertices,
+	    planarBytes, halfMs );
+
+    printf( "\nlargest errors    position   normal    color\n" );
+    printf( "vec3 positions   %9.2g %8.2g %8.2g\n",
+	    maxError( full, compact, "vPosition", 4 ),
+	    maxError( full, compact, "vNormal", 3 ),
+	    maxError( full, compact, "vColor", 4 ) );
+    printf( "half positions   %9.2g %8.2g %8.2g\n",
+	    maxError( full, half, "vPosition", 4 ),
+	    maxError( full, half, "vNormal", 3 ),
+	    maxError( full, half, "vColor", 4 ) );
+
+    delete [] indices;
+    return 0;
+}
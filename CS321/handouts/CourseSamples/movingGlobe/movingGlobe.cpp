@@ -6,19 +6,37 @@
 // and recursive sphere.
 
 #include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/culling.h"
+#include "/usr/people/classes/CS321/include/frameHandoff.h"
+#include "/usr/people/classes/CS321/include/headless.h"
 #include "/usr/people/classes/CS321/include/holeyShapes.h"
+#include "/usr/people/classes/CS321/include/instancing.h"
+#include "/usr/people/classes/CS321/include/lod.h"
+#include "/usr/people/classes/CS321/include/profiler.h"
+#include "/usr/people/classes/CS321/include/sceneGraph.h"
+#include "/usr/people/classes/CS321/include/shapeCache.h"
+#include "/usr/people/classes/CS321/include/taskScheduler.h"
+#include "/usr/people/classes/CS321/include/timestep.h"
+#include "/usr/people/classes/CS321/include/uniformBlocks.h"
+#include "/usr/people/classes/CS321/include/vertexFormat.h"
 
 // window parameters
 const int defaultWindowSize = 512;
 
-// parameters for creating the globe
+// parameters for creating the globe, at its finest level of detail; each
+// coarser level has half the divisions of the one before
 const int latDivs  = 18;
 const int longDivs = 36;
-const int numGlobePoints = 6 * longDivs * (latDivs - 1);
+const int numGlobeVertices = 2 + longDivs * (latDivs - 1);
+const int numGlobeIndices  = 6 * longDivs * (latDivs - 1);
+const int numGlobeLevels   = 2;
+
+// shapes generated by earlier runs are kept in this file
+const char *shapeCacheFile = "movingGlobe.shapes";
 
 // parameters for the globe transformation matrices
-const GLfloat sx = 0.4, sy = 0.2, sz = 0.2; // scale factors
-const GLfloat dx = 0.5, dy = 0.0, dz = 0.0; // translation factors
+constexpr GLfloat sx = 0.4, sy = 0.2, sz = 0.2; // scale factors
+constexpr GLfloat dx = 0.5, dy = 0.0, dz = 0.0; // translation factors
 
 const int xRotateDivs = 180; // number of positions around the revolution
 int       xRotatePos  =   0; // current position around the revolution
@@ -28,20 +46,57 @@ const int revolveDivs = 540; // number of positions around the revolution
 int       revolvePos  =   0; // current position around the revolution
                              // (0 ... revolveDivs - 1)
 
-const GLfloat obliqueAngle = -45.0;  // degrees
+constexpr GLfloat obliqueAngle = -45.0;  // degrees
 
-// constant globe matrices
-const mat4 zRotateScaleAndTranslate =
-               Translate( dx, dy, dz ) * Scale( sx, sy, sz ) * RotateZ( 90.0 );
-const mat4 obliqueRotate     = RotateY( obliqueAngle );
+// constant globe matrices, built by the compiler
+constexpr mat4 zRotateScaleAndTranslate =
+               ConstMult( Translate( dx, dy, dz ), Scale( sx, sy, sz ), ConstRotateZ( 90.0 ) );
+constexpr mat4 obliqueRotate = ConstRotateY( obliqueAngle );
 
 // parameters for the pyramids (quad based)
 const int pyrBaseVerts = 4;
-const int pyrStart     = numGlobePoints;
-const int numPyrPoints = 6 * pyrBaseVerts;
-const GLfloat psx = 0.4, psy =  0.5, psz = 0.4; // scale factors
-const GLfloat pdx = 0.7, pdy = -0.8, pdz = 0.7; // translation factors
-const mat4 pyrScale = Scale( psx, psy, psz );
+const int pyrVStart      = numGlobeVertices;
+const int pyrIStart      = numGlobeIndices;
+const int numPyrVertices = pyrBaseVerts + 2;
+const int numPyrIndices  = 6 * pyrBaseVerts;
+constexpr GLfloat psx = 0.4, psy =  0.5, psz = 0.4; // scale factors
+constexpr GLfloat pdx = 0.7, pdy = -0.8, pdz = 0.7; // translation factors
+constexpr mat4 pyrScale = Scale( psx, psy, psz );
+const int numCornerPyramids = 4;
+constexpr mat4 cornerPyramids[numCornerPyramids] = {
+    ConstMult( Translate(  pdx, pdy,  pdz ), pyrScale, ConstRotateY(  45.0 ) ),
+    ConstMult( Translate(  pdx, pdy, -pdz ), pyrScale, ConstRotateY( 135.0 ) ),
+    ConstMult( Translate( -pdx, pdy,  pdz ), pyrScale, ConstRotateY( 225.0 ) ),
+    ConstMult( Translate( -pdx, pdy, -pdz ), pyrScale, ConstRotateY( 315.0 ) )
+};
+
+// optional field of small pyramids on the ground, fieldDivs x fieldDivs of
+// them (set from the command line), drawn in the same call as the 4 corner
+// pyramids; each turns about its own axis, the opposite way to its
+// neighbours
+const GLfloat fieldExtent = 4.0;  // field covers -fieldExtent ... fieldExtent
+int fieldDivs = 0;
+const int fieldGrain = 1024;      // field pyramids updated per task
+
+// The objects' model matrices are the world matrices of a scene graph.
+SceneGraph scene;
+int revolveNode, spinNode, globeNode;   // the globe's moving nodes, and itself
+int firstPyramidNode;                   // the corners, then the field
+
+// The animation runs on an update thread, stepsPerSecond steps a second,
+// and only that thread uses xRotatePos, revolvePos and the scene.  Each
+// step passes display() what it draws: the model matrices of the moving
+// objects, updated with tasks on the scheduler's threads.
+struct FrameSnapshot {
+    mat4              globe;
+    std::vector<mat4> field;      // fieldDivs * fieldDivs
+};
+TripleBuffer<FrameSnapshot> frames;
+TaskScheduler& tasks = TaskScheduler::shared();
+const double stepsPerSecond = 60.0;
+void step( void );
+UpdateThread updater( 1.0 / stepsPerSecond, step );
+FrameLimiter limiter( 60.0 );     // frames a second, 0 for no limit
 
 // parameters for viewer position
 const GLfloat initViewerDist  =  4.0;
@@ -54,9 +109,43 @@ point4 eye( 0.0, 0.0, initViewerDist, 1.0 );
 const point4 at ( 0.0, 0.0, 0.0, 1.0 );
 const vec4   up ( 0.0, 1.0, 0.0, 0.0 );
 
-int numPoints = numGlobePoints + numPyrPoints;
-
-GLuint model_view;  // uniform location of the model_view matrix
+int numVertices = numGlobeVertices + numPyrVertices;
+int numIndices  = numGlobeIndices + numPyrIndices;
+
+// the projection and view, in a uniform block copied only when they
+// change, and each draw's object matrix, in a ring of uniform blocks
+FrameBlock  frameBlock;
+UniformRing objectBlocks;
+const ObjectUniforms notMoved = { mat4c( mat4() ) };  // for draws placed by
+                                                      // their instances alone
+
+// per-instance model matrices: the globe's one, left as the identity, the
+// corner pyramids', set once, and the field's, which change every frame
+InstanceBuffer globeInstance;
+InstanceBuffer pyramidInstances;
+
+// Objects outside the view volume are skipped: the globe is not drawn,
+// and only the field pyramids inside are uploaded and drawn.  The
+// corner pyramids are always in view.
+ShapeBounds          globeBounds, pyrBounds;  // of the shapes, before their models
+FrustumCuller        culler;
+std::vector<mat4>    visibleField;
+bool                 culling = true;
+
+// The globe is drawn at the coarsest level of detail that is off by at
+// most lodTolerance pixels: about what the finest, the globe as it always
+// was, is off by at the nearest viewer distance.  The finest is at the
+// start of the arrays, the other after the pyramid.
+const GLfloat lodTolerance = 2.5;
+LodChain globeLod;
+int      globeLevel = -1;                 // the level drawn last frame
+int      viewportHeight = defaultWindowSize;
+
+// frame timing, by phase of display()
+enum { PHASE_MATRICES, PHASE_CULL, PHASE_UPLOAD, PHASE_DRAW, PHASE_SWAP,
+       NUM_PHASES };
+const char *phaseNames[NUM_PHASES] = { "matrices", "cull", "upload", "draw", "swap" };
+FrameProfiler profiler( NUM_PHASES, phaseNames );
 
 // Projection transformation parameters
 const GLfloat dimScale = 0.1;
@@ -64,25 +153,129 @@ GLfloat left   = -dimScale, right =  dimScale,
         bottom = -dimScale, top   =  dimScale,
         zNear  =  0.4, zFar  = 20.0;
 
-GLuint  projection;  // uniform location of the projection matrix
 
+//----------------------------------------------------------------------------
+
+//  Model matrix of field pyramid k at the current position
+mat4
+fieldModel( int k )
+{
+    GLfloat spacing = 2 * fieldExtent / fieldDivs;
+    GLfloat turn = xRotatePos * 360.0 / xRotateDivs;
+    int i = k / fieldDivs, j = k % fieldDivs;
+    GLfloat angle = 45.0 + (((i + j) % 2 == 0) ? turn : -turn);
+    return Translate( -fieldExtent + (i + 0.5) * spacing, pdy,
+                      -fieldExtent + (j + 0.5) * spacing ) *
+           Scale( 0.4 * spacing, 0.5 * spacing, 0.4 * spacing ) * RotateY( angle );
+}
+
+//  Builds the scene: the globe at the end of its chain of transforms, of
+//    which only the revolution and the rotation change, then the corner
+//    pyramids and the field
+void
+buildScene( void )
+{
+    scene.reserve( 4 + numCornerPyramids + fieldDivs * fieldDivs );
+    int oblique = scene.add( obliqueRotate );
+    revolveNode = scene.add( mat4(), oblique );
+    spinNode    = scene.add( mat4(), revolveNode );
+    globeNode   = scene.add( zRotateScaleAndTranslate, spinNode );
+
+    firstPyramidNode = scene.add( cornerPyramids[0] );
+    for ( int k = 1; k < numCornerPyramids; k++ ) scene.add( cornerPyramids[k] );
+    for ( int k = 0; k < fieldDivs * fieldDivs; k++ ) scene.add( fieldModel( k ) );
+}
+
+//  Moves the scene to the current positions and passes what display()
+//    needs on; the field pyramids are turned by tasks, in batches that
+//    idle threads take from each other
+void
+updateFrame( void )
+{
+    // set up the revolution and the rotation
+    scene.setLocal( revolveNode, RotateZ( revolvePos * 360.0 / revolveDivs ) );
+    scene.setLocal( spinNode, RotateX( xRotatePos * 360.0 / xRotateDivs ) );
+
+    int firstField = firstPyramidNode + numCornerPyramids;
+    tasks.parallelFor( 0, fieldDivs * fieldDivs, fieldGrain,
+                       [firstField]( int begin, int end ) {
+        for ( int k = begin; k < end; k++ ) {
+            scene.setLocal( firstField + k, fieldModel( k ) );
+        }
+    } );
+
+    scene.update();
+
+    FrameSnapshot& frame = frames.writing();
+    frame.globe = scene.world( globeNode );
+    frame.field.resize( fieldDivs * fieldDivs );
+    tasks.parallelFor( 0, fieldDivs * fieldDivs, fieldGrain,
+                       [&frame, firstField]( int begin, int end ) {
+        for ( int k = begin; k < end; k++ ) {
+            frame.field[k] = scene.world( firstField + k );
+        }
+    } );
+    frames.publish();
+}
 
 //----------------------------------------------------------------------------
 
 void
 init( void )
 {
-    // Create the point and color arrays
-    point4 *points = new point4[numPoints];
-    color4 *colors = new color4[numPoints];
+    // The globe at each level of detail, reusing the ones saved by an
+    // earlier run; the levels after the first add to the arrays
+    ShapeCache& shapes = ShapeCache::shared();
+    shapes.load( shapeCacheFile );
+    const ShapeMesh *globeLevels[numGlobeLevels];
+    for ( int l = 0; l < numGlobeLevels; l++ ) {
+        globeLevels[l] = shapes.get( SHAPE_GLOBE, longDivs >> l, latDivs >> l );
+        if ( l > 0 ) {
+            numVertices += globeLevels[l]->numVertices;
+            numIndices  += globeLevels[l]->numIndices;
+        }
+    }
+    if ( shapes.modified() ) shapes.save( shapeCacheFile );
+
+    // Build the vertices at full precision, interleaved (position and
+    // color), and allocate the indices
+    VertexFormat fullFormat;
+    fullFormat.add( "vPosition", 4, GL_FLOAT ).add( "vColor", 4, GL_FLOAT );
+    InterleavedVertices fullVertices( fullFormat, numVertices );
+    Strided<point4> points = fullVertices.attribute<point4>( "vPosition" );
+    Strided<color4> colors = fullVertices.attribute<color4>( "vColor" );
+    GLushort *indices = new GLushort[numIndices];
 
     // Set up the ovoid globe
-    globe( longDivs, latDivs, points, 0 );
-    globeColors( longDivs, latDivs, colors, 0 );
+    globeLod.add( *globeLevels[0], sphereMeshError( *globeLevels[0] ),
+                  points, 0, indices, 0 );
+    globeBounds = globeLevels[0]->bounds;
+    randomColors( numGlobeVertices, colors, 0 );
 
     // Set up the pyramid
-    pyramid( pyrBaseVerts, points, pyrStart );
-    randomColors( numPyrPoints, colors, pyrStart );
+    pyramid( pyrBaseVerts, points, pyrVStart, indices, pyrIStart );
+    pyrBounds = shapeBounds( numPyrVertices, points, pyrVStart );
+    randomColors( numPyrVertices, colors, pyrVStart );
+
+    // Then the globe's coarser levels, colored like the finest, so that
+    // changing level does not change its colors
+    int vStart = pyrVStart + numPyrVertices;
+    int iStart = pyrIStart + numPyrIndices;
+    for ( int l = 1; l < numGlobeLevels; l++ ) {
+        const ShapeMesh& mesh = *globeLevels[l];
+        iStart = globeLod.add( mesh, sphereMeshError( mesh ), points, vStart,
+                               indices, iStart );
+        copyNearestColors( points, colors, vStart, mesh.numVertices,
+                           0, numGlobeVertices );
+        vStart += mesh.numVertices;
+    }
+
+    // Pack each vertex into 16 bytes instead of 32: 3 floats of position
+    // (the shader still gets w = 1) and 4 normalized bytes of color
+    VertexFormat format;
+    format.add( "vPosition", 3, GL_FLOAT ).add( "vColor", 4, GL_UNSIGNED_BYTE, GL_TRUE );
+    InterleavedVertices vertices( format, numVertices );
+    convertVertices( fullVertices, vertices );
 
     // Create a vertex array object
     GLuint vao;
@@ -93,29 +286,43 @@ init( void )
     GLuint buffer;
     glGenBuffers( 1, &buffer );
     glBindBuffer( GL_ARRAY_BUFFER, buffer );
-    glBufferData( GL_ARRAY_BUFFER, numPoints * (sizeof(point4) + sizeof(color4)),
-                  NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ARRAY_BUFFER, 0, numPoints * sizeof(point4), points );
-    glBufferSubData( GL_ARRAY_BUFFER, numPoints * sizeof(point4),
-                     numPoints * sizeof(color4), colors );
+    glBufferData( GL_ARRAY_BUFFER, vertices.size(), vertices.data(),
+                  GL_STATIC_DRAW );
+
+    // Create and initialize the index buffer
+    GLuint indexBuffer;
+    glGenBuffers( 1, &indexBuffer );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(GLushort),
+                  indices, GL_STATIC_DRAW );
 
     // Load shaders and use the resulting shader program
     GLuint program = InitShader( "movingGlobe_vs.glsl", "movingGlobe_fs.glsl" );
     glUseProgram( program );
 
-    // Initialize the vertex position attribute from the vertex shader
-    GLuint vPosition = glGetAttribLocation( program, "vPosition" );
-    glEnableVertexAttribArray( vPosition );
-    glVertexAttribPointer( vPosition, 4, GL_FLOAT, GL_FALSE, 0,
-                           BUFFER_OFFSET(0) );
+    // Initialize the vertex position and color attributes from the vertex shader
+    format.enable( program );
+
+    frameBlock.create( program );
+    objectBlocks.create( program, "Object", 4 );
+
+    // Set up the scene and the first frame; the pyramids' model matrices,
+    // one at each corner, then the field, if any, are consecutive in it
+    buildScene();
+    updateFrame();
+    frames.acquire();
+    int numPyramids = numCornerPyramids + fieldDivs * fieldDivs;
+    pyramidInstances.create( program, "instanceModel", numPyramids,
+                             fieldDivs > 0 ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW );
+    pyramidInstances.update( &scene.world( firstPyramidNode ), numPyramids );
 
-    GLuint vColor = glGetAttribLocation( program, "vColor" );
-    glEnableVertexAttribArray( vColor );
-    glVertexAttribPointer( vColor, 4, GL_FLOAT, GL_FALSE, 0,
-                           BUFFER_OFFSET(numPoints * sizeof(point4)) );
+    // the globe is placed by its object block, so its one instance is not
+    // moved
+    const mat4 identity;
+    globeInstance.create( program, "instanceModel", 1, GL_STATIC_DRAW );
+    globeInstance.update( &identity, 1 );
 
-    model_view = glGetUniformLocation( program, "model_view" );
-    projection = glGetUniformLocation( program, "projection" );
+    profiler.enableGpuTimer();
 
     glEnable( GL_DEPTH_TEST ); 
     glClearColor( 1.0, 0.9, 0.75, 1.0 ); // light yellow background
@@ -126,65 +333,106 @@ init( void )
 void
 display( void )
 {
+    profiler.beginFrame();
+
     // clear the window
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
+    profiler.phase( PHASE_MATRICES );
+
     // set up projection matrix
     mat4 p = Frustum( left, right, bottom, top, zNear, zFar );
-    glUniformMatrix4fv( projection, 1, GL_TRUE, p );
 
     // set up view position
     mat4 lookAt = LookAt( eye, at, up );
 
-  // Set up globe
-    // set up the rotation matrix
-    GLfloat xRotationAngle = xRotatePos * 360.0 / xRotateDivs;
-    mat4 xRotation = RotateX( xRotationAngle );
+    profiler.phase( PHASE_CULL );
+
+    // find the objects at least partly inside the view volume, and the
+    // globe's level of detail
+    frames.acquire();
+    const FrameSnapshot& frame = frames.reading();
+    ViewFrustum frustum( p * lookAt );
+    bool globeVisible = !culling || culler.test( frustum, frame.globe, globeBounds );
+    if ( globeVisible ) {
+        LodView view( p, viewportHeight, eye, lodTolerance );
+        globeLevel = globeLod.select( view, frame.globe, globeBounds, globeLevel );
+    }
+    const mat4 *field = frame.field.empty() ? NULL : &frame.field[0];
+    int numField = frame.field.size();
+    if ( culling && numField > 0 ) {
+        numField = culler.cull( frustum, field, numField, pyrBounds );
+        visibleField.resize( numField );
+        if ( numField > 0 ) {
+            culler.compact( field, &visibleField[0] );
+            field = &visibleField[0];
+        }
+    }
+
+    profiler.phase( PHASE_UPLOAD );
 
-    // set up the revolution matrix
-    GLfloat revolveAngle = revolvePos * 360.0 / revolveDivs;
-    mat4 revolutionRotate = RotateZ( revolveAngle );
+    // the projection and view are copied only when they change; the model
+    // part of each object comes from its object block and instance buffer
+    frameBlock.setProjection( p );
+    frameBlock.setView( lookAt );
+    frameBlock.upload();
+    objectBlocks.beginFrame();
+    if ( numField > 0 ) {
+        pyramidInstances.update( field, numField, numCornerPyramids );
+    }
 
-    // set up the model_view matrix
-    mat4 mv = lookAt * obliqueRotate * revolutionRotate *
-              xRotation * zRotateScaleAndTranslate;
+    profiler.phase( PHASE_DRAW );
 
-    glUniformMatrix4fv( model_view, 1, GL_TRUE, mv );
-    glDrawArrays( GL_TRIANGLES, 0, numGlobePoints );
+    if ( globeVisible ) {
+        ObjectUniforms globe = { mat4c( frame.globe ) };
+        objectBlocks.push( globe );
+        const LodLevel& level = globeLod.level( globeLevel );
+        globeInstance.bind();
+        glDrawElementsInstanced( GL_TRIANGLES, level.numIndices, GL_UNSIGNED_SHORT,
+                                 BUFFER_OFFSET(level.iStart * sizeof(GLushort)),
+                                 globeInstance.size() );
+    }
 
-  // Set up pyramids
-    mat4 pyrTranslate = Translate( pdx, pdy, pdz );  // right front pyramid
-    mv = lookAt * pyrTranslate * pyrScale * RotateY(  45.0 );
-    glUniformMatrix4fv( model_view, 1, GL_TRUE, mv );
-    glDrawArrays( GL_TRIANGLES, pyrStart, numPyrPoints );
+  // Draw all the visible pyramids with one call
+    objectBlocks.push( notMoved );
+    pyramidInstances.bind();
+    glDrawElementsInstanced( GL_TRIANGLES, numPyrIndices, GL_UNSIGNED_SHORT,
+                             BUFFER_OFFSET(pyrIStart * sizeof(GLushort)),
+                             numCornerPyramids + numField );
 
-    pyrTranslate = Translate( pdx, pdy, -pdz );      // right rear pyramid
-    mv = lookAt * pyrTranslate * pyrScale * RotateY( 135.0 );
-    glUniformMatrix4fv( model_view, 1, GL_TRUE, mv );
-    glDrawArrays( GL_TRIANGLES, pyrStart, numPyrPoints );
+    objectBlocks.endFrame();
 
-    pyrTranslate = Translate( -pdx, pdy, pdz );      // left front pyramid
-    mv = lookAt * pyrTranslate * pyrScale * RotateY( 225.0 );
-    glUniformMatrix4fv( model_view, 1, GL_TRUE, mv );
-    glDrawArrays( GL_TRIANGLES, pyrStart, numPyrPoints );
+    profiler.drawOverlay();
 
-    pyrTranslate = Translate( -pdx, pdy, -pdz );     // left rear pyramid
-    mv = lookAt * pyrTranslate * pyrScale * RotateY( 315.0 );
-    glUniformMatrix4fv( model_view, 1, GL_TRUE, mv );
-    glDrawArrays( GL_TRIANGLES, pyrStart, numPyrPoints );
+    profiler.phase( PHASE_SWAP );
+    sampleSwapBuffers( );
 
-    glutSwapBuffers( );
+    profiler.endFrame();
 }
 
 //----------------------------------------------------------------------------
 
+//  One step on the update thread
 void
-idle( void )
+step( void )
 {
     xRotatePos = (xRotatePos + 1) % xRotateDivs;
     revolvePos = (revolvePos + 1) % revolveDivs;
+    updateFrame();
+}
 
-    glutPostRedisplay( );
+//----------------------------------------------------------------------------
+
+void
+idle( void )
+{
+    // headless, each frame is one step, taken here, so runs are
+    // repeatable
+    if ( !updater.running() ) updater.runStep();
+
+    // sleep rather than draw frames no one will see
+    limiter.wait();
+    samplePostRedisplay( );
 }
 
 //----------------------------------------------------------------------------
@@ -282,10 +530,18 @@ keyboard( unsigned char key, int x, int y )
           eye.y = eye.z * offsetRatio;
         }
         break;
+    case 't': case 'T':       // Shows or hides the frame times
+        profiler.toggleOverlay();
+        break;
+    case 'c': case 'C':       // Turns culling off or on
+        culling = !culling;
+        break;
     case ' ':                 // Space stops the ball
+        updater.setPaused( true );
         glutIdleFunc    ( NULL );
         break;
     default:                  // Any key not specified above restarts animation
+        updater.setPaused( false );
         glutIdleFunc    ( idle );
         break;
 
@@ -310,7 +566,20 @@ reshape( int width, int height )
     left   = -right;
     bottom = - top;
     glViewport( 0, 0, width, height );
+    viewportHeight = height;
+
+}
 
+//----------------------------------------------------------------------------
+
+//  Reports, as the program exits, how many of the objects tested were culled
+void
+reportCulling( void )
+{
+    if ( culler.numTested() > 0 ) {
+        printf( "culled %ld of %ld objects tested (%.1f%%)\n", culler.numCulled(),
+                culler.numTested(), 100.0 * culler.culledRatio() );
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -318,22 +587,48 @@ reshape( int width, int height )
 int
 main( int argc, char **argv )
 {
-    glutInit( &argc, argv );
-    glutInitDisplayMode( GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH );
-    glutInitWindowSize( defaultWindowSize, defaultWindowSize );
+    // --headless renders frames into an offscreen buffer instead of a window
+    bool headless = headlessInit( argc, argv, defaultWindowSize, defaultWindowSize );
+
+    // --profile file writes the frame times when the program exits;
+    // --overlay shows them from the start
+    profiler.parseArgs( argc, argv );
+
+    // --fps n limits frames to n a second (0 for no limit)
+    limiter.parseArgs( argc, argv );
+    if ( headless ) limiter.setRate( 0.0 );
+
+    // movingGlobe [fieldDivs] adds a field of fieldDivs x fieldDivs pyramids
+    if ( argc >= 2 ) {
+        fieldDivs = atoi( argv[1] );
+        if ( fieldDivs < 0 || fieldDivs > 1000 ) {
+            fprintf( stderr, "usage: movingGlobe [fieldDivs], 0 <= fieldDivs <= 1000\n" );
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ( !headless ) {
+        glutInit( &argc, argv );
+        glutInitDisplayMode( GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH );
+        glutInitWindowSize( defaultWindowSize, defaultWindowSize );
 
-    // If you are using freeglut, the next two lines will check if 
-    // the code is truly 3.2. Otherwise, comment them out
-    
-    glutInitContextVersion( 3, 2 );
-    glutInitContextProfile( GLUT_CORE_PROFILE );
+        // If you are using freeglut, the next two lines will check if
+        // the code is truly 3.3, which instancing needs for
+        // glVertexAttribDivisor. Otherwise, comment them out
 
-    glutCreateWindow( "Moving Globe" );
+        glutInitContextVersion( 3, 3 );
+        glutInitContextProfile( GLUT_CORE_PROFILE );
+
+        glutCreateWindow( "Moving Globe" );
+    }
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     init();
+    atexit( reportCulling );
+
+    if ( headless ) return headlessRun( display, idle, reshape );
 
     glutDisplayFunc ( display    );
     glutKeyboardFunc( keyboard   );
@@ -341,6 +636,7 @@ main( int argc, char **argv )
     glutIdleFunc    ( idle       );
     glutReshapeFunc ( reshape    );
 
+    updater.start();
     glutMainLoop();
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,431 @@
+// File: manyBalls.cpp
+
+// Program to draw many balls bouncing between two walls and off each
+// other, with a perspective view; each ball squashes and stretches against
+// the walls like the ball in persPingPong2;
+// the user can change the position of the viewer using the arrow keys.
+// Usage: manyBalls [numBalls]
+// Adapted from Angel & Shreiner 2D Sierpinski Gasket, Color Cube programs
+// and recursive sphere.
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include "ballPhysics.h"
+#include "headless.h"
+#include "holeyShapes.h"
+#include "instancing.h"
+#include "profiler.h"
+#include "taskScheduler.h"
+#include "timestep.h"
+#include "vertexFormat.h"
+
+// window parameters
+const int defaultWindowSize = 768;
+
+// parameters for the walls (stretched cubes)
+const int numWallVertices = 8;
+const int numWallIndices  = 36; // 6 faces * 2 triangles * 3 vertices/triangle
+constexpr GLfloat wallWidth = 0.125;
+constexpr GLfloat wallSX = 0.0625; // 1/16 scale factor to get 1/8 width
+constexpr GLfloat wallDX = 0.9375; // move wall +|-15/16
+
+// parameters for creating the balls
+const int divs = 2;     // number of recursive divisions
+int numBallVertices =  6; // actual value computed in init
+int numBallIndices  = 24; // actual value computed in init
+
+// the balls: their number (set from the command line), sizes, and the
+// box they bounce in, which the walls close at x = +|-(1 - wallWidth)
+const int defaultNumBalls = 2000;
+const int maxNumBalls     = 100000;
+int numBalls = defaultNumBalls;
+const GLfloat minRadius = 0.02, maxRadius = 0.04;
+BallSystem *balls;
+mat4       *ballModels;        // one per ball, rebuilt every frame
+
+// the balls are moved, and their matrices built, on every hardware thread
+TaskScheduler& tasks = TaskScheduler::shared();
+
+// the balls move in fixed steps, stepsPerSecond a second, and are drawn
+// between the last two steps
+const double stepsPerSecond = 60.0;
+FixedTimestep timestep( 1.0 / stepsPerSecond );
+FrameLimiter  limiter( 60.0 );           // frames a second, 0 for no limit
+int stepsDue = 0;                        // steps display() has yet to take
+
+// parameters for viewer position
+const GLfloat initViewerDist  =  4.0;
+const GLfloat minViewerDist   =  2.0;
+const GLfloat maxViewerDist   = 10.0;
+const GLfloat maxOffsetRatio  =  1.0;
+const GLfloat deltaViewerDist =  0.25;
+const GLfloat deltaOffset     =  0.1;
+point4 eye( 0.0, 0.0, initViewerDist, 1.0 );
+const point4 at ( 0.0, 0.0, 0.0, 1.0 );
+const vec4   up ( 0.0, 1.0, 0.0, 0.0 );
+
+// constant matrices
+constexpr mat4 scaleWall = Scale( wallSX, 1.0, 1.0 );
+constexpr mat4 leftWall  = ConstMult( Translate( -wallDX, 0.0, 0.0 ), scaleWall );
+constexpr mat4 rightWall = ConstMult( Translate(  wallDX, 0.0, 0.0 ), scaleWall );
+
+int numVertices;
+int numIndices;
+
+GLuint  model_view;  // uniform location of the model_view matrix
+
+// per-instance model matrices: the two walls, set once, and the balls,
+// which change every frame
+InstanceBuffer wallInstances;
+InstanceBuffer ballInstances;
+
+// frame timing, by phase of display()
+enum { PHASE_SIMULATE, PHASE_MATRICES, PHASE_UPLOAD, PHASE_DRAW, PHASE_SWAP,
+       NUM_PHASES };
+const char *phaseNames[NUM_PHASES] = { "simulate", "matrices", "upload", "draw",
+                                       "swap" };
+FrameProfiler profiler( NUM_PHASES, phaseNames );
+
+// Projection transformation parameters
+const GLfloat dimScale = 0.1;
+GLfloat left   = -0.1, right =  0.1,
+        bottom = -0.1, top   =  0.1,
+        zNear  =  0.4, zFar  = 20.0;
+
+GLuint  projection;  // uniform location of the projection matrix
+
+//----------------------------------------------------------------------------
+
+void
+init( void )
+{
+    // Compute the number of vertices and indices in the ball and the totals
+    for (int i = 0; i < divs; i++) numBallIndices *= 4;
+    numBallVertices = numBallIndices / 6 + 2;
+    numVertices = numWallVertices + numBallVertices;
+    numIndices  = numWallIndices + numBallIndices;
+
+    // Build the vertices at full precision, interleaved (position and
+    // color), and allocate the indices
+    VertexFormat fullFormat;
+    fullFormat.add( "vPosition", 4, GL_FLOAT ).add( "vColor", 4, GL_FLOAT );
+    InterleavedVertices fullVertices( fullFormat, numVertices );
+    Strided<point4> points = fullVertices.attribute<point4>( "vPosition" );
+    Strided<color4> colors = fullVertices.attribute<color4>( "vColor" );
+    GLushort *indices = new GLushort[numIndices];
+
+    // Set up the wall
+    cube( points, 0, indices, 0 );
+    randomColors( numWallVertices, colors, 0,               // blue-black
+                  color4( 0.0, 0.0, 0.0, 1.0 ),
+                  color4( 0.1, 0.1, 0.3, 1.0 ) );
+
+    // Set up the ball, of radius 1; each ball's model matrix scales it
+    spherichedron( divs, points, numWallVertices, indices, numWallIndices );
+    randomColors( numBallVertices, colors, numWallVertices, // bright red
+                  color4( 0.8, 0.0, 0.0, 1.0 ),
+                  color4( 1.0, 0.2, 0.1, 1.0 ) );
+
+    // Pack each vertex into 16 bytes instead of 32: 3 floats of position
+    // (the shader still gets w = 1) and 4 normalized bytes of color
+    VertexFormat format;
+    format.add( "vPosition", 3, GL_FLOAT ).add( "vColor", 4, GL_UNSIGNED_BYTE, GL_TRUE );
+    InterleavedVertices vertices( format, numVertices );
+    convertVertices( fullVertices, vertices );
+
+    // Create a vertex array object
+    GLuint vao;
+    glGenVertexArrays( 1, &vao );
+    glBindVertexArray( vao );
+
+    // Create and initialize a buffer object
+    GLuint buffer;
+    glGenBuffers( 1, &buffer );
+    glBindBuffer( GL_ARRAY_BUFFER, buffer );
+    glBufferData( GL_ARRAY_BUFFER, vertices.size(), vertices.data(),
+                  GL_STATIC_DRAW );
+
+    // Create and initialize the index buffer
+    GLuint indexBuffer;
+    glGenBuffers( 1, &indexBuffer );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(GLushort),
+                  indices, GL_STATIC_DRAW );
+
+    // Load shaders and use the resulting shader program
+    GLuint program = InitShader( "manyBalls_vs.glsl", "manyBalls_fs.glsl" );
+    glUseProgram( program );
+
+    // Initialize the vertex position and color attributes from the vertex shader
+    format.enable( program );
+
+    model_view = glGetUniformLocation( program, "model_view" );
+    projection = glGetUniformLocation( program, "projection" );
+
+    // Set up the walls' model matrices
+    const mat4 walls[2] = { leftWall, rightWall };
+    wallInstances.create( program, "instanceModel", 2, GL_STATIC_DRAW );
+    wallInstances.update( walls, 2 );
+
+    balls      = new BallSystem( numBalls, minRadius, maxRadius, 1.0 - wallWidth );
+    ballModels = new mat4[numBalls];
+    ballInstances.create( program, "instanceModel", numBalls, GL_STREAM_DRAW );
+
+    profiler.enableGpuTimer();
+
+    glEnable( GL_DEPTH_TEST );
+    glClearColor( 1.0, 0.9, 0.75, 1.0 ); // light yellow background
+}
+
+//----------------------------------------------------------------------------
+
+void
+display( void )
+{
+    profiler.beginFrame();
+
+    // move the balls by the steps that are due
+    profiler.phase( PHASE_SIMULATE );
+    for ( ; stepsDue > 0; stepsDue-- ) {
+        balls->step( &tasks );
+    }
+
+    // clear the window
+    glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+
+    profiler.phase( PHASE_MATRICES );
+
+    // set up projection matrix
+    mat4 p = Frustum( left, right, bottom, top, zNear, zFar );
+
+    // set up view position
+    mat4 lookAt = LookAt( eye, at, up );
+
+    // set up the balls' model matrices, between the last two steps of
+    // the simulation
+    balls->modelMatrices( ballModels, timestep.alpha(), &tasks );
+
+    profiler.phase( PHASE_UPLOAD );
+
+    // the model part of each object comes from its instance buffer, so
+    // model_view only holds the view
+    glUniformMatrix4fv( projection, 1, GL_TRUE, p );
+    glUniformMatrix4fv( model_view, 1, GL_TRUE, lookAt );
+    ballInstances.update( ballModels, numBalls );
+
+    profiler.phase( PHASE_DRAW );
+
+    // draw both walls with one call
+    wallInstances.bind();
+    glDrawElementsInstanced( GL_TRIANGLES, numWallIndices, GL_UNSIGNED_SHORT,
+                             BUFFER_OFFSET(0), wallInstances.size() );
+
+    // draw all the balls with one call
+    ballInstances.bind();
+    glDrawElementsInstanced( GL_TRIANGLES, numBallIndices, GL_UNSIGNED_SHORT,
+                             BUFFER_OFFSET(numWallIndices * sizeof(GLushort)),
+                             ballInstances.size() );
+
+    profiler.drawOverlay();
+
+    profiler.phase( PHASE_SWAP );
+    sampleSwapBuffers( );
+
+    profiler.endFrame();
+}
+
+//----------------------------------------------------------------------------
+
+void
+idle( void )
+{
+    // the steps are taken at the start of the next frame, so the profiler
+    // times them with it
+    stepsDue += timestep.advance();
+
+    // sleep rather than draw frames no one will see
+    limiter.wait();
+    samplePostRedisplay( );
+}
+
+//----------------------------------------------------------------------------
+
+void
+keyboard( unsigned char key, int x, int y )
+{
+    switch ( key ) {
+        GLfloat offsetRatio;
+    case 033:                 // Escape key exits program
+        exit( EXIT_SUCCESS );
+        break;
+    case 'a': case 'A':       // Moves viewer left
+        offsetRatio = eye.x / eye.z;
+        if (offsetRatio > -maxOffsetRatio) {
+          offsetRatio -= deltaOffset;
+          eye.x = eye.z * offsetRatio;
+        }
+        break;
+    case 'd': case 'D':       // Moves viewer right
+        offsetRatio = eye.x / eye.z;
+        if (offsetRatio < maxOffsetRatio) {
+          offsetRatio += deltaOffset;
+          eye.x = eye.z * offsetRatio;
+        }
+        break;
+    case 'w': case 'W':       // Moves viewer up
+        offsetRatio = eye.y / eye.z;
+        if (offsetRatio < maxOffsetRatio) {
+          offsetRatio += deltaOffset;
+          eye.y = eye.z * offsetRatio;
+        }
+        break;
+    case 's': case 'S':       // Moves viewer down
+        offsetRatio = eye.y / eye.z;
+        if (offsetRatio > -maxOffsetRatio) {
+          offsetRatio -= deltaOffset;
+          eye.y = eye.z * offsetRatio;
+        }
+        break;
+    case 't': case 'T':       // Shows or hides the frame times
+        profiler.toggleOverlay();
+        break;
+    case ' ':                 // Space stops the balls
+        glutIdleFunc    ( NULL );
+        break;
+    default:                  // Any key not specified above restarts animation
+        timestep.reset();     // the time stopped does not count
+        glutIdleFunc    ( idle );
+        break;
+
+    }
+
+    glutPostRedisplay( );
+}
+
+//----------------------------------------------------------------------------
+
+void
+specialKey( int key, int x, int y )
+{
+    switch ( key ) {
+        GLfloat offsetRatio;
+    case GLUT_KEY_PAGE_UP:    // Moves viewer in
+        if (eye.z > minViewerDist) {
+          eye.z -= deltaViewerDist;
+          offsetRatio = eye.z / (eye.z + deltaViewerDist);
+          eye.x *= offsetRatio;
+          eye.y *= offsetRatio;
+        }
+        break;
+    case GLUT_KEY_PAGE_DOWN:  // Moves viewer out
+        if (eye.z < maxViewerDist) {
+          eye.z += deltaViewerDist;
+          offsetRatio = eye.z / (eye.z - deltaViewerDist);
+          eye.x *= offsetRatio;
+          eye.y *= offsetRatio;
+        }
+        break;
+    case GLUT_KEY_LEFT:       // Moves viewer left
+        offsetRatio = eye.x / eye.z;
+        if (offsetRatio > -maxOffsetRatio) {
+          offsetRatio -= deltaOffset;
+          eye.x = eye.z * offsetRatio;
+        }
+        break;
+    case GLUT_KEY_RIGHT:      // Moves viewer right
+        offsetRatio = eye.x / eye.z;
+        if (offsetRatio < maxOffsetRatio) {
+          offsetRatio += deltaOffset;
+          eye.x = eye.z * offsetRatio;
+        }
+        break;
+    case GLUT_KEY_UP:         // Moves viewer up
+        offsetRatio = eye.y / eye.z;
+        if (offsetRatio < maxOffsetRatio) {
+          offsetRatio += deltaOffset;
+          eye.y = eye.z * offsetRatio;
+        }
+        break;
+    case GLUT_KEY_DOWN:       // Moves viewer down
+        offsetRatio = eye.y / eye.z;
+        if (offsetRatio > -maxOffsetRatio) {
+          offsetRatio -= deltaOffset;
+          eye.y = eye.z * offsetRatio;
+        }
+        break;
+
+    }
+
+    glutPostRedisplay( );
+}
+
+//----------------------------------------------------------------------------
+
+void
+reshape( int width, int height )
+{
+    right  = dimScale * width  / defaultWindowSize;
+    left   = -right;
+    top    = dimScale * height / defaultWindowSize;
+    bottom = - top;
+    glViewport( 0, 0, width, height );
+
+}
+
+//----------------------------------------------------------------------------
+
+int
+main( int argc, char **argv )
+{
+    // --headless renders frames into an offscreen buffer instead of a window
+    bool headless = headlessInit( argc, argv, defaultWindowSize, defaultWindowSize );
+
+    // --profile file writes the frame times when the program exits;
+    // --overlay shows them from the start
+    profiler.parseArgs( argc, argv );
+
+    // --fps n limits frames to n a second (0 for no limit); headless, each
+    // frame is one step, so runs are repeatable
+    limiter.parseArgs( argc, argv );
+    // what is left is the number of balls
+    if ( argc > 1 ) {
+        numBalls = atoi( argv[1] );
+        if (numBalls < 1) numBalls = 1;
+        if (numBalls > maxNumBalls) numBalls = maxNumBalls;
+    }
+    if ( headless ) {
+        timestep.setFrameTime( timestep.stepSeconds() );
+        limiter.setRate( 0.0 );
+    }
+
+    if ( !headless ) {
+        glutInit( &argc, argv );
+        glutInitDisplayMode( GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH );
+/****** change to parameter for initial window size ******/
+        glutInitWindowSize( defaultWindowSize, defaultWindowSize );
+
+        // If you are using freeglut, the next two lines will check if
+        // the code is truly 3.3, which instancing needs for
+        // glVertexAttribDivisor. Otherwise, comment them out
+
+        glutInitContextVersion( 3, 3 );
+        glutInitContextProfile( GLUT_CORE_PROFILE );
+
+        glutCreateWindow( "Many Balls Bouncing between Two Walls" );
+    }
+
+    glewExperimental = GL_TRUE;
+    glewInit();
+
+    init();
+
+    if ( headless ) return headlessRun( display, idle, reshape );
+
+    glutDisplayFunc ( display    );
+    glutKeyboardFunc( keyboard   );
+    glutSpecialFunc ( specialKey );
+    glutIdleFunc    ( idle       );
+    glutReshapeFunc ( reshape    );
+
+    glutMainLoop();
+    return EXIT_SUCCESS;
+}
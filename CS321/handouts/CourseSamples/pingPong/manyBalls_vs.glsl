@@ -0,0 +1,16 @@
+#version 150
+
+in  vec4 vPosition;
+in  vec4 vColor;
+in  mat4 instanceModel;  // model matrix, one per instance
+out vec4 color;
+
+uniform mat4 model_view;  // viewing transformation, shared by all instances
+uniform mat4 projection;
+
+void
+main()
+{
+    color = vColor;
+    gl_Position = projection * model_view * instanceModel * vPosition;
+}
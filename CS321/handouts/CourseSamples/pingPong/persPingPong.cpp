@@ -7,6 +7,7 @@
 // and recursive sphere.
 
 #include "/usr/people/classes/CS321/include/Angel.h"
+#include "headless.h"
 #include "holeyShapes.h"
 
 // window parameters
@@ -14,30 +15,30 @@ const int defaultWindowSize = 768;
 
 // parameters for the walls (stretched cubes)
 const int numWallPoints = 36;  // 6 faces * 2 triangles * 3 vertices/triangle
-const GLfloat wallWidth = 0.125;
-const GLfloat wallSX = 0.0625; // 1/16 scale factor to get 1/8 width
-const GLfloat wallDX = 0.9375; // move wall +|-15/16
+constexpr GLfloat wallWidth = 0.125;
+constexpr GLfloat wallSX = 0.0625; // 1/16 scale factor to get 1/8 width
+constexpr GLfloat wallDX = 0.9375; // move wall +|-15/16
 
 // parameters for creating the ball
 const int divs = 3;     // number of recursive divisions
 int numBallPoints = 24; // actual value computed in init
 
 // parameters for the ball transformation matrices
-const GLfloat radius = 0.5;
-const GLfloat sx = radius, sy = radius, sz = radius; // scale factors
+constexpr GLfloat radius = 0.5;
+constexpr GLfloat sx = radius, sy = radius, sz = radius; // scale factors
 GLfloat theta = 0.0;                                 // rotation
 GLfloat deltaTheta = 1.5;                            // rotation change
 GLfloat deltaDX = 1.0 / 128.0;                       // change in dx
 GLfloat dx = 0.0, dy = 0.0, dz = 0.0;                // translation factors
-const GLfloat compressLimit = radius / 16.0;         // compression limit
+constexpr GLfloat compressLimit = radius / 16.0;     // compression limit
 GLfloat compressFactor = 1.0;                        // compression factor
 int phase = 0;                                       // phase of compression cycle
 
 // constant matrices
-const mat4 scaleBall = Scale( sx, sy, sz );
-const mat4 scaleWall = Scale( wallSX, 1.0, 1.0 );
-const mat4 leftWall  = Translate( -wallDX, 0.0, 0.0 ) * scaleWall;
-const mat4 rightWall = Translate(  wallDX, 0.0, 0.0 ) * scaleWall;
+constexpr mat4 scaleBall = Scale( sx, sy, sz );
+constexpr mat4 scaleWall = Scale( wallSX, 1.0, 1.0 );
+constexpr mat4 leftWall  = ConstMult( Translate( -wallDX, 0.0, 0.0 ), scaleWall );
+constexpr mat4 rightWall = ConstMult( Translate(  wallDX, 0.0, 0.0 ), scaleWall );
 
 int numPoints;
 
@@ -151,7 +152,7 @@ display( void )
 
     glDrawArrays( GL_TRIANGLES, numWallPoints, numBallPoints );
 
-    glutSwapBuffers( );
+    sampleSwapBuffers( );
 }
 
 //----------------------------------------------------------------------------
@@ -198,7 +199,7 @@ idle( void )
     theta -= deltaTheta;
     if (theta < 0.0) theta += 360.0;
 
-    glutPostRedisplay( );
+    samplePostRedisplay( );
 }
 
 //----------------------------------------------------------------------------
@@ -238,24 +239,30 @@ reshape( int width, int height )
 int
 main( int argc, char **argv )
 {
-    glutInit( &argc, argv );
-    glutInitDisplayMode( GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH );
+    // --headless renders frames into an offscreen buffer instead of a window
+    bool headless = headlessInit( argc, argv, defaultWindowSize, defaultWindowSize );
+    if ( !headless ) {
+        glutInit( &argc, argv );
+        glutInitDisplayMode( GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH );
 /****** change to parameter for initial window size ******/
-    glutInitWindowSize( defaultWindowSize, defaultWindowSize );
+        glutInitWindowSize( defaultWindowSize, defaultWindowSize );
 
-    // If you are using freeglut, the next two lines will check if 
-    // the code is truly 3.2. Otherwise, comment them out
-    
-    glutInitContextVersion( 3, 2 );
-    glutInitContextProfile( GLUT_CORE_PROFILE );
+        // If you are using freeglut, the next two lines will check if
+        // the code is truly 3.2. Otherwise, comment them out
 
-    glutCreateWindow( "Ball Bouncing between Two Walls in Perspecitve" );
+        glutInitContextVersion( 3, 2 );
+        glutInitContextProfile( GLUT_CORE_PROFILE );
+
+        glutCreateWindow( "Ball Bouncing between Two Walls in Perspecitve" );
+    }
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     init();
 
+    if ( headless ) return headlessRun( display, idle, reshape );
+
     glutDisplayFunc ( display  );
     glutKeyboardFunc( keyboard );
     glutIdleFunc    ( idle     );
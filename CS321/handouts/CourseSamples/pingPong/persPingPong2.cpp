@@ -8,32 +8,61 @@
 // and recursive sphere.
 
 #include "/usr/people/classes/CS321/include/Angel.h"
+#include "frameHandoff.h"
+#include "headless.h"
 #include "holeyShapes.h"
+#include "instancing.h"
+#include "lod.h"
+#include "profiler.h"
+#include "sceneGraph.h"
+#include "timestep.h"
+#include "uniformBlocks.h"
+#include "vertexFormat.h"
 
 // window parameters
 const int defaultWindowSize = 768;
 
 // parameters for the walls (stretched cubes)
-const int numWallPoints = 36;  // 6 faces * 2 triangles * 3 vertices/triangle
-const GLfloat wallWidth = 0.125;
-const GLfloat wallSX = 0.0625; // 1/16 scale factor to get 1/8 width
-const GLfloat wallDX = 0.9375; // move wall +|-15/16
-
-// parameters for creating the ball
-const int divs = 3;     // number of recursive divisions
-int numBallPoints = 24; // actual value computed in init
+const int numWallVertices = 8;
+const int numWallIndices  = 36; // 6 faces * 2 triangles * 3 vertices/triangle
+constexpr GLfloat wallWidth = 0.125;
+constexpr GLfloat wallSX = 0.0625; // 1/16 scale factor to get 1/8 width
+constexpr GLfloat wallDX = 0.9375; // move wall +|-15/16
+
+// parameters for creating the ball, at levels of detail from maxDivs
+// recursive divisions, the divisions the ball always had, down to minDivs;
+// the level with colorDivs is colored and the others copy it
+const int maxDivs   = 3;
+const int minDivs   = 2;
+const int colorDivs = 3;
+const int numBallLevels = maxDivs - minDivs + 1;
 
 // parameters for the ball transformation matrices
-const GLfloat radius = 0.5;
-const GLfloat sx = radius, sy = radius, sz = radius; // scale factors
+constexpr GLfloat radius = 0.5;
+constexpr GLfloat sx = radius, sy = radius, sz = radius; // scale factors
 GLfloat theta = 0.0;                                 // rotation
 GLfloat deltaTheta = 1.5;                            // rotation change
 GLfloat deltaDX = 1.0 / 128.0;                       // change in dx
 GLfloat dx = 0.0, dy = 0.0, dz = 0.0;                // translation factors
-const GLfloat compressLimit = radius / 16.0;         // compression limit
+constexpr GLfloat compressLimit = radius / 16.0;     // compression limit
 GLfloat compressFactor = 1.0;                        // compression factor
 int phase = 0;                                       // phase of compression cycle
 
+// the ball's motion is simulated on an update thread, stepsPerSecond steps
+// a second, and only that thread uses the variables above; each step
+// passes the ball's last two states to display(), which draws the ball
+// between them
+struct BallPacket {
+    GLfloat prevTheta, prevDX, prevCompressFactor;
+    GLfloat theta, dx, compressFactor;
+    UpdateThread::Clock::time_point time;   // when the step was taken
+};
+TripleBuffer<BallPacket> packets;
+const double stepsPerSecond = 60.0;
+void step( void );
+UpdateThread  updater( 1.0 / stepsPerSecond, step );
+FrameLimiter  limiter( 60.0 );           // frames a second, 0 for no limit
+
 // parameters for viewer position
 const GLfloat initViewerDist  =  4.0;
 const GLfloat minViewerDist   =  2.0;
@@ -46,14 +75,44 @@ const point4 at ( 0.0, 0.0, 0.0, 1.0 );
 const vec4   up ( 0.0, 1.0, 0.0, 0.0 );
 
 // constant matrices
-const mat4 scaleBall = Scale( sx, sy, sz );
-const mat4 scaleWall = Scale( wallSX, 1.0, 1.0 );
-const mat4 leftWall  = Translate( -wallDX, 0.0, 0.0 ) * scaleWall;
-const mat4 rightWall = Translate(  wallDX, 0.0, 0.0 ) * scaleWall;
-
-int numPoints;
-
-GLuint  model_view;  // uniform location of the model_view matrix
+constexpr mat4 scaleBall = Scale( sx, sy, sz );
+constexpr mat4 scaleWall = Scale( wallSX, 1.0, 1.0 );
+
+// the scene: each wall is moved into place, then scaled; the ball is
+// moved, spun, squashed and scaled, and the first three change each frame.
+// The walls' scaled nodes are added one after the other, so their world
+// matrices can be uploaded together.
+SceneGraph scene;
+int leftWallNode, ballMoveNode, ballSpinNode, ballSquashNode, ballNode;
+
+int numVertices;
+int numIndices;
+
+// the ball is drawn at the coarsest level of detail that is off by at most
+// lodTolerance pixels: about what divs 3 is off by at the nearest viewer
+// distance, so that no level is drawn worse than the ball always was there
+const GLfloat lodTolerance = 8.0;
+LodChain    ballLod;
+ShapeBounds ballBounds;
+int         ballLevel = -1;               // the level drawn last frame
+int         viewportHeight = defaultWindowSize;
+
+// the projection and view, in a uniform block copied only when they
+// change, and each draw's object matrix, in a ring of uniform blocks
+FrameBlock  frameBlock;
+UniformRing objectBlocks;
+const ObjectUniforms notMoved = { mat4c( mat4() ) };  // for draws placed by
+                                                      // their instances alone
+
+// per-instance model matrices: the two walls, set once, and the ball's
+// one, left as the identity
+InstanceBuffer wallInstances;
+InstanceBuffer ballInstance;
+
+// frame timing, by phase of display()
+enum { PHASE_MATRICES, PHASE_UPLOAD, PHASE_DRAW, PHASE_SWAP, NUM_PHASES };
+const char *phaseNames[NUM_PHASES] = { "matrices", "upload", "draw", "swap" };
+FrameProfiler profiler( NUM_PHASES, phaseNames );
 
 // Projection transformation parameters
 const GLfloat dimScale = 0.1;
@@ -61,32 +120,66 @@ GLfloat left   = -0.1, right =  0.1,
         bottom = -0.1, top   =  0.1,
         zNear  =  0.4, zFar  = 20.0;
 
-GLuint  projection;  // uniform location of the projection matrix
-
 //----------------------------------------------------------------------------
 
 void
 init( void )
 {
-    // Compute number of points in the ball and the total number of points
-    for (int i = 0; i < divs; i++) numBallPoints *= 4;
-    numPoints = numWallPoints + numBallPoints;
+    // Generate the ball at each level of detail, finest first, and
+    // compute the totals
+    const ShapeMesh *ballLevels[numBallLevels];
+    numVertices = numWallVertices;
+    numIndices  = numWallIndices;
+    for (int l = 0; l < numBallLevels; l++) {
+        ballLevels[l] = ShapeCache::shared().get( SHAPE_SPHERICHEDRON, maxDivs - l );
+        numVertices += ballLevels[l]->numVertices;
+        numIndices  += ballLevels[l]->numIndices;
+    }
 
-    // Allocate the arrays for the points and the colors
-    point4 *points = new point4[numPoints];
-    color4 *colors = new color4[numPoints];
+    // Build the vertices at full precision, interleaved (position and
+    // color), and allocate the indices
+    VertexFormat fullFormat;
+    fullFormat.add( "vPosition", 4, GL_FLOAT ).add( "vColor", 4, GL_FLOAT );
+    InterleavedVertices fullVertices( fullFormat, numVertices );
+    Strided<point4> points = fullVertices.attribute<point4>( "vPosition" );
+    Strided<color4> colors = fullVertices.attribute<color4>( "vColor" );
+    GLushort *indices = new GLushort[numIndices];
 
     // Set up the wall
-    cube( points, 0 );
-    randomColors( numWallPoints, colors, 0,             // blue-black
+    cube( points, 0, indices, 0 );
+    randomColors( numWallVertices, colors, 0,               // blue-black
                   color4( 0.0, 0.0, 0.0, 1.0 ),
                   color4( 0.1, 0.1, 0.3, 1.0 ) );
 
-    // Set up the ball
-    spherichedron( divs, points, numWallPoints );
-    randomColors( numBallPoints, colors, numWallPoints, // bright red
+    // Set up the ball's levels
+    int vStart = numWallVertices, iStart = numWallIndices;
+    for (int l = 0; l < numBallLevels; l++) {
+        const ShapeMesh& mesh = *ballLevels[l];
+        iStart = ballLod.add( mesh, sphereMeshError( mesh ), points, vStart,
+                              indices, iStart );
+        vStart += mesh.numVertices;
+    }
+    ballBounds = ballLevels[0]->bounds;
+
+    // color one, and give the others its colors, so that changing level
+    // does not change the ball's colors
+    const LodLevel& colored = ballLod.level( maxDivs - colorDivs );
+    randomColors( colored.numVertices, colors, colored.vStart, // bright red
                   color4( 0.8, 0.0, 0.0, 1.0 ),
                   color4( 1.0, 0.2, 0.1, 1.0 ) );
+    for (int l = 0; l < numBallLevels; l++) {
+        const LodLevel& level = ballLod.level( l );
+        if (l == maxDivs - colorDivs) continue;
+        copyNearestColors( points, colors, level.vStart, level.numVertices,
+                           colored.vStart, colored.numVertices );
+    }
+
+    // Pack each vertex into 16 bytes instead of 32: 3 floats of position
+    // (the shader still gets w = 1) and 4 normalized bytes of color
+    VertexFormat format;
+    format.add( "vPosition", 3, GL_FLOAT ).add( "vColor", 4, GL_UNSIGNED_BYTE, GL_TRUE );
+    InterleavedVertices vertices( format, numVertices );
+    convertVertices( fullVertices, vertices );
 
     // Create a vertex array object
     GLuint vao;
@@ -97,30 +190,52 @@ init( void )
     GLuint buffer;
     glGenBuffers( 1, &buffer );
     glBindBuffer( GL_ARRAY_BUFFER, buffer );
-    glBufferData( GL_ARRAY_BUFFER, numPoints * (sizeof(point4) + sizeof(color4)),
-                  NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ARRAY_BUFFER, 0,
-                     numPoints * sizeof(point4), points );
-    glBufferSubData( GL_ARRAY_BUFFER, numPoints * sizeof(point4),
-                     numPoints * sizeof(color4), colors );
+    glBufferData( GL_ARRAY_BUFFER, vertices.size(), vertices.data(),
+                  GL_STATIC_DRAW );
+
+    // Create and initialize the index buffer
+    GLuint indexBuffer;
+    glGenBuffers( 1, &indexBuffer );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(GLushort),
+                  indices, GL_STATIC_DRAW );
 
     // Load shaders and use the resulting shader program
     GLuint program = InitShader( "persPingPong2_vs.glsl", "persPingPong2_fs.glsl" );
     glUseProgram( program );
 
-    // Initialize the vertex position attribute from the vertex shader
-    GLuint vPosition = glGetAttribLocation( program, "vPosition" );
-    glEnableVertexAttribArray( vPosition );
-    glVertexAttribPointer( vPosition, 4, GL_FLOAT, GL_FALSE, 0,
-                           BUFFER_OFFSET(0) );
+    // Initialize the vertex position and color attributes from the vertex shader
+    format.enable( program );
 
-    GLuint vColor = glGetAttribLocation( program, "vColor" );
-    glEnableVertexAttribArray( vColor );
-    glVertexAttribPointer( vColor, 4, GL_FLOAT, GL_FALSE, 0,
-                           BUFFER_OFFSET(numPoints * sizeof(point4)) );
+    frameBlock.create( program );
+    objectBlocks.create( program, "Object", 4 );
 
-    model_view = glGetUniformLocation( program, "model_view" );
-    projection = glGetUniformLocation( program, "projection" );
+    // Set up the scene, and the walls' model matrices
+    int leftWallMove  = scene.add( Translate( -wallDX, 0.0, 0.0 ) );
+    int rightWallMove = scene.add( Translate(  wallDX, 0.0, 0.0 ) );
+    leftWallNode      = scene.add( scaleWall, leftWallMove );
+    scene.add( scaleWall, rightWallMove );
+    ballMoveNode      = scene.add();
+    ballSpinNode      = scene.add( mat4(), ballMoveNode );
+    ballSquashNode    = scene.add( mat4(), ballSpinNode );
+    ballNode          = scene.add( scaleBall, ballSquashNode );
+    scene.update();
+
+    wallInstances.create( program, "instanceModel", 2, GL_STATIC_DRAW );
+    wallInstances.update( &scene.world( leftWallNode ), 2 );
+
+    // the ball is placed by its object block, so its one instance is not
+    // moved
+    const mat4 identity;
+    ballInstance.create( program, "instanceModel", 1, GL_STATIC_DRAW );
+    ballInstance.update( &identity, 1 );
+
+    // the ball as it starts, until the first step
+    BallPacket start = { theta, dx, compressFactor, theta, dx, compressFactor,
+                         UpdateThread::Clock::now() };
+    packets.fill( start );
+
+    profiler.enableGpuTimer();
 
     glEnable( GL_DEPTH_TEST );
     glClearColor( 1.0, 0.9, 0.75, 1.0 ); // light yellow background
@@ -131,43 +246,82 @@ init( void )
 void
 display( void )
 {
+    profiler.beginFrame();
+
     // clear the window
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
+    profiler.phase( PHASE_MATRICES );
+
     // set up projection matrix
     mat4 p = Frustum( left, right, bottom, top, zNear, zFar );
-    glUniformMatrix4fv( projection, 1, GL_TRUE, p );
 
     // set up view position
     mat4 lookAt = LookAt( eye, at, up );
 
-    // draw the left wall
-    mat4 mv = lookAt * leftWall;
-    glUniformMatrix4fv( model_view, 1, GL_TRUE, mv );
-    glDrawArrays( GL_TRIANGLES, 0, numWallPoints );
-
-    // draw the right wall
-    mv = lookAt * rightWall;
-    glUniformMatrix4fv( model_view, 1, GL_TRUE, mv );
-    glDrawArrays( GL_TRIANGLES, 0, numWallPoints );
+    // set up the ball's model matrix, between the last two steps of the
+    // simulation
+    packets.acquire();
+    const BallPacket& b = packets.reading();
+    GLfloat alpha = updater.alpha( b.time );
+    GLfloat dTheta = b.theta - b.prevTheta;
+    if (dTheta > 180.0) dTheta -= 360.0;        // theta wrapped around
+    if (dTheta < -180.0) dTheta += 360.0;
+    GLfloat drawTheta    = b.prevTheta + alpha * dTheta;
+    GLfloat drawDX       = b.prevDX + alpha * (b.dx - b.prevDX);
+    GLfloat drawCompress = b.prevCompressFactor +
+                           alpha * (b.compressFactor - b.prevCompressFactor);
+    scene.setLocal( ballMoveNode, Translate( drawDX, dy, dz ) );
+    scene.setLocal( ballSpinNode, RotateY( drawTheta ) );
+    scene.setLocal( ballSquashNode,
+                    Scale( drawCompress, 1 / drawCompress, 1 / drawCompress ) );
+    scene.update();
+
+    // and its level of detail
+    LodView view( p, viewportHeight, eye, lodTolerance );
+    ballLevel = ballLod.select( view, scene.world( ballNode ), ballBounds, ballLevel );
+
+    profiler.phase( PHASE_UPLOAD );
+
+    // the projection and view are copied only when they change; the model
+    // part of each object comes from its object block and instance buffer
+    frameBlock.setProjection( p );
+    frameBlock.setView( lookAt );
+    frameBlock.upload();
+    objectBlocks.beginFrame();
+
+    profiler.phase( PHASE_DRAW );
+
+    // draw both walls with one call
+    objectBlocks.push( notMoved );
+    wallInstances.bind();
+    glDrawElementsInstanced( GL_TRIANGLES, numWallIndices, GL_UNSIGNED_SHORT,
+                             BUFFER_OFFSET(0), wallInstances.size() );
 
     // draw the ball
-    mv = lookAt * 
-         Translate( dx, dy, dz ) *
-         RotateY( theta ) *
-         Scale( compressFactor, 1 / compressFactor, 1 / compressFactor ) *
-         scaleBall;
-    glUniformMatrix4fv( model_view, 1, GL_TRUE, mv );
+    ObjectUniforms ball = { mat4c( scene.world( ballNode ) ) };
+    objectBlocks.push( ball );
+    const LodLevel& level = ballLod.level( ballLevel );
+    ballInstance.bind();
+    glDrawElementsInstanced( GL_TRIANGLES, level.numIndices, GL_UNSIGNED_SHORT,
+                             BUFFER_OFFSET(level.iStart * sizeof(GLushort)),
+                             ballInstance.size() );
+
+    objectBlocks.endFrame();
 
-    glDrawArrays( GL_TRIANGLES, numWallPoints, numBallPoints );
+    profiler.drawOverlay();
 
-    glutSwapBuffers( );
+    profiler.phase( PHASE_SWAP );
+    sampleSwapBuffers( );
+
+    profiler.endFrame();
 }
 
 //----------------------------------------------------------------------------
 
+//  One step of the ball's motion
 void
-idle( void )
+simulate( void )
 {
     dx += deltaDX;
     GLfloat dist2wall = (1.0 - wallWidth) - (radius + fabs(dx));
@@ -207,8 +361,38 @@ idle( void )
 
     theta -= deltaTheta;
     if (theta < 0.0) theta += 360.0;
+}
 
-    glutPostRedisplay( );
+//----------------------------------------------------------------------------
+
+//  One step on the update thread, passed on to display()
+void
+step( void )
+{
+    BallPacket& b = packets.writing();
+    b.prevTheta          = theta;
+    b.prevDX             = dx;
+    b.prevCompressFactor = compressFactor;
+    simulate();
+    b.theta          = theta;
+    b.dx             = dx;
+    b.compressFactor = compressFactor;
+    b.time           = UpdateThread::Clock::now();
+    packets.publish();
+}
+
+//----------------------------------------------------------------------------
+
+void
+idle( void )
+{
+    // headless, each frame is one step, taken here, so runs are
+    // repeatable
+    if ( !updater.running() ) updater.runStep();
+
+    // sleep rather than draw frames no one will see
+    limiter.wait();
+    samplePostRedisplay( );
 }
 
 //----------------------------------------------------------------------------
@@ -249,10 +433,15 @@ keyboard( unsigned char key, int x, int y )
           eye.y = eye.z * offsetRatio;
         }
         break;
+    case 't': case 'T':       // Shows or hides the frame times
+        profiler.toggleOverlay();
+        break;
     case ' ':                 // Space stops the ball
+        updater.setPaused( true );
         glutIdleFunc    ( NULL );
         break;
     default:                  // Any key not specified above restarts animation
+        updater.setPaused( false );
         glutIdleFunc    ( idle );
         break;
 
@@ -328,6 +517,7 @@ reshape( int width, int height )
     top    = dimScale * height / defaultWindowSize;
     bottom = - top;
     glViewport( 0, 0, width, height );
+    viewportHeight = height;
 
 }
 
@@ -336,30 +526,47 @@ reshape( int width, int height )
 int
 main( int argc, char **argv )
 {
-    glutInit( &argc, argv );
-    glutInitDisplayMode( GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH );
+    // --headless renders frames into an offscreen buffer instead of a window
+    bool headless = headlessInit( argc, argv, defaultWindowSize, defaultWindowSize );
+
+    // --profile file writes the frame times when the program exits;
+    // --overlay shows them from the start
+    profiler.parseArgs( argc, argv );
+
+    // --fps n limits frames to n a second (0 for no limit)
+    limiter.parseArgs( argc, argv );
+    if ( headless ) limiter.setRate( 0.0 );
+
+    if ( !headless ) {
+        glutInit( &argc, argv );
+        glutInitDisplayMode( GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH );
 /****** change to parameter for initial window size ******/
-    glutInitWindowSize( defaultWindowSize, defaultWindowSize );
+        glutInitWindowSize( defaultWindowSize, defaultWindowSize );
 
-    // If you are using freeglut, the next two lines will check if 
-    // the code is truly 3.2. Otherwise, comment them out
-    
-    glutInitContextVersion( 3, 2 );
-    glutInitContextProfile( GLUT_CORE_PROFILE );
+        // If you are using freeglut, the next two lines will check if
+        // the code is truly 3.3, which instancing needs for
+        // glVertexAttribDivisor. Otherwise, comment them out
 
-    glutCreateWindow( "Ball Bouncing between Two Walls in Perspecitve" );
+        glutInitContextVersion( 3, 3 );
+        glutInitContextProfile( GLUT_CORE_PROFILE );
+
+        glutCreateWindow( "Ball Bouncing between Two Walls in Perspecitve" );
+    }
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     init();
 
+    if ( headless ) return headlessRun( display, idle, reshape );
+
     glutDisplayFunc ( display    );
     glutKeyboardFunc( keyboard   );
     glutSpecialFunc ( specialKey );
     glutIdleFunc    ( idle       );
     glutReshapeFunc ( reshape    );
 
+    updater.start();
     glutMainLoop();
     return EXIT_SUCCESS;
 }
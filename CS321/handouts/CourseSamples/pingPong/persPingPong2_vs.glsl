@@ -2,14 +2,23 @@
 
 in  vec4 vPosition;
 in  vec4 vColor;
+in  mat4 instanceModel;  // model matrix, one per instance
 out vec4 color;
 
-uniform mat4 model_view;
-uniform mat4 projection;
+// set once a frame, shared by every draw
+layout(std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+};
+
+// set for each draw, shared by its instances
+layout(std140) uniform Object {
+    mat4 objectModel;
+};
 
 void
 main()
 {
     color = vColor;
-    gl_Position = projection * model_view * vPosition;
+    gl_Position = projection * view * objectModel * instanceModel * vPosition;
 }
@@ -2,13 +2,12 @@
 
 in  vec4 vPosition;
 in  vec4 vColor;
+in  mat4 instanceModel;  // model matrix, one per instance
 out vec4 color;
 
-uniform mat4 model_view;
-
 void
 main()
 {
     color = vColor;
-    gl_Position = model_view * vPosition;
+    gl_Position = instanceModel * vPosition;
 }
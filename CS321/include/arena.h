@@ -0,0 +1,171 @@
+/*
+ * File: arena.h
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+/**
+ * A bump allocator for the temporary arrays that the shape generators
+ * need while they work.  Memory is taken from large blocks that are kept
+ * for reuse, and is given back all at once by restoring a mark, usually
+ * through a ScratchScope:
+ *
+ *   ScratchScope scratch( arena );
+ *   point4 *ring = scratch.allocate<point4>( k );
+ *   ...                                  // ring is freed when scratch ends
+ *
+ * Once an arena has grown to the largest size a program needs, generating
+ * shapes again (for instance every frame) does not allocate at all.
+ * Each thread has its own arena, ScratchArena::threadLocal(), which the
+ * generators use when no arena is given.
+ *
+ * Every allocation is aligned to 16 bytes, like point4.  Constructors and
+ * destructors are not run; only use the arena for plain arrays such as
+ * point4, vec3, GLfloat and indices.
+ *
+ * Requires C++11 thread_local.
+ */
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include <vector>
+
+#ifndef point4
+typedef Angel::vec4 point4;
+#endif
+
+class ScratchArena {
+
+  struct Block {
+    point4 *data;
+    size_t  size;     // bytes
+  };
+
+  std::vector<Block> blocks;
+  size_t             current;      // block being allocated from
+  size_t             used;         // bytes used in blocks[current]
+  unsigned long      blockCount;   // blocks ever allocated
+
+  ScratchArena( const ScratchArena& );             // not copyable
+  ScratchArena& operator = ( const ScratchArena& );
+
+ public:
+  /**
+   * A position in the arena to return to.
+   */
+  struct Mark {
+    size_t block;
+    size_t used;
+  };
+
+  /**
+   * Creates an arena; if initialBytes is not 0, its first block is
+   * allocated now, with room for at least initialBytes.
+   */
+  explicit ScratchArena( size_t initialBytes = 0 )
+    : current( 0 ), used( 0 ), blockCount( 0 ) {
+    if (initialBytes > 0) {
+      Block block = { new point4[(initialBytes + 15) / 16], (initialBytes + 15) & ~size_t(15) };
+      blocks.push_back( block );
+      blockCount++;
+    }
+  }
+
+  ~ScratchArena() {
+    for (size_t i = 0; i < blocks.size(); i++) {
+      delete [] blocks[i].data;
+    }
+  }
+
+  /**
+   * Returns 16-byte aligned room for n objects of type T, which stays
+   * valid until the arena is released to a mark taken before this call.
+   */
+  template <class T>
+  T *allocate( size_t n ) {
+    size_t bytes = (n * sizeof(T) + 15) & ~size_t(15);
+    if (blocks.empty() || used + bytes > blocks[current].size) {
+      // move on to the next block; blocks after the current one hold
+      // nothing, so one that is too small is replaced by a bigger one
+      size_t next = blocks.empty() ? 0 : current + 1;
+      if (next == blocks.size() || blocks[next].size < bytes) {
+        size_t size = blocks.empty() ? 4096 : 2 * blocks[current].size;
+        if (size < bytes) size = bytes;
+        Block block = { new point4[size / 16], size };
+        if (next == blocks.size()) {
+          blocks.push_back( block );
+        } else {
+          delete [] blocks[next].data;
+          blocks[next] = block;
+        }
+        blockCount++;
+      }
+      current = next;
+      used    = 0;
+    }
+    T *result = (T *) ((char *) blocks[current].data + used);
+    used += bytes;
+    return result;
+  }
+
+  /**
+   * Returns the current position of the arena.
+   */
+  Mark mark() const {
+    Mark m = { current, used };
+    return m;
+  }
+
+  /**
+   * Frees everything allocated since m was taken; the blocks are kept.
+   */
+  void release( const Mark& m ) {
+    current = m.block;
+    used    = m.used;
+  }
+
+  /**
+   * Returns the number of blocks the arena has allocated from the heap
+   * since it was created; it stops growing once the arena is big enough.
+   */
+  unsigned long allocations() const { return blockCount; }
+
+  /**
+   * Returns the total size in bytes of the arena's blocks.
+   */
+  size_t capacity() const {
+    size_t total = 0;
+    for (size_t i = 0; i < blocks.size(); i++) total += blocks[i].size;
+    return total;
+  }
+
+  /**
+   * The arena of the calling thread, created on first use.
+   */
+  static ScratchArena& threadLocal() {
+    static thread_local ScratchArena arena;
+    return arena;
+  }
+};
+
+/**
+ * Allocates from an arena, and frees everything it allocated when it
+ * goes out of scope.  Scopes on one arena must be nested.
+ */
+class ScratchScope {
+  ScratchArena&      arena;
+  ScratchArena::Mark start;
+
+  ScratchScope( const ScratchScope& );             // not copyable
+  ScratchScope& operator = ( const ScratchScope& );
+
+ public:
+  explicit ScratchScope( ScratchArena& a ) : arena( a ), start( a.mark() ) {}
+  ~ScratchScope() { arena.release( start ); }
+
+  template <class T>
+  T *allocate( size_t n ) { return arena.allocate<T>( n ); }
+};
+
+
+#endif
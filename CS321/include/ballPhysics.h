@@ -0,0 +1,303 @@
+/*
+ * File: ballPhysics.h
+ */
+
+#ifndef BALL_PHYSICS_H
+#define BALL_PHYSICS_H
+
+/**
+ * Many bouncing balls: the pingPong ball's motion, squash and stretch
+ * against the two walls, for thousands of balls in a box, with the balls
+ * also bouncing off each other.
+ *
+ * The state is kept as a structure of arrays, one array per quantity
+ * (x, y, z, vx, ...), so each part of a step is a loop that goes straight
+ * through memory and that the compiler can vectorize; the four-phase
+ * compression state machine of pingPong is written without branches for
+ * the same reason.  Ball-ball collisions are found with a uniform grid of
+ * cells the size of the largest ball, so a ball is only tested against
+ * the balls in its own and the 26 neighbouring cells instead of all the
+ * others.  Each ball's own update touches only that ball, so it can be
+ * spread over the threads of a TaskScheduler (taskScheduler.h).
+ *
+ * Velocities are in units per step, like deltaDX in pingPong; a program
+ * calls step() at a fixed rate (see timestep.h) and draws the balls
+ * between the last two steps with modelMatrices():
+ *
+ *   BallSystem balls( 2000, 0.02, 0.04 );
+ *   ...
+ *   balls.step();                          // in idle(), per time step
+ *   ...
+ *   balls.modelMatrices( models, timestep.alpha() );
+ *   ballInstances.update( models, balls.size() );
+ */
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/taskScheduler.h"
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+class BallSystem {
+
+  int n;
+
+  // the box: the inner faces of the walls are at x = +|-wallX, and the
+  // balls bounce off y = +|-halfY and z = +|-halfZ
+  GLfloat wallX, halfY, halfZ;
+  GLfloat maxRadius;
+  GLfloat spin;                          // degrees per step
+
+  // the uniform grid
+  int                 cellsX, cellsY, cellsZ;
+  GLfloat             cellSize;
+  std::vector<int>    cellOf;            // of each ball
+  std::vector<int>    cellStart;         // first of each cell in sorted
+  std::vector<int>    sorted;            // balls ordered by cell
+
+  long pairsTested, contacts;
+
+  int clampCell( GLfloat v, GLfloat half, int cells ) const {
+    int c = (int) ((v + half) / cellSize);
+    return (c < 0) ? 0 : (c >= cells) ? cells - 1 : c;
+  }
+
+  //  Sorts the balls into the grid cells with a counting sort
+  void buildGrid() {
+    std::fill( cellStart.begin(), cellStart.end(), 0 );
+    for (int i = 0; i < n; i++) {
+      int c = (clampCell( z[i], halfZ, cellsZ ) * cellsY +
+               clampCell( y[i], halfY, cellsY )) * cellsX +
+               clampCell( x[i], wallX, cellsX );
+      cellOf[i] = c;
+      cellStart[c + 1]++;
+    }
+    for (size_t c = 1; c < cellStart.size(); c++) cellStart[c] += cellStart[c - 1];
+    std::vector<int> next( cellStart.begin(), cellStart.end() - 1 );
+    for (int i = 0; i < n; i++) sorted[next[cellOf[i]]++] = i;
+  }
+
+  //  Bounces balls i and j off each other if they overlap and are moving
+  //    together; masses go as radius cubed
+  void collide( int i, int j ) {
+    pairsTested++;
+    GLfloat nx = x[j] - x[i], ny = y[j] - y[i], nz = z[j] - z[i];
+    GLfloat reach = radius[i] + radius[j];
+    GLfloat dist2 = nx * nx + ny * ny + nz * nz;
+    if (dist2 >= reach * reach || dist2 == 0.0) return;
+    contacts++;
+
+    GLfloat dist = sqrt( dist2 );
+    nx /= dist;  ny /= dist;  nz /= dist;
+
+    // push them apart, each by half the overlap
+    GLfloat push = 0.5 * (reach - dist);
+    x[i] -= push * nx;  y[i] -= push * ny;  z[i] -= push * nz;
+    x[j] += push * nx;  y[j] += push * ny;  z[j] += push * nz;
+
+    GLfloat closing = (vx[j] - vx[i]) * nx + (vy[j] - vy[i]) * ny + (vz[j] - vz[i]) * nz;
+    if (closing >= 0.0) return;          // already separating
+    GLfloat mi = radius[i] * radius[i] * radius[i];
+    GLfloat mj = radius[j] * radius[j] * radius[j];
+    GLfloat ki = 2 * mj / (mi + mj) * closing, kj = 2 * mi / (mi + mj) * closing;
+    vx[i] += ki * nx;  vy[i] += ki * ny;  vz[i] += ki * nz;
+    vx[j] -= kj * nx;  vy[j] -= kj * ny;  vz[j] -= kj * nz;
+  }
+
+ public:
+  // the state, one entry per ball
+  std::vector<GLfloat> x, y, z;          // center
+  std::vector<GLfloat> vx, vy, vz;       // velocity, units per step
+  std::vector<GLfloat> radius;
+  std::vector<GLfloat> theta;            // rotation about y, degrees
+  std::vector<GLfloat> compress;         // squash factor, 1 when round
+  std::vector<int>     phase;            // of the compression cycle, 0 ... 3
+
+  // the state before the last step, for drawing between steps
+  std::vector<GLfloat> prevX, prevY, prevZ, prevTheta, prevCompress;
+
+  /**
+   * Creates n balls with radii from minRadius to maxRadius, placed at
+   * random in the box and moving in random directions at up to
+   * maxSpeed a step.  The walls' inner faces are at x = +|-wallX, as in
+   * pingPong; the box is halfY high and halfZ deep on each side of 0.
+   * seed makes the same balls every time.
+   */
+  BallSystem( int n, GLfloat minRadius, GLfloat maxRadius,
+              GLfloat wallX = 0.875, GLfloat halfY = 1.0, GLfloat halfZ = 0.5,
+              GLfloat maxSpeed = 1.0 / 128.0, unsigned int seed = 1 )
+    : n( n ), wallX( wallX ), halfY( halfY ), halfZ( halfZ ),
+      maxRadius( maxRadius ), spin( 1.5 ), pairsTested( 0 ), contacts( 0 ),
+      x( n ), y( n ), z( n ), vx( n ), vy( n ), vz( n ), radius( n ),
+      theta( n, 0.0 ), compress( n, 1.0 ), phase( n, 0 ) {
+    srand( seed );
+    for (int i = 0; i < n; i++) {
+      GLfloat r = minRadius + (maxRadius - minRadius) * (rand() / (GLfloat) RAND_MAX);
+      radius[i] = r;
+      x[i] = (2 * (rand() / (GLfloat) RAND_MAX) - 1) * (wallX - r);
+      y[i] = (2 * (rand() / (GLfloat) RAND_MAX) - 1) * (halfY - r);
+      z[i] = (2 * (rand() / (GLfloat) RAND_MAX) - 1) * (halfZ - r);
+      vx[i] = (2 * (rand() / (GLfloat) RAND_MAX) - 1) * maxSpeed;
+      vy[i] = (2 * (rand() / (GLfloat) RAND_MAX) - 1) * maxSpeed;
+      vz[i] = (2 * (rand() / (GLfloat) RAND_MAX) - 1) * maxSpeed;
+      theta[i] = 360.0 * (rand() / (GLfloat) RAND_MAX);
+    }
+    prevX = x;  prevY = y;  prevZ = z;  prevTheta = theta;  prevCompress = compress;
+
+    cellSize = 2 * maxRadius;
+    cellsX = (int) (2 * wallX / cellSize) + 1;
+    cellsY = (int) (2 * halfY / cellSize) + 1;
+    cellsZ = (int) (2 * halfZ / cellSize) + 1;
+    cellOf.resize( n );
+    sorted.resize( n );
+    cellStart.resize( cellsX * cellsY * cellsZ + 1 );
+  }
+
+  int size() const { return n; }
+
+  //  Moves balls begin ... end - 1 one step, up to their collisions with
+  //    each other; each ball's update only touches that ball
+  void moveBalls( int begin, int end ) {
+    for (int i = begin; i < end; i++) {
+      prevX[i] = x[i];  prevY[i] = y[i];  prevZ[i] = z[i];
+      prevTheta[i] = theta[i];  prevCompress[i] = compress[i];
+    }
+
+    // move and spin
+    for (int i = begin; i < end; i++) {
+      x[i] += vx[i];
+      y[i] += vy[i];
+      z[i] += vz[i];
+      theta[i] -= spin;
+      theta[i] += (theta[i] < 0.0) ? 360.0 : 0.0;
+    }
+
+    // The walls, pingPong's compression state machine for every ball at
+    // once: 0 moving freely, 1 moving into a wall and compressing, 2
+    // moving out and stretching, 3 away from the wall and unstretching.
+    // A ball that is knocked away from the wall in phase 1 turns around
+    // early, and one knocked back into it in phase 2 or 3 starts again.
+    for (int i = begin; i < end; i++) {
+      GLfloat r = radius[i], limit = r / 16.0;
+      GLfloat toWall = wallX - (r + fabs( x[i] ));
+      bool    away   = x[i] * vx[i] < 0.0;
+      int     p      = phase[i];
+
+      bool enter   = (p == 0 || p == 3) && toWall < 0.0;
+      bool reverse = (p == 1 && (toWall < -limit || away)) ||
+                     (p == 2 && toWall < -limit && !away);
+      bool squeeze = (p == 1 && !reverse) || (p == 2 && !reverse && toWall <= limit);
+      bool release = (p == 2 && toWall > limit) || (p == 3 && !enter && toWall < 2 * limit);
+      bool done    = p == 3 && toWall >= 2 * limit;
+
+      // (pingPong never squeezes a ball by more than the limit, but a
+      // ball may be pushed further by the others)
+      GLfloat squeezed = (r + std::max( toWall, -limit )) / r;
+      GLfloat released = (r + 2 * limit - toWall) / r;
+      compress[i] = (enter || squeeze) ? squeezed
+                  : release ? released
+                  : done ? 1.0 : compress[i];
+      phase[i] = enter ? 1 : reverse ? 2 : (p == 2 && toWall > limit) ? 3 : done ? 0 : p;
+
+      // turning around undoes the move past the compression limit
+      GLfloat turned = away ? vx[i] : -vx[i];
+      x[i]  += (reverse && !away) ? turned : 0.0;
+      vx[i]  = reverse ? turned : vx[i];
+
+      // and nothing goes further into a wall than the limit
+      GLfloat maxX = wallX - r + limit;
+      x[i] = (x[i] > maxX) ? maxX : (x[i] < -maxX) ? -maxX : x[i];
+    }
+
+    // the floor, ceiling, front and back
+    for (int i = begin; i < end; i++) {
+      GLfloat r = radius[i];
+      GLfloat overY = fabs( y[i] ) - (halfY - r), overZ = fabs( z[i] ) - (halfZ - r);
+      GLfloat signY = (y[i] < 0.0) ? -1.0 : 1.0, signZ = (z[i] < 0.0) ? -1.0 : 1.0;
+      y[i]  -= (overY > 0.0) ? 2 * overY * signY : 0.0;
+      z[i]  -= (overZ > 0.0) ? 2 * overZ * signZ : 0.0;
+      vy[i]  = (overY > 0.0 && y[i] * vy[i] > 0.0) ? -vy[i] : vy[i];
+      vz[i]  = (overZ > 0.0 && z[i] * vz[i] > 0.0) ? -vz[i] : vz[i];
+    }
+  }
+
+  /**
+   * Moves every ball one step: along its velocity, through the squash
+   * and stretch cycle at the walls, off the other sides of the box, and
+   * off the other balls.  Given a task scheduler, the balls are moved in
+   * parallel, in batches of grain; the collisions between balls are
+   * always found and resolved on the calling thread, since each one
+   * changes two balls.
+   */
+  void step( TaskScheduler *tasks = NULL, int grain = 1024 ) {
+    if (tasks == NULL) {
+      moveBalls( 0, n );
+    } else {
+      tasks->parallelFor( 0, n, grain, [this]( int begin, int end ) {
+        moveBalls( begin, end );
+      } );
+    }
+
+    // each other: every pair in neighbouring cells, once
+    buildGrid();
+    for (int i = 0; i < n; i++) {
+      int c  = cellOf[i];
+      int cx = c % cellsX, cy = (c / cellsX) % cellsY, cz = c / (cellsX * cellsY);
+      for (int kz = cz - 1; kz <= cz + 1; kz++) {
+        if (kz < 0 || kz >= cellsZ) continue;
+        for (int ky = cy - 1; ky <= cy + 1; ky++) {
+          if (ky < 0 || ky >= cellsY) continue;
+          for (int kx = cx - 1; kx <= cx + 1; kx++) {
+            if (kx < 0 || kx >= cellsX) continue;
+            int k = (kz * cellsY + ky) * cellsX + kx;
+            for (int s = cellStart[k]; s < cellStart[k + 1]; s++) {
+              if (sorted[s] > i) collide( i, sorted[s] );
+            }
+          }
+        }
+      }
+    }
+  }
+
+  //  Writes the model matrices of balls begin ... end - 1
+  void modelMatrices( mat4 models[], GLfloat alpha, int begin, int end ) const {
+    for (int i = begin; i < end; i++) {
+      GLfloat dTheta = theta[i] - prevTheta[i];
+      dTheta += (dTheta > 180.0) ? -360.0 : (dTheta < -180.0) ? 360.0 : 0.0;
+      GLfloat c = prevCompress[i] + alpha * (compress[i] - prevCompress[i]);
+      models[i] = Translate( prevX[i] + alpha * (x[i] - prevX[i]),
+                             prevY[i] + alpha * (y[i] - prevY[i]),
+                             prevZ[i] + alpha * (z[i] - prevZ[i]) ) *
+                  RotateY( prevTheta[i] + alpha * dTheta ) *
+                  Scale( c, 1 / c, 1 / c ) *
+                  Scale( radius[i], radius[i], radius[i] );
+    }
+  }
+
+  /**
+   * Writes the model matrix of each ball, alpha of the way from its state
+   * before the last step to its current one, as pingPong builds it; in
+   * parallel if given a task scheduler.
+   */
+  void modelMatrices( mat4 models[], GLfloat alpha = 1.0,
+                      TaskScheduler *tasks = NULL, int grain = 1024 ) const {
+    if (tasks == NULL) {
+      modelMatrices( models, alpha, 0, n );
+    } else {
+      tasks->parallelFor( 0, n, grain, [this, models, alpha]( int begin, int end ) {
+        modelMatrices( models, alpha, begin, end );
+      } );
+    }
+  }
+
+  /**
+   * Returns the number of ball pairs tested for contact, and the number
+   * found touching, since the last call to resetCounts().
+   */
+  long numPairsTested() const { return pairsTested; }
+  long numContacts() const { return contacts; }
+  void resetCounts() { pairsTested = contacts = 0; }
+};
+
+
+#endif
@@ -8,9 +8,17 @@
 /*
  * Functions to process bezier patches,
  * adapted from Angel & Schreiner 6th edition
+ *
+ * The points, normals and texCoords output arrays are Strided arrays
+ * (see vertexFormat.h), so patches can be tessellated straight into an
+ * interleaved vertex array; ordinary arrays, and NULL, work as before.
  */
 
 #include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/arena.h"
+#include "/usr/people/classes/CS321/include/parallel.h"
+#include "/usr/people/classes/CS321/include/vertexFormat.h"
+#include <vector>
 
 #ifndef point4
 typedef Angel::vec4 point4;
@@ -37,64 +45,54 @@ numQuadsPerPatch( int subdivisions ) {
 
 //----------------------------------------------------------------------------
 
+/**
+ * Stores the quad bounded by the corners of the Bezier patch p as two
+ * triangles in points, beginning at position start.  normals and
+ * texCoords may each be NULL, in which case that attribute is not
+ * computed.
+ */
 inline void
 draw_patch( point4 p[4][4], int orientation,
-            point4 points[], vec3 normals[], vec2 texCoords[], int start,
+            Strided<point4> points, Strided<vec3> normals, Strided<vec2> texCoords, int start,
             GLfloat texSstart, GLfloat texSend, GLfloat texTstart, GLfloat texTend )
 {
-    // Compute the normal vectors
-    vec3 normal00 = orientation * normalize( cross ( p[0][1] - p[0][0], p[1][0] - p[0][0] ));
-    vec3 normal30 = orientation * normalize( cross ( p[2][0] - p[3][0], p[3][1] - p[3][0] ));
-    vec3 normal33 = orientation * normalize( cross ( p[3][2] - p[3][3], p[2][3] - p[3][3] ));
-    vec3 normal03 = orientation * normalize( cross ( p[1][3] - p[0][3], p[0][2] - p[0][3] ));
-
-    // Compute the texture coordinates
-    vec2 tex00 = vec2( texSstart, texTstart );
-    vec2 tex30 = vec2( texSend, texTstart );
-    vec2 tex33 = vec2( texSend, texTend );
-    vec2 tex03 = vec2( texSstart, texTend );
-
-    // Draw the quad (as two triangles) bounded by the corners of the
-    //   Bezier patch.
-  if (orientation == BACK_TO_FRONT) {
-    points[start]      = p[0][0];
-    normals[start]     = normal00;
-    texCoords[start++] = tex00;
-    points[start]      = p[3][0];
-    normals[start]     = normal30;
-    texCoords[start++] = tex30;
-    points[start]      = p[3][3];
-    normals[start]     = normal33;
-    texCoords[start++] = tex33;
-    points[start]      = p[0][0];
-    normals[start]     = normal00;
-    texCoords[start++] = tex00;
-    points[start]      = p[3][3];
-    normals[start]     = normal33;
-    texCoords[start++] = tex33;
-    points[start]      = p[0][3];
-    normals[start]     = normal03;
-    texCoords[start++] = tex03;
-  } else { // orientation == FRONT_TO_BACK
-    points[start]      = p[0][0];
-    normals[start]     = normal00;
-    texCoords[start++] = tex00;
-    points[start]      = p[3][3];
-    normals[start]     = normal33;
-    texCoords[start++] = tex33;
-    points[start]      = p[3][0];
-    normals[start]     = normal30;
-    texCoords[start++] = tex30;
-    points[start]      = p[0][0];
-    normals[start]     = normal00;
-    texCoords[start++] = tex00;
-    points[start]      = p[0][3];
-    normals[start]     = normal03;
-    texCoords[start++] = tex03;
-    points[start]      = p[3][3];
-    normals[start]     = normal33;
-    texCoords[start++] = tex33;
-  }
+    // Corner order of the two triangles
+    static const int backToFront[6] = { 0, 1, 2, 0, 2, 3 };
+    static const int frontToBack[6] = { 0, 2, 1, 0, 3, 2 };
+    const int *order = (orientation == BACK_TO_FRONT) ? backToFront : frontToBack;
+
+    // The corners of the patch: 00, 30, 33, 03
+    point4 corner[4] = { p[0][0], p[3][0], p[3][3], p[0][3] };
+
+    for ( int i = 0; i < 6; i++ ) {
+        points[start + i] = corner[order[i]];
+    }
+
+    if (normals != NULL) {
+        // Compute the normal vectors
+        vec3 normal[4] = {
+          orientation * normalize( cross ( p[0][1] - p[0][0], p[1][0] - p[0][0] )),
+          orientation * normalize( cross ( p[2][0] - p[3][0], p[3][1] - p[3][0] )),
+          orientation * normalize( cross ( p[3][2] - p[3][3], p[2][3] - p[3][3] )),
+          orientation * normalize( cross ( p[1][3] - p[0][3], p[0][2] - p[0][3] ))
+        };
+        for ( int i = 0; i < 6; i++ ) {
+            normals[start + i] = normal[order[i]];
+        }
+    }
+
+    if (texCoords != NULL) {
+        // Compute the texture coordinates
+        vec2 tex[4] = {
+          vec2( texSstart, texTstart ),
+          vec2( texSend,   texTstart ),
+          vec2( texSend,   texTend ),
+          vec2( texSstart, texTend )
+        };
+        for ( int i = 0; i < 6; i++ ) {
+            texCoords[start + i] = tex[order[i]];
+        }
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -165,7 +163,7 @@ transpose( point4 a[4][4] )
 
 int
 divide_patch_rec( point4 p[4][4], int subdivisions, int orientation,
-                  point4 points[], vec3 normals[], vec2 texCoords[], int start,
+                  Strided<point4> points, Strided<vec3> normals, Strided<vec2> texCoords, int start,
                   GLfloat texSstart, GLfloat texSend, GLfloat texTstart, GLfloat texTend )
 {
   if ( subdivisions > 0 ) {
@@ -213,11 +211,13 @@ divide_patch_rec( point4 p[4][4], int subdivisions, int orientation,
  * @param points       the array of points to put the points to draw into,
  *                     must contain at least start + 6 * numQuadsPerPatch( subdivisions )
  * @param normals      the array of vectors to put the normal vectors into,
- *                     should be NULL if not needed
- *                     must contain at least start + 6 * numQuadsPerPatch( subdivisions )
+ *                     should be NULL if not needed, in which case no normals
+ *                     are computed;
+ *                     otherwise must contain at least start + 6 * numQuadsPerPatch( subdivisions )
  * @param texCoords    the array of (s, t) pairs to put texture coordinates into,
- *                     should be NULL if not needed
- *                     must contain at least start + 6 * numQuadsPerPatch( subdivisions )
+ *                     should be NULL if not needed, in which case no texture
+ *                     coordinates are computed;
+ *                     otherwise must contain at least start + 6 * numQuadsPerPatch( subdivisions )
  * @param texSstart    the starting s-coordinate for the texture coordinates
  * @param texSend      the ending s-coordinate for the texture coordinates
  * @param texTstart    the starting t-coordinate for the texture coordinates
@@ -228,21 +228,658 @@ divide_patch_rec( point4 p[4][4], int subdivisions, int orientation,
  */
 int
 divide_patch( point4 p[4][4], int subdivisions, int orientation,
-              point4 points[], vec3 normals[], vec2 texCoords[], int start,
+              Strided<point4> points, Strided<vec3> normals, Strided<vec2> texCoords, int start,
+              GLfloat texSstart, GLfloat texSend, GLfloat texTstart, GLfloat texTend )
+{
+  if (points == NULL) return -1;
+  if (orientation != BACK_TO_FRONT && orientation != FRONT_TO_BACK) return -1;
+  return divide_patch_rec( p, subdivisions, orientation,
+                           points, normals, texCoords, start,
+                           texSstart, texSend, texTstart, texTend );
+}
+
+
+//----------------------------------------------------------------------------
+//
+//  Tessellating many patches
+//
+
+/**
+ * Divides numPatches Bezier patches, patch i subdivisions[i] times, into
+ * one set of arrays.  Patch i is placed at start plus the sum of the sizes,
+ * 6 * numQuadsPerPatch( subdivisions[k] ), of the patches k before it, so
+ * the output is the same as calling divide_patch() on each patch in turn.
+ * The patches are tessellated in parallel on pool; the result does not
+ * depend on the number of threads.  Each patch gets texture coordinates
+ * from (0, 0) to (1, 1).
+ *
+ * @param numPatches   the number of patches
+ * @param patches      the patches of 4 X 4 Bezier control points
+ * @param subdivisions the number of times to subdivide each patch
+ * @param orientation  BACK_TO_FRONT or FRONT_TO_BACK, as for divide_patch()
+ * @param points       the array to put the points into; must hold
+ *                     start + the total number of vertices
+ * @param normals      the array to put the normal vectors into, or NULL
+ * @param texCoords    the array to put the texture coordinates into, or NULL
+ * @param start        the position in the arrays for the first vertex
+ * @param pool         the threads to use
+ * @return             start + the total number of vertices on success
+ *                     -1 if orientation is not BACK_TO_FRONT or FRONT_TO_BACK,
+ *                        or if points is NULL
+ */
+int
+divide_patches( int numPatches, point4 patches[][4][4], const int subdivisions[],
+                int orientation,
+                Strided<point4> points, Strided<vec3> normals, Strided<vec2> texCoords, int start,
+                ThreadPool& pool = ThreadPool::shared() )
+{
+  if (points == NULL) return -1;
+  if (orientation != BACK_TO_FRONT && orientation != FRONT_TO_BACK) return -1;
+
+  // prefix sums of the patch sizes give each patch its own output range
+  std::vector<int> offsets( numPatches + 1 );
+  offsets[0] = start;
+  for (int i = 0; i < numPatches; i++) {
+    offsets[i+1] = offsets[i] + 6 * numQuadsPerPatch( subdivisions[i] );
+  }
+
+  pool.run( numPatches, [&]( size_t i ) {
+    divide_patch_rec( patches[i], subdivisions[i], orientation,
+                      points, normals, texCoords, offsets[i],
+                      0.0, 1.0, 0.0, 1.0 );
+  } );
+
+  return offsets[numPatches];
+}
+
+//----------------------------------------------------------------------------
+//
+//  Uniform-grid evaluation
+//
+//  Instead of recursive subdivision, the bicubic Bezier surface is
+//  evaluated directly at the parameter values (i/n, j/n), 0 <= i, j <= n,
+//  for any n >= 1.  The vertices lie exactly on the surface and the normals
+//  come from the partial derivatives there, rather than from the control
+//  net.  The Bernstein basis is tabulated once per call, and each grid row
+//  is evaluated four columns at a time with vec4 arithmetic, which uses the
+//  SIMD backend of vec.h when it is available.
+//
+
+/**
+ * Stores the cubic Bernstein polynomials at t in b,
+ * and their derivatives in d.
+ */
+inline void
+bezier_basis( GLfloat t, GLfloat b[4], GLfloat d[4] )
+{
+    GLfloat s = 1.0 - t;
+    b[0] = s * s * s;
+    b[1] = 3.0 * t * s * s;
+    b[2] = 3.0 * t * t * s;
+    b[3] = t * t * t;
+    d[0] = -3.0 * s * s;
+    d[1] = 3.0 * s * s - 6.0 * t * s;
+    d[2] = 6.0 * t * s - 3.0 * t * t;
+    d[3] = 3.0 * t * t;
+}
+
+/**
+ * Returns the unit normal of patch p at (u, v), oriented like the normals
+ * of draw_patch().  Where the surface is degenerate (e.g. all of one edge
+ * of control points coincide), the normal is taken slightly towards the
+ * centre of the patch.
+ */
+inline vec3
+patch_normal( point4 p[4][4], int orientation, GLfloat u, GLfloat v )
+{
+    for ( int attempt = 0; attempt < 4; attempt++ ) {
+        GLfloat bu[4], du[4], bv[4], dv[4];
+        bezier_basis( u, bu, du );
+        bezier_basis( v, bv, dv );
+        vec3 pu, pv;
+        for ( int i = 0; i < 4; i++ ) {
+            for ( int j = 0; j < 4; j++ ) {
+                vec3 c( p[i][j].x, p[i][j].y, p[i][j].z );
+                pu += du[i] * bv[j] * c;
+                pv += bu[i] * dv[j] * c;
+            }
+        }
+        vec3 n = cross( pv, pu );
+        if ( dot( n, n ) > DivideByZeroTolerance ) {
+            return orientation * normalize( n );
+        }
+        u += (0.5 - u) * 1.0e-3;
+        v += (0.5 - v) * 1.0e-3;
+    }
+    return vec3( 0.0, 0.0, 0.0 );
+}
+
+/**
+ * Evaluates a Bezier patch on an (n+1) X (n+1) grid of parameter values
+ * and places the resulting n * n quads, as triangles, into points, along
+ * with normals and texture coordinates.  The quads are written row by row
+ * of the grid, each as 6 points in the triangle order of draw_patch();
+ * divide_patch() writes them in the order of its recursive subdivision
+ * instead, so the two do not give the same arrays.
+ * Its temporary arrays are taken from arena.
+ *
+ * @param p            the 4 X 4 patch of Bezier control points, corners interpolated
+ * @param n            the number of quads along each side of the patch, n >= 1
+ * @param orientation  BACK_TO_FRONT if row 0 is at the back of the patch
+ *                     FRONT_TO_BACK if row 0 is at the front of the patch
+ * @param points       the array of points to put the points to draw into,
+ *                     must contain at least start + 6 * n * n
+ * @param normals      the array of vectors to put the normal vectors into,
+ *                     NULL if not needed
+ * @param texCoords    the array of (s, t) pairs to put texture coordinates into,
+ *                     NULL if not needed
+ * @param texSstart    the starting s-coordinate for the texture coordinates
+ * @param texSend      the ending s-coordinate for the texture coordinates
+ * @param texTstart    the starting t-coordinate for the texture coordinates
+ * @param texTend      the ending s-coordinate for the texture coordinates
+ * @param arena        the arena to take temporary arrays from
+ * @return             start + 6 * n * n on success
+ *                     -1 if orientation is not BACK_TO_FRONT or FRONT_TO_BACK,
+ *                        if n < 1, or if points is NULL
+ */
+int
+evaluate_patch( point4 p[4][4], int n, int orientation,
+                Strided<point4> points, Strided<vec3> normals, Strided<vec2> texCoords, int start,
+                GLfloat texSstart, GLfloat texSend, GLfloat texTstart, GLfloat texTend,
+                ScratchArena& arena = ScratchArena::threadLocal() )
+{
+  if (points == NULL || n < 1) return -1;
+  if (orientation != BACK_TO_FRONT && orientation != FRONT_TO_BACK) return -1;
+
+  const int size   = n + 1;            // grid vertices along each side
+  const int groups = (size + 3) / 4;   // groups of 4 columns
+  ScratchScope scratch( arena );
+
+  // Basis tables: colB[j][g] holds B_j at columns 4g ... 4g+3,
+  // and colD[j][g] the derivatives
+  vec4 *colB = scratch.allocate<vec4>( 8 * groups );
+  vec4 *colD = colB + 4 * groups;
+  for ( int g = 0; g < groups; g++ ) {
+    for ( int lane = 0; lane < 4; lane++ ) {
+      int col = 4 * g + lane;
+      GLfloat b[4], d[4];
+      bezier_basis( (col < size ? col : n) / (GLfloat) n, b, d );
+      for ( int j = 0; j < 4; j++ ) {
+        colB[j * groups + g][lane] = b[j];
+        colD[j * groups + g][lane] = d[j];
+      }
+    }
+  }
+
+  // The evaluated grid, row-major
+  point4 *grid       = scratch.allocate<point4>( size * size );
+  vec3   *gridNormal = (normals != NULL) ? scratch.allocate<vec3>( size * size ) : NULL;
+
+  for ( int row = 0; row < size; row++ ) {
+    GLfloat b[4], d[4];
+    bezier_basis( row / (GLfloat) n, b, d );
+
+    // Control points of the curve along this row, and of its u derivative
+    point4 c[4], cu[4];
+    for ( int j = 0; j < 4; j++ ) {
+      c[j]  = b[0] * p[0][j] + b[1] * p[1][j] + b[2] * p[2][j] + b[3] * p[3][j];
+      cu[j] = d[0] * p[0][j] + d[1] * p[1][j] + d[2] * p[2][j] + d[3] * p[3][j];
+    }
+
+    for ( int g = 0; g < groups; g++ ) {
+      const vec4 &b0 = colB[g],          &b1 = colB[groups + g],
+                 &b2 = colB[2*groups + g], &b3 = colB[3*groups + g];
+      const vec4 &d0 = colD[g],          &d1 = colD[groups + g],
+                 &d2 = colD[2*groups + g], &d3 = colD[3*groups + g];
+
+      // Surface points for four columns, one vec4 per coordinate
+      vec4 x = b0 * c[0].x + b1 * c[1].x + b2 * c[2].x + b3 * c[3].x;
+      vec4 y = b0 * c[0].y + b1 * c[1].y + b2 * c[2].y + b3 * c[3].y;
+      vec4 z = b0 * c[0].z + b1 * c[1].z + b2 * c[2].z + b3 * c[3].z;
+
+      int lanes = size - 4 * g < 4 ? size - 4 * g : 4;
+      for ( int lane = 0; lane < lanes; lane++ ) {
+        grid[row * size + 4 * g + lane] = point4( x[lane], y[lane], z[lane], 1.0 );
+      }
+
+      if (gridNormal != NULL) {
+        // Partial derivatives along u (rows) and v (columns)
+        vec4 ux = b0 * cu[0].x + b1 * cu[1].x + b2 * cu[2].x + b3 * cu[3].x;
+        vec4 uy = b0 * cu[0].y + b1 * cu[1].y + b2 * cu[2].y + b3 * cu[3].y;
+        vec4 uz = b0 * cu[0].z + b1 * cu[1].z + b2 * cu[2].z + b3 * cu[3].z;
+        vec4 vx = d0 * c[0].x + d1 * c[1].x + d2 * c[2].x + d3 * c[3].x;
+        vec4 vy = d0 * c[0].y + d1 * c[1].y + d2 * c[2].y + d3 * c[3].y;
+        vec4 vz = d0 * c[0].z + d1 * c[1].z + d2 * c[2].z + d3 * c[3].z;
+
+        // n = cross( pv, pu ), as in draw_patch()
+        vec4 nx = vy * uz - vz * uy;
+        vec4 ny = vz * ux - vx * uz;
+        vec4 nz = vx * uy - vy * ux;
+
+        for ( int lane = 0; lane < lanes; lane++ ) {
+          vec3 normal( nx[lane], ny[lane], nz[lane] );
+          int col = 4 * g + lane;
+          if ( dot( normal, normal ) > DivideByZeroTolerance ) {
+            normal = orientation * normalize( normal );
+          } else {
+            normal = patch_normal( p, orientation, row / (GLfloat) n, col / (GLfloat) n );
+          }
+          gridNormal[row * size + col] = normal;
+        }
+      }
+    }
+  }
+
+  // Emit the quads with the same triangle order as draw_patch()
+  static const int backToFront[6] = { 0, 1, 2, 0, 2, 3 };
+  static const int frontToBack[6] = { 0, 2, 1, 0, 3, 2 };
+  const int *order = (orientation == BACK_TO_FRONT) ? backToFront : frontToBack;
+
+  GLfloat texSstep = (texSend - texSstart) / n;
+  GLfloat texTstep = (texTend - texTstart) / n;
+
+  for ( int i = 0; i < n; i++ ) {
+    for ( int j = 0; j < n; j++ ) {
+      // corners 00, 30, 33, 03 of this quad
+      int corner[4] = { i * size + j, (i+1) * size + j,
+                        (i+1) * size + j+1, i * size + j+1 };
+      for ( int k = 0; k < 6; k++ ) {
+        points[start + k] = grid[corner[order[k]]];
+      }
+      if (normals != NULL) {
+        for ( int k = 0; k < 6; k++ ) {
+          normals[start + k] = gridNormal[corner[order[k]]];
+        }
+      }
+      if (texCoords != NULL) {
+        vec2 tex[4] = {
+          vec2( texSstart + i * texSstep,     texTstart + j * texTstep ),
+          vec2( texSstart + (i+1) * texSstep, texTstart + j * texTstep ),
+          vec2( texSstart + (i+1) * texSstep, texTstart + (j+1) * texTstep ),
+          vec2( texSstart + i * texSstep,     texTstart + (j+1) * texTstep )
+        };
+        for ( int k = 0; k < 6; k++ ) {
+          texCoords[start + k] = tex[order[k]];
+        }
+      }
+      start += 6;
+    }
+  }
+
+  return start;
+}
+
+
+//----------------------------------------------------------------------------
+//
+//  Adaptive subdivision
+//
+//  A patch is only subdivided where it is not yet flat: a piece becomes a
+//  leaf once all of its control points lie within a tolerance of the
+//  bilinear surface through its four corners, or at the maximum depth.
+//  Leaves of different sizes meet at T-junctions, so a leaf that has
+//  smaller neighbours is drawn as a fan around its centre through every
+//  neighbour corner on its edges.  All vertices are evaluated directly on
+//  the surface from their (u, v) parameters, which are exact binary
+//  fractions, so a vertex shared by two leaves is bit-for-bit the same in
+//  both and the mesh has no cracks.
+//
+
+/**
+ * Statistics from divide_patch_adaptive(), accumulated over calls.
+ */
+struct patch_stats {
+    int leaves;             // leaf pieces of the patches
+    int triangles;          // triangles generated
+    int uniformTriangles;   // triangles uniform subdivision would generate
+
+    patch_stats() : leaves(0), triangles(0), uniformTriangles(0) {}
+
+    // triangles saved compared with uniform subdivision
+    int saved() const { return uniformTriangles - triangles; }
+};
+
+/**
+ * Returns the point of patch p at (u, v).
+ */
+inline point4
+patch_point( point4 p[4][4], GLfloat u, GLfloat v )
+{
+    GLfloat bu[4], du[4], bv[4], dv[4];
+    bezier_basis( u, bu, du );
+    bezier_basis( v, bv, dv );
+    point4 result( 0.0, 0.0, 0.0, 0.0 );
+    for ( int i = 0; i < 4; i++ ) {
+        point4 row = bv[0] * p[i][0] + bv[1] * p[i][1] + bv[2] * p[i][2] + bv[3] * p[i][3];
+        result += bu[i] * row;
+    }
+    result.w = 1.0;
+    return result;
+}
+
+/**
+ * Returns true if every control point of p is within tolerance of the
+ * bilinear surface through the corners of p.
+ */
+inline bool
+patch_is_flat( point4 p[4][4], GLfloat tolerance )
+{
+    GLfloat tolSqrd = tolerance * tolerance;
+    for ( int i = 0; i < 4; i++ ) {
+        for ( int j = 0; j < 4; j++ ) {
+            GLfloat s = i / 3.0, t = j / 3.0;
+            point4 bilinear = (1 - s) * (1 - t) * p[0][0] + s * (1 - t) * p[3][0] +
+                              s * t * p[3][3] + (1 - s) * t * p[0][3];
+            point4 d = p[i][j] - bilinear;
+            if ( d.x * d.x + d.y * d.y + d.z * d.z > tolSqrd ) return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * A leaf of an adaptively subdivided patch, as a square of the finest
+ * grid: cells i0 ... i0 + size - 1 along u and j0 ... j0 + size - 1 along v.
+ */
+struct patch_leaf {
+    int i0, j0, size;
+};
+
+void
+find_patch_leaves( point4 p[4][4], int depth, int maxDepth, GLfloat tolerance,
+                   int i0, int j0, int size,
+                   std::vector<patch_leaf>& leaves, std::vector<int>& leafSize )
+{
+  if ( depth < maxDepth && !patch_is_flat( p, tolerance ) ) {
+    point4 q[4][4], r[4][4], s[4][4], t[4][4];
+    point4 a[4][4], b[4][4];
+
+    divide_rows( p, a, b );
+    divide_cols( a, q, s );
+    divide_cols( b, r, t );
+
+    int h = size / 2;
+    find_patch_leaves( q, depth + 1, maxDepth, tolerance, i0,     j0,     h, leaves, leafSize );
+    find_patch_leaves( r, depth + 1, maxDepth, tolerance, i0,     j0 + h, h, leaves, leafSize );
+    find_patch_leaves( s, depth + 1, maxDepth, tolerance, i0 + h, j0,     h, leaves, leafSize );
+    find_patch_leaves( t, depth + 1, maxDepth, tolerance, i0 + h, j0 + h, h, leaves, leafSize );
+  } else {
+    patch_leaf leaf = { i0, j0, size };
+    leaves.push_back( leaf );
+    int gridSize = 1 << maxDepth;
+    for ( int i = i0; i < i0 + size; i++ ) {
+      for ( int j = j0; j < j0 + size; j++ ) {
+        leafSize[i * gridSize + j] = size;
+      }
+    }
+  }
+}
+
+/**
+ * Appends to boundary the grid corners along one edge of a leaf, starting
+ * at (i, j) and stepping (di, dj) for length cells, including the start
+ * but not the end: the start plus every corner of the neighbouring leaves
+ * across the edge, whose cells are offset by (ni, nj).
+ */
+inline void
+leaf_edge_corners( int i, int j, int di, int dj, int length, int ni, int nj,
+                   int gridSize, const std::vector<int>& leafSize,
+                   std::vector<int>& boundary )
+{
+  boundary.push_back( i );
+  boundary.push_back( j );
+
+  int ci = i + ni, cj = j + nj;   // first neighbour cell
+  if (ci < 0 || cj < 0 || ci >= gridSize || cj >= gridSize) return;
+
+  for ( int k = 0; k < length; ) {
+    int size = leafSize[(ci + k * di) * gridSize + (cj + k * dj)];
+    // position along the edge of the neighbour's far corner
+    int along = (di != 0 ? ci + k * di : cj + k * dj);
+    int step  = (di + dj > 0) ? size - along % size : along % size + 1;
+    k += step;
+    if (k < length) {
+      boundary.push_back( i + k * di );
+      boundary.push_back( j + k * dj );
+    }
+  }
+}
+
+/**
+ * Divides a Bezier patch adaptively, at most maxSubdivisions times, and
+ * places the resulting triangles into points, along with normals and
+ * texture coordinates.
+ *
+ * @param p               the 4 X 4 patch of Bezier control points, corners interpolated
+ * @param maxSubdivisions the largest number of times to subdivide any piece
+ * @param tolerance       the largest distance of a leaf's control points from
+ *                        the bilinear surface through its corners
+ * @param orientation     BACK_TO_FRONT if row 0 is at the back of the patch
+ *                        FRONT_TO_BACK if row 0 is at the front of the patch
+ * @param points          the array of points to put the points to draw into
+ * @param normals         the array of vectors to put the normal vectors into,
+ *                        NULL if not needed
+ * @param texCoords       the array of (s, t) pairs to put texture coordinates into,
+ *                        NULL if not needed
+ * @param start           the position in the arrays for the first vertex
+ * @param maxPoints       the number of array elements available from start;
+ *                        6 * numQuadsPerPatch( maxSubdivisions ) is always enough
+ * @param texSstart ... texTend  the texture coordinate range, as for divide_patch()
+ * @param stats           if not NULL, the leaf and triangle counts of this patch
+ *                        are added to it
+ * @return                start + the number of vertices on success
+ *                        -1 if orientation is not BACK_TO_FRONT or FRONT_TO_BACK,
+ *                           if points is NULL, or if the vertices do not fit
+ *                           in maxPoints (nothing is written then)
+ */
+int
+divide_patch_adaptive( point4 p[4][4], int maxSubdivisions, GLfloat tolerance,
+                       int orientation,
+                       Strided<point4> points, Strided<vec3> normals, Strided<vec2> texCoords,
+                       int start, int maxPoints,
+                       GLfloat texSstart, GLfloat texSend, GLfloat texTstart, GLfloat texTend,
+                       patch_stats *stats = NULL )
+{
+  if (points == NULL) return -1;
+  if (orientation != BACK_TO_FRONT && orientation != FRONT_TO_BACK) return -1;
+
+  // Find the leaves, and the leaf size covering each cell of the finest grid
+  const int gridSize = 1 << maxSubdivisions;
+  std::vector<patch_leaf> leaves;
+  std::vector<int> leafSize( gridSize * gridSize );
+  find_patch_leaves( p, 0, maxSubdivisions, tolerance, 0, 0, gridSize,
+                     leaves, leafSize );
+
+  // Find the corners around each leaf, counterclockwise in (u, v):
+  // (i0, j0), (i0 + size, j0), (i0 + size, j0 + size), (i0, j0 + size)
+  std::vector<int> boundaryStart( leaves.size() + 1 );
+  std::vector<int> boundary;
+  int numVertices = 0;
+  for ( size_t k = 0; k < leaves.size(); k++ ) {
+    const patch_leaf& f = leaves[k];
+    boundaryStart[k] = (int) boundary.size();
+    leaf_edge_corners( f.i0,          f.j0,           1,  0, f.size,  0, -1,
+                       gridSize, leafSize, boundary );
+    leaf_edge_corners( f.i0 + f.size, f.j0,           0,  1, f.size,  0,  0,
+                       gridSize, leafSize, boundary );
+    leaf_edge_corners( f.i0 + f.size, f.j0 + f.size, -1,  0, f.size, -1,  0,
+                       gridSize, leafSize, boundary );
+    leaf_edge_corners( f.i0,          f.j0 + f.size,  0, -1, f.size, -1, -1,
+                       gridSize, leafSize, boundary );
+    int corners = ((int) boundary.size() - boundaryStart[k]) / 2;
+    numVertices += (corners == 4) ? 6 : 3 * corners;
+  }
+  boundaryStart[leaves.size()] = (int) boundary.size();
+
+  if (numVertices > maxPoints) return -1;
+  if (stats != NULL) {
+    stats->leaves           += (int) leaves.size();
+    stats->triangles        += numVertices / 3;
+    stats->uniformTriangles += 2 * numQuadsPerPatch( maxSubdivisions );
+  }
+
+  const GLfloat step     = 1.0 / gridSize;
+  const GLfloat texSstep = (texSend - texSstart) / gridSize;
+  const GLfloat texTstep = (texTend - texTstart) / gridSize;
+
+  // Emit each leaf: two triangles if it has only its own four corners,
+  // otherwise a fan around its centre
+  for ( size_t k = 0; k < leaves.size(); k++ ) {
+    const patch_leaf& f = leaves[k];
+    const int *corner   = &boundary[boundaryStart[k]];
+    const int  corners  = (boundaryStart[k+1] - boundaryStart[k]) / 2;
+
+    // parameters of the vertices, as grid positions times 2 so that
+    // the centre of a 1-cell leaf is on the grid
+    std::vector<int> gi, gj;
+    if (corners == 4) {
+      static const int backToFront[6] = { 0, 1, 2, 0, 2, 3 };
+      static const int frontToBack[6] = { 0, 2, 1, 0, 3, 2 };
+      const int *order = (orientation == BACK_TO_FRONT) ? backToFront : frontToBack;
+      for ( int v = 0; v < 6; v++ ) {
+        gi.push_back( 2 * corner[2 * order[v]] );
+        gj.push_back( 2 * corner[2 * order[v] + 1] );
+      }
+    } else {
+      int ci = 2 * f.i0 + f.size, cj = 2 * f.j0 + f.size;
+      for ( int c = 0; c < corners; c++ ) {
+        int a = c, b = (c + 1) % corners;
+        if (orientation != BACK_TO_FRONT) { int t = a; a = b; b = t; }
+        gi.push_back( ci );                     gj.push_back( cj );
+        gi.push_back( 2 * corner[2 * a] );      gj.push_back( 2 * corner[2 * a + 1] );
+        gi.push_back( 2 * corner[2 * b] );      gj.push_back( 2 * corner[2 * b + 1] );
+      }
+    }
+
+    for ( size_t v = 0; v < gi.size(); v++ ) {
+      GLfloat u  = gi[v] * step / 2, w = gj[v] * step / 2;
+      points[start] = patch_point( p, u, w );
+      if (normals != NULL) {
+        normals[start] = patch_normal( p, orientation, u, w );
+      }
+      if (texCoords != NULL) {
+        texCoords[start] = vec2( texSstart + gi[v] * texSstep / 2,
+                                 texTstart + gj[v] * texTstep / 2 );
+      }
+      start++;
+    }
+  }
+
+  return start;
+}
+
+//----------------------------------------------------------------------------
+//
+//  Streaming tessellation
+//
+//  Instead of filling arrays sized for the whole tessellation, the patches
+//  are tessellated into a fixed-size patch_stream, which passes each full
+//  batch of vertices to a callback (for example one that appends it to a
+//  buffer object with glBufferSubData).  The stream does not allocate, and
+//  computes only the attributes that are asked for.
+//
+
+/**
+ * Number of vertices in each batch; a multiple of 6, so that a batch
+ * always holds whole quads.
+ */
+const int PatchBatchVertices = 6 * 256;
+
+/**
+ * Called with each batch of count vertices; normals and texCoords are
+ * NULL if the stream was created without them.  The arrays are reused
+ * for the next batch once the callback returns.
+ */
+typedef void (*patch_batch_func)( const point4 points[], const vec3 normals[],
+                                  const vec2 texCoords[], int count, void *data );
+
+struct patch_stream {
+    patch_batch_func emit;          // callback for each batch
+    void            *data;          // passed to emit
+    bool             wantNormals;
+    bool             wantTexCoords;
+    int              count;         // vertices in the current batch
+    int              total;         // vertices emitted so far
+    point4           points[PatchBatchVertices];
+    vec3             normals[PatchBatchVertices];
+    vec2             texCoords[PatchBatchVertices];
+
+    patch_stream( patch_batch_func emit, void *data,
+                  bool wantNormals = true, bool wantTexCoords = true )
+      : emit(emit), data(data), wantNormals(wantNormals),
+        wantTexCoords(wantTexCoords), count(0), total(0) {}
+};
+
+/**
+ * Passes the vertices in the current batch of stream, if any,
+ * to its callback and starts a new batch.
+ */
+inline void
+flush_patch_stream( patch_stream& stream )
+{
+  if (stream.count > 0) {
+    stream.emit( stream.points,
+                 stream.wantNormals   ? stream.normals   : NULL,
+                 stream.wantTexCoords ? stream.texCoords : NULL,
+                 stream.count, stream.data );
+    stream.total += stream.count;
+    stream.count = 0;
+  }
+}
+
+void
+stream_patch_rec( point4 p[4][4], int subdivisions, int orientation,
+                  patch_stream& stream,
+                  GLfloat texSstart, GLfloat texSend, GLfloat texTstart, GLfloat texTend )
+{
+  if ( subdivisions > 0 ) {
+    point4 q[4][4], r[4][4], s[4][4], t[4][4];
+    point4 a[4][4], b[4][4];
+
+    divide_rows( p, a, b );
+    divide_cols( a, q, s );
+    divide_cols( b, r, t );
+
+    GLfloat texSmid = (texSstart + texSend) / 2;
+    GLfloat texTmid = (texTstart + texTend) / 2;
+
+    stream_patch_rec( q, subdivisions - 1, orientation, stream,
+                      texSstart, texSmid, texTstart, texTmid );
+    stream_patch_rec( r, subdivisions - 1, orientation, stream,
+                      texSstart, texSmid, texTmid, texTend );
+    stream_patch_rec( s, subdivisions - 1, orientation, stream,
+                      texSmid, texSend, texTstart, texTmid );
+    stream_patch_rec( t, subdivisions - 1, orientation, stream,
+                      texSmid, texSend, texTmid, texTend );
+  } else {
+    if (stream.count + 6 > PatchBatchVertices) flush_patch_stream( stream );
+    draw_patch( p, orientation, stream.points,
+                stream.wantNormals   ? stream.normals   : NULL,
+                stream.wantTexCoords ? stream.texCoords : NULL,
+                stream.count, texSstart, texSend, texTstart, texTend );
+    stream.count += 6;
+  }
+}
+
+/**
+ * Divides a Bezier patch subdivisions times, like divide_patch(),
+ * but passes the resulting vertices to stream in fixed-size batches.
+ * Call flush_patch_stream() after the last patch to emit the final,
+ * partly filled batch.
+ *
+ * @return the number of vertices produced for this patch,
+ *         6 * numQuadsPerPatch(subdivisions);
+ *         -1 if orientation is not BACK_TO_FRONT or FRONT_TO_BACK
+ */
+int
+stream_patch( point4 p[4][4], int subdivisions, int orientation,
+              patch_stream& stream,
               GLfloat texSstart, GLfloat texSend, GLfloat texTstart, GLfloat texTend )
 {
-  int numpoints = 6 * numQuadsPerPatch( subdivisions );
-  int normalsNULL   = (normals   == NULL);
-  int texCoordsNULL = (texCoords == NULL);
-  if (points    == NULL) return -1;
-  if (normalsNULL)   normals   = new vec3[numpoints];
-  if (texCoordsNULL) texCoords = new vec2[numpoints];
-  int result = divide_patch_rec( p, subdivisions, orientation,
-                                 points, normals, texCoords, start,
-                                 texSstart, texSend, texTstart, texTend );
-  if (normalsNULL)   delete [] normals;
-  if (texCoordsNULL) delete [] texCoords;
-  return result;
+  if (orientation != BACK_TO_FRONT && orientation != FRONT_TO_BACK) return -1;
+  stream_patch_rec( p, subdivisions, orientation, stream,
+                    texSstart, texSend, texTstart, texTend );
+  return 6 * numQuadsPerPatch( subdivisions );
 }
 
 
@@ -0,0 +1,148 @@
+/*
+ * File: culling.h
+ */
+
+#ifndef CULLING_H
+#define CULLING_H
+
+/**
+ * Frustum culling on the CPU: before uploading and drawing many copies of
+ * a shape, find the ones whose bounding spheres are inside the view
+ * volume, so the others are neither copied to an instance buffer nor
+ * drawn.
+ *
+ * Each copy's sphere is the shape's bounding sphere (ShapeBounds, from
+ * shapeBounds() in holeyShapes.h or ShapeMesh::bounds in shapeCache.h)
+ * moved by the copy's model matrix, its radius grown by the largest scale
+ * in the matrix (maxScale() in mat.h).  The spheres are tested four at a
+ * time against the six planes of a ViewFrustum (mat.h), with the SIMD
+ * kernel in simd.h when there is one:
+ *
+ *   FrustumCuller culler;
+ *   ...
+ *   ViewFrustum frustum( p * lookAt );
+ *   int n = culler.cull( frustum, models, numModels, pyrBounds );
+ *   culler.compact( models, visibleModels );     // the n inside, in order
+ *   pyramids.update( visibleModels, n );
+ *   ... draw n instances ...
+ *
+ * The culler counts the objects it has tested and culled, so a program
+ * can report what fraction of its objects were skipped.
+ */
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/holeyShapes.h"
+#include <vector>
+
+class FrustumCuller {
+
+  // Four spheres, each coordinate in its own vector
+  struct ANGEL_ALIGN16 SphereBlock {
+    GLfloat x[4], y[4], z[4], r[4];
+  };
+
+  std::vector<SphereBlock> blocks;
+  std::vector<int>         visible;     // indices of the last cull's spheres inside
+  long                     tested, culled;
+
+  /**
+   * Tests the four spheres of block; bit i of the result is set if sphere
+   * i is outside.
+   */
+  static int outside4( const ViewFrustum& frustum, const SphereBlock& block ) {
+#ifdef ANGEL_SIMD
+    return simd::spheresOutside4( &frustum.planes[0].x, block.x, block.y,
+                                  block.z, block.r );
+#else
+    int outside = 0;
+    for (int i = 0; i < 4; i++) {
+      vec4 center( block.x[i], block.y[i], block.z[i], 1.0 );
+      if (!frustum.containsSphere( center, block.r[i] )) outside |= 1 << i;
+    }
+    return outside;
+#endif
+  }
+
+ public:
+  FrustumCuller() : tested( 0 ), culled( 0 ) {}
+
+  /**
+   * Returns true if the copy of a shape with bounds placed by model is
+   * at least partly inside frustum.
+   */
+  bool test( const ViewFrustum& frustum, const mat4& model, const ShapeBounds& bounds ) {
+    vec4 center = model * vec4( bounds.center, 1.0 );
+    bool inside = frustum.containsSphere( center, bounds.radius * maxScale( model ) );
+    tested++;
+    if (!inside) culled++;
+    return inside;
+  }
+
+  /**
+   * Tests the n copies of a shape with bounds placed by models, and
+   * returns how many are at least partly inside frustum; indices() lists
+   * them.
+   */
+  int cull( const ViewFrustum& frustum, const mat4 models[], int n,
+            const ShapeBounds& bounds ) {
+    visible.clear();
+    if (n <= 0) return 0;
+
+    // The world spheres, with the unused ones of the last block outside
+    // every plane
+    int numBlocks = (n + 3) / 4;
+    blocks.resize( numBlocks );
+    SphereBlock& last = blocks[numBlocks - 1];
+    for (int i = 0; i < 4; i++) {
+      last.x[i] = last.y[i] = last.z[i] = 0.0;
+      last.r[i] = -1.0e30f;
+    }
+    vec4 localCenter( bounds.center, 1.0 );
+    for (int k = 0; k < n; k++) {
+      vec4 center = models[k] * localCenter;
+      SphereBlock& block = blocks[k / 4];
+      block.x[k % 4] = center.x;
+      block.y[k % 4] = center.y;
+      block.z[k % 4] = center.z;
+      block.r[k % 4] = bounds.radius * maxScale( models[k] );
+    }
+
+    for (int b = 0; b < numBlocks; b++) {
+      int outside = outside4( frustum, blocks[b] );
+      for (int i = 0; i < 4 && 4 * b + i < n; i++) {
+        if (!(outside & (1 << i))) visible.push_back( 4 * b + i );
+      }
+    }
+
+    tested += n;
+    culled += n - (int) visible.size();
+    return (int) visible.size();
+  }
+
+  /**
+   * The indices, into the models given to the last cull(), of the copies
+   * inside, in increasing order.
+   */
+  const std::vector<int>& indices() const { return visible; }
+
+  /**
+   * Copies the models of the copies the last cull() found inside to
+   * out, in order; out needs room for the number it returned.
+   */
+  void compact( const mat4 models[], mat4 out[] ) const {
+    for (size_t k = 0; k < visible.size(); k++) out[k] = models[visible[k]];
+  }
+
+  long numTested() const { return tested; }
+  long numCulled() const { return culled; }
+
+  /**
+   * Returns the fraction of the objects tested so far that were culled.
+   */
+  double culledRatio() const { return tested > 0 ? (double) culled / tested : 0.0; }
+
+  void resetStats() { tested = culled = 0; }
+};
+
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ * File: frameHandoff.h
+ */
+
+#ifndef FRAME_HANDOFF_H
+#define FRAME_HANDOFF_H
+
+/**
+ * Running the animation on its own thread while the GL thread draws.  The
+ * update thread advances the objects at a fixed rate and writes what is to
+ * be drawn (their model matrices, or whatever display() needs) into a
+ * frame packet; the GL thread draws the newest packet.  The packets are
+ * passed through a TripleBuffer, so neither thread ever waits for the
+ * other: the writer always has a buffer of its own to fill, the reader
+ * always has a complete one to draw, and the third holds the newest
+ * finished packet between them.
+ *
+ *   struct Packet { mat4 globe; std::vector<mat4> field; };
+ *   TripleBuffer<Packet> packets;
+ *
+ *   void step() {                         // on the update thread
+ *       ... advance the animation ...
+ *       Packet& p = packets.writing();
+ *       p.globe = ...;
+ *       packets.publish();
+ *   }
+ *   UpdateThread updater( 1.0 / 60.0, step );
+ *
+ *   void display() {                      // on the GL thread
+ *       packets.acquire();                // take the newest, if any
+ *       const Packet& p = packets.reading();
+ *       ...
+ *
+ *   updater.start();                      // in main(), after init()
+ *
+ * Anything read by both threads has to go through a packet (or be
+ * atomic); input that only changes the view, such as the eye position,
+ * can stay on the GL thread, where it reaches the next frame directly.
+ * Headless runs do not start the thread and call updater.runStep() once
+ * a frame instead, so that their frames are the same every time.
+ *
+ * Requires C++11 <atomic> and <thread>; link with -pthread.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+template <class Frame>
+class TripleBuffer {
+
+  enum { INDEX = 3, FRESH = 4 };     // the bits of middle
+
+  Frame            frames[3];
+  std::atomic<int> middle;           // the buffer between them, | FRESH if unread
+  int              back;             // the writer's
+  int              front;            // the reader's
+
+  TripleBuffer( const TripleBuffer& );           // not copyable
+  TripleBuffer& operator = ( const TripleBuffer& );
+
+ public:
+  TripleBuffer() : middle( 1 ), back( 0 ), front( 2 ) {}
+
+  /**
+   * The writer's packet.  It holds whatever was last written to this
+   * buffer, some packets ago, so write all of it.
+   */
+  Frame& writing() { return frames[back]; }
+
+  /**
+   * Makes the writer's packet the newest one and gives the writer another
+   * buffer.
+   */
+  void publish() {
+    back = middle.exchange( back | FRESH, std::memory_order_acq_rel ) & INDEX;
+  }
+
+  /**
+   * Takes the newest packet for the reader, if one was published since
+   * the last call; returns false, keeping the reader's packet, if not.
+   */
+  bool acquire() {
+    if (!(middle.load( std::memory_order_relaxed ) & FRESH)) return false;
+    front = middle.exchange( front, std::memory_order_acq_rel ) & INDEX;
+    return true;
+  }
+
+  /**
+   * The reader's packet, which stays the same until the next acquire().
+   */
+  const Frame& reading() const { return frames[front]; }
+
+  /**
+   * Sets every buffer to frame, before the threads start.
+   */
+  void fill( const Frame& frame ) {
+    for (int i = 0; i < 3; i++) frames[i] = frame;
+  }
+};
+
+/**
+ * Calls a step function on a thread of its own, a fixed number of times
+ * a second.  After a stall (a debugger, a heavily loaded machine) it
+ * skips the missed steps instead of hurrying to catch up.
+ */
+class UpdateThread {
+
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+ private:
+  std::function<void()> step;
+  Clock::duration       period;
+  std::thread           thread;
+  std::atomic<bool>     stopping;
+  std::atomic<bool>     paused;
+
+  UpdateThread( const UpdateThread& );           // not copyable
+  UpdateThread& operator = ( const UpdateThread& );
+
+  void loop() {
+    Clock::time_point next = Clock::now();
+    while (!stopping.load()) {
+      if (!paused.load()) step();
+      next += period;
+      Clock::time_point now = Clock::now();
+      if (now > next + 4 * period) {
+        next = now;                      // too far behind: skip ahead
+      } else {
+        std::this_thread::sleep_until( next );
+      }
+    }
+  }
+
+ public:
+  /**
+   * Calls step() every stepSeconds seconds once started.
+   */
+  UpdateThread( double stepSeconds, const std::function<void()>& step )
+    : step( step ),
+      period( std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>( stepSeconds ) ) ),
+      stopping( false ), paused( false ) {}
+
+  ~UpdateThread() { stop(); }
+
+  void start() {
+    if (thread.joinable()) return;
+    stopping = false;
+    thread = std::thread( &UpdateThread::loop, this );
+  }
+
+  void stop() {
+    stopping = true;
+    if (thread.joinable()) thread.join();
+  }
+
+  bool running() const { return thread.joinable(); }
+
+  /**
+   * Stops or restarts the steps; the thread keeps running.
+   */
+  void setPaused( bool p ) { paused = p; }
+  bool isPaused() const { return paused.load(); }
+
+  /**
+   * Takes one step on the calling thread, for runs without the update
+   * thread.
+   */
+  void runStep() { step(); }
+
+  double stepSeconds() const { return std::chrono::duration<double>( period ).count(); }
+
+  /**
+   * Returns how far the present is from a step finished at stepTime
+   * toward the next one, from 0 to 1, for drawing between a packet's
+   * previous and current states.  Without the thread, or while paused,
+   * it is 1: the current state.
+   */
+  double alpha( Clock::time_point stepTime ) const {
+    if (!running() || isPaused()) return 1.0;
+    double a = std::chrono::duration<double>( Clock::now() - stepTime ).count() /
+               stepSeconds();
+    return (a < 0.0) ? 0.0 : (a > 1.0) ? 1.0 : a;
+  }
+};
+
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ * File: headless.h
+ */
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+/**
+ * Headless running of the sample programs, for machines with no display
+ * or GPU: instead of opening a GLUT window, the program renders a fixed
+ * number of frames into a framebuffer object of an EGL context that has
+ * no window (Mesa's surfaceless platform, which runs on llvmpipe when
+ * there is no GPU), optionally writes each frame to a PPM file, and
+ * reports how long the frames took.
+ *
+ * The mode is chosen on the command line:
+ *
+ *   movingGlobe --headless [frames] [--size WxH] [--dump prefix]
+ *
+ * renders frames frames (default 60) of WxH pixels (default the window
+ * size) and, with --dump, writes them to prefix0000.ppm, prefix0001.ppm,
+ * ...  A program supports it by starting with headlessInit(), which
+ * removes these options from argv, creating its window only when that
+ * returns false, and handing its callbacks to headlessRun() instead of
+ * glutMainLoop() when it returns true:
+ *
+ *   bool headless = headlessInit( argc, argv, windowSize, windowSize );
+ *   if ( !headless ) {
+ *       glutInit( &argc, argv );
+ *       ...
+ *       glutCreateWindow( "Title" );
+ *   }
+ *   glewExperimental = GL_TRUE;
+ *   glewInit();
+ *   init();
+ *   if ( headless ) return headlessRun( display, idle, reshape );
+ *   glutDisplayFunc( display );
+ *   ...
+ *
+ * GLUT cannot be called at all in headless mode, so display() ends with
+ * sampleSwapBuffers() and idle() with samplePostRedisplay() in place of
+ * the GLUT calls; in a window they do the same as before.
+ *
+ * Link with -lEGL.  GLEW built for GLX reports an error from glewInit()
+ * under EGL after it has loaded the GL functions, so the samples, which
+ * ignore its result, work unchanged.  Not available on Mac OS X or
+ * Windows, where headlessInit() fails if --headless is given.
+ */
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if !defined(__APPLE__) && !defined(_WIN32)
+#  define HEADLESS_EGL
+#  include <EGL/egl.h>
+#  include <EGL/eglext.h>
+#endif
+
+/**
+ * The state of headless mode, shared by the functions below.
+ */
+struct HeadlessState {
+  bool        active;
+  int         frames;
+  int         width, height;
+  std::string dumpPrefix;        // empty for no dumps
+
+  HeadlessState() : active( false ), frames( 60 ), width( 0 ), height( 0 ) {}
+
+  static HeadlessState& get() {
+    static HeadlessState state;
+    return state;
+  }
+};
+
+/**
+ * Returns true if the program is running headless.
+ */
+inline bool headlessActive() { return HeadlessState::get().active; }
+
+/**
+ * Writes the current framebuffer, width x height, to path as a binary
+ * PPM.  Returns false if the file cannot be written.
+ */
+inline bool writeFramePPM( const char *path, int width, int height ) {
+  std::vector<unsigned char> pixels( 3 * width * height );
+  glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+  glReadPixels( 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0] );
+
+  FILE *file = fopen( path, "wb" );
+  if (file == NULL) return false;
+  fprintf( file, "P6\n%d %d\n255\n", width, height );
+  for (int row = height - 1; row >= 0; row--) {     // PPM runs top to bottom
+    fwrite( &pixels[3 * width * row], 3, width, file );
+  }
+  return fclose( file ) == 0;
+}
+
+#ifdef HEADLESS_EGL
+
+/**
+ * Creates an OpenGL 3.3 core context with no window and makes it
+ * current, with a width x height framebuffer object (RGBA8 color, 24-bit
+ * depth) bound to draw into.  Returns false, printing why, if it cannot.
+ */
+inline bool headlessCreateContext( int width, int height ) {
+  EGLDisplay display = EGL_NO_DISPLAY;
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+  if (getPlatformDisplay != NULL) {
+    display = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA,
+                                  EGL_DEFAULT_DISPLAY, NULL );
+  }
+  if (display == EGL_NO_DISPLAY) display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+  EGLint major, minor;
+  if (display == EGL_NO_DISPLAY || !eglInitialize( display, &major, &minor )) {
+    fprintf( stderr, "headless: cannot initialize EGL\n" );
+    return false;
+  }
+  if (!eglBindAPI( EGL_OPENGL_API )) {
+    fprintf( stderr, "headless: EGL has no OpenGL support\n" );
+    return false;
+  }
+
+  // the default surface type is a window, which surfaceless displays lack
+  const EGLint configAttributes[] = {
+    EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_NONE
+  };
+  EGLConfig config;
+  EGLint    numConfigs;
+  if (!eglChooseConfig( display, configAttributes, &config, 1, &numConfigs ) ||
+      numConfigs < 1) {
+    fprintf( stderr, "headless: no EGL config for OpenGL\n" );
+    return false;
+  }
+
+  const EGLint contextAttributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+  EGLContext context = eglCreateContext( display, config, EGL_NO_CONTEXT,
+                                         contextAttributes );
+  if (context == EGL_NO_CONTEXT ||
+      !eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, context )) {
+    fprintf( stderr, "headless: cannot create a surfaceless OpenGL 3.3 context\n" );
+    return false;
+  }
+
+  // There is no default framebuffer, so render into our own
+  GLuint framebuffer, color, depth;
+  glGenFramebuffers( 1, &framebuffer );
+  glBindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+  glGenRenderbuffers( 1, &color );
+  glBindRenderbuffer( GL_RENDERBUFFER, color );
+  glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, width, height );
+  glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                             GL_RENDERBUFFER, color );
+  glGenRenderbuffers( 1, &depth );
+  glBindRenderbuffer( GL_RENDERBUFFER, depth );
+  glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height );
+  glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                             GL_RENDERBUFFER, depth );
+  if (glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE) {
+    fprintf( stderr, "headless: framebuffer object is incomplete\n" );
+    return false;
+  }
+  return true;
+}
+
+#else
+
+inline bool headlessCreateContext( int width, int height ) {
+  fprintf( stderr, "headless: not supported on this platform\n" );
+  return false;
+}
+
+#endif  // HEADLESS_EGL
+
+/**
+ * Looks for --headless [frames], --size WxH and --dump prefix in argv,
+ * removing them so the rest can go to glutInit() and the program.  If
+ * --headless is given, creates the context to render into, width x
+ * height unless --size says otherwise, and returns true; the program
+ * exits if that fails or an option is malformed.  Otherwise returns
+ * false, and the program opens its window as usual.
+ */
+inline bool headlessInit( int& argc, char **argv, int width, int height ) {
+  HeadlessState& state = HeadlessState::get();
+  state.width  = width;
+  state.height = height;
+
+  bool requested = false;
+  int  kept = 1;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (strcmp( arg, "--headless" ) == 0) {
+      requested = true;
+      if (i + 1 < argc && argv[i+1][0] >= '0' && argv[i+1][0] <= '9') {
+        state.frames = atoi( argv[++i] );
+      }
+    } else if (strcmp( arg, "--size" ) == 0 && i + 1 < argc) {
+      if (sscanf( argv[++i], "%dx%d", &state.width, &state.height ) != 2 ||
+          state.width <= 0 || state.height <= 0) {
+        fprintf( stderr, "headless: --size must be WIDTHxHEIGHT\n" );
+        exit( EXIT_FAILURE );
+      }
+    } else if (strcmp( arg, "--dump" ) == 0 && i + 1 < argc) {
+      state.dumpPrefix = argv[++i];
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  argc = kept;
+  argv[argc] = NULL;
+
+  if (!requested) return false;
+  if (state.frames < 1) {
+    fprintf( stderr, "headless: the number of frames must be at least 1\n" );
+    exit( EXIT_FAILURE );
+  }
+  if (!headlessCreateContext( state.width, state.height )) exit( EXIT_FAILURE );
+  state.active = true;
+  return true;
+}
+
+/**
+ * Runs the program headless: calls reshape (if not NULL) with the frame
+ * size, then display and idle (if not NULL) for each frame, writing the
+ * frames out if --dump was given.  Prints the average time to render a
+ * frame, not counting writing it, and returns EXIT_SUCCESS, or
+ * EXIT_FAILURE if a frame could not be written.
+ */
+inline int headlessRun( void (*display)( void ), void (*idle)( void ),
+                        void (*reshape)( int, int ) ) {
+  typedef std::chrono::steady_clock Clock;
+  const HeadlessState& state = HeadlessState::get();
+
+  glViewport( 0, 0, state.width, state.height );
+  if (reshape != NULL) reshape( state.width, state.height );
+
+  double totalMs = 0.0;
+  for (int frame = 0; frame < state.frames; frame++) {
+    Clock::time_point start = Clock::now();
+    display();
+    glFinish();
+    totalMs += std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+
+    if (!state.dumpPrefix.empty()) {
+      char path[1024];
+      snprintf( path, sizeof(path), "%s%04d.ppm", state.dumpPrefix.c_str(), frame );
+      if (!writeFramePPM( path, state.width, state.height )) {
+        fprintf( stderr, "headless: cannot write %s\n", path );
+        return EXIT_FAILURE;
+      }
+    }
+    if (idle != NULL) idle();
+  }
+
+  printf( "%d frames of %dx%d, %.3f ms per frame\n",
+          state.frames, state.width, state.height, totalMs / state.frames );
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Ends display(): swaps buffers in a window; headless, the frame stays
+ * in the framebuffer object for headlessRun() to read.
+ */
+inline void sampleSwapBuffers() {
+  if (!headlessActive()) glutSwapBuffers();
+}
+
+/**
+ * Asks for display() to be called again; headless, every frame is
+ * displayed anyway.
+ */
+inline void samplePostRedisplay() {
+  if (!headlessActive()) glutPostRedisplay();
+}
+
+
+#endif
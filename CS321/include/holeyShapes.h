@@ -14,9 +14,30 @@
  * Each function takes a pointer to an array of point4 (vec4) points and a starting
  * index start; it returns the index of the next unused position in the array.
  * For every function, the number of available array elements needed is specified.
+ * Functions that need temporary arrays take them from a ScratchArena
+ * (see arena.h), by default the calling thread's, so generating shapes
+ * repeatedly does not allocate memory once the arena is big enough.
+ *
+ * Each shape can also be generated as an indexed mesh, for drawing with
+ * glDrawElements: the unique vertices are stored in an array of point4
+ * beginning at position vStart, and the triangles as an array of GLushort
+ * or GLuint indices beginning at position iStart.  The indices refer to
+ * positions in the whole vertex array, so several shapes can share one
+ * vertex buffer and one index buffer.  These functions return the index
+ * of the next unused position in the index array.
+ * The vertex arrays of the indexed shapes, and the color arrays, are
+ * Strided arrays (see vertexFormat.h), so the shapes can be written
+ * straight into one attribute of an interleaved vertex array; ordinary
+ * point4 and color4 arrays can be passed as before.
  */
 
 #include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/arena.h"
+#include "/usr/people/classes/CS321/include/vertexFormat.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
 
 #ifndef point4
 typedef Angel::vec4 point4;
@@ -27,12 +48,88 @@ typedef Angel::vec4 color4;
 #endif
 
 
+/*****************************************************************************
+/*
+/* Trigonometric tables for rings of vertices
+/*
+/*****************************************************************************/
+
+/**
+ * The cosines and sines of the k angles 2*pi*i/k, i = 0 ... k-1, of a ring
+ * of k vertices around a circle.
+ */
+struct RingTable {
+  int            k;
+  const GLfloat *cosines;
+  const GLfloat *sines;
+};
+
+/**
+ * Returns the ring table for k vertices.  Each table is computed once, in
+ * double precision, the first time it is asked for, and is then shared by
+ * every generator and thread for the rest of the program; the pointers in
+ * it never become invalid.  Quarter-turn symmetry makes the angles that
+ * are multiples of 90 degrees exact.
+ */
+RingTable ringTable( int k ) {
+  static std::mutex lock;
+  static std::map<int, std::vector<GLfloat> > tables;  // k cosines, then k sines
+
+  std::lock_guard<std::mutex> guard( lock );
+  std::vector<GLfloat>& table = tables[k];
+  if (table.empty() && k > 0) {
+    table.resize( 2 * k );
+    for (int i = 0; i < k; i++) {
+      double angle = 2 * M_PI * i / k;
+      table[i]     = cos(angle);
+      table[k + i] = sin(angle);
+      if (4 * i % k == 0) {           // exact on the axes
+        static const GLfloat axisCos[4] = { 1.0, 0.0, -1.0,  0.0 };
+        static const GLfloat axisSin[4] = { 0.0, 1.0,  0.0, -1.0 };
+        table[i]     = axisCos[4 * i / k];
+        table[k + i] = axisSin[4 * i / k];
+      }
+    }
+  }
+  RingTable result = { k, k > 0 ? &table[0] : NULL, k > 0 ? &table[k] : NULL };
+  return result;
+}
+
+
 /*****************************************************************************
 /*
 /* Functions that general shapes as triangles of points
 /*
 /*****************************************************************************/
 
+/**
+ * The corners of the unit cube, and the corners of each of its faces
+ * in counterclockwise order, shared by both forms of cube().
+ */
+const int CubeNumVertices  = 8;
+const int CubeNumFaces     = 6;
+const int CubeVertsPerFace = 4;
+
+const point4 cubeVertices[CubeNumVertices] = {
+  point4( -1.0, -1.0,  1.0,  1.0 ), // 0
+  point4( -1.0,  1.0,  1.0,  1.0 ), // 1
+  point4(  1.0,  1.0,  1.0,  1.0 ), // 2
+  point4(  1.0, -1.0,  1.0,  1.0 ), // 3
+  point4( -1.0, -1.0, -1.0,  1.0 ), // 4
+  point4( -1.0,  1.0, -1.0,  1.0 ), // 5
+  point4(  1.0,  1.0, -1.0,  1.0 ), // 6
+  point4(  1.0, -1.0, -1.0,  1.0 )  // 7
+};
+
+const int cubeFaceIndices[CubeNumFaces][CubeVertsPerFace] = {
+  { 1, 0, 3, 2 }, // 0  front face
+  { 2, 3, 7, 6 }, // 1  right face
+  { 3, 0, 4, 7 }, // 2  bottom face
+  { 6, 5, 1, 2 }, // 3  top face
+  { 4, 5, 6, 7 }, // 4  back face
+  { 5, 4, 0, 1 }  // 5  left face
+};
+
 /**
  * Generate a cube with unit coordinates.
  * This code is adapted from code by Angel & Shriener from their book
@@ -42,39 +139,39 @@ typedef Angel::vec4 color4;
  */
 int cube( point4 points[], int start) {
 
-  const int NumVertices  = 8;
-  const int NumFaces     = 6;
-  const int VertsPerFace = 4;
-
-  point4 vertices[NumVertices] = {
-    point4( -1.0, -1.0,  1.0,  1.0 ), // 0
-    point4( -1.0,  1.0,  1.0,  1.0 ), // 1
-    point4(  1.0,  1.0,  1.0,  1.0 ), // 2
-    point4(  1.0, -1.0,  1.0,  1.0 ), // 3
-    point4( -1.0, -1.0, -1.0,  1.0 ), // 4
-    point4( -1.0,  1.0, -1.0,  1.0 ), // 5
-    point4(  1.0,  1.0, -1.0,  1.0 ), // 6
-    point4(  1.0, -1.0, -1.0,  1.0 )  // 7
-  };
+  for (int i = 0; i < CubeNumFaces; i++ ) {
+    points[start++] = cubeVertices[cubeFaceIndices[i][0]];
+    points[start++] = cubeVertices[cubeFaceIndices[i][1]];
+    points[start++] = cubeVertices[cubeFaceIndices[i][2]];
+    points[start++] = cubeVertices[cubeFaceIndices[i][0]];
+    points[start++] = cubeVertices[cubeFaceIndices[i][2]];
+    points[start++] = cubeVertices[cubeFaceIndices[i][3]];
+  }
+  return start;
+}
 
-  int faceIndices[NumFaces][VertsPerFace] = {
-    { 1, 0, 3, 2 }, // 0  front face
-    { 2, 3, 7, 6 }, // 1  right face
-    { 3, 0, 4, 7 }, // 2  bottom face
-    { 6, 5, 1, 2 }, // 3  top face
-    { 4, 5, 6, 7 }, // 4  back face
-    { 5, 4, 0, 1 }  // 5  left face
-  };
+/**
+ * Generate a cube with unit coordinates as an indexed mesh.
+ * This cube requires 8 vertices in the array vertices,
+ * beginning at position vStart, and 36 indices in the array
+ * indices, beginning at position iStart.
+ * Returns iStart + 36.
+ */
+template <class Index>
+int cube( Strided<point4> vertices, int vStart, Index indices[], int iStart ) {
 
-  for (int i = 0; i < NumFaces; i++ ) {
-    points[start++] = vertices[faceIndices[i][0]];
-    points[start++] = vertices[faceIndices[i][1]];
-    points[start++] = vertices[faceIndices[i][2]];
-    points[start++] = vertices[faceIndices[i][0]];
-    points[start++] = vertices[faceIndices[i][2]];
-    points[start++] = vertices[faceIndices[i][3]];
+  for (int i = 0; i < CubeNumVertices; i++ ) {
+    vertices[vStart + i] = cubeVertices[i];
   }
-  return start;
+  for (int i = 0; i < CubeNumFaces; i++ ) {
+    indices[iStart++] = vStart + cubeFaceIndices[i][0];
+    indices[iStart++] = vStart + cubeFaceIndices[i][1];
+    indices[iStart++] = vStart + cubeFaceIndices[i][2];
+    indices[iStart++] = vStart + cubeFaceIndices[i][0];
+    indices[iStart++] = vStart + cubeFaceIndices[i][2];
+    indices[iStart++] = vStart + cubeFaceIndices[i][3];
+  }
+  return iStart;
 }
 
 /**
@@ -83,17 +180,19 @@ int cube( point4 points[], int start) {
  * apex at (0, 1, 0, 1).
  * A pyramid requires 6*k vertices in the array points,
  * beginning at position start.
+ * Its temporary arrays are taken from arena.
  */
-int pyramid( int k, point4 points[], int start) {
+int pyramid( int k, point4 points[], int start,
+             ScratchArena& arena = ScratchArena::threadLocal() ) {
 
   point4 apex       = point4( 0.0, 1.0, 0.0, 1.0);
   point4 baseCenter = point4( 0.0, 0.0, 0.0, 1.0);
-  point4 *baseVertices = new point4[k];
+  ScratchScope scratch( arena );
+  point4 *baseVertices = scratch.allocate<point4>( k );
 
-  double theta = 2 * M_PI / k;
+  const RingTable ring = ringTable( k );
   for (int i = 0; i < k; i++) {
-    double angle = i * theta;
-    baseVertices[i] = point4( cos(angle), 0.0, sin(angle), 1.0);
+    baseVertices[i] = point4( ring.cosines[i], 0.0, ring.sines[i], 1.0);
   }
 
   for (int i = 0; i < k-1; i++ ) {
@@ -114,24 +213,64 @@ int pyramid( int k, point4 points[], int start) {
   return start;
 }
 
+/**
+ * Generate a pyramid with a unit-radius k-gon base as an indexed mesh;
+ * the pyramid is the same as the one generated above.
+ * Vertex vStart is the base center, vStart + 1 the apex, and
+ * vStart + 2 ... vStart + k + 1 the base vertices.
+ * A pyramid requires k + 2 vertices in the array vertices,
+ * beginning at position vStart, and 6*k indices in the array indices,
+ * beginning at position iStart.
+ * Returns iStart + 6*k.
+ */
+template <class Index>
+int pyramid( int k, Strided<point4> vertices, int vStart, Index indices[], int iStart ) {
+
+  const int baseCenter = vStart;
+  const int apex       = vStart + 1;
+  const int base       = vStart + 2;
+
+  vertices[baseCenter] = point4( 0.0, 0.0, 0.0, 1.0);
+  vertices[apex]       = point4( 0.0, 1.0, 0.0, 1.0);
+
+  const RingTable ring = ringTable( k );
+  for (int i = 0; i < k; i++) {
+    vertices[base + i] = point4( ring.cosines[i], 0.0, ring.sines[i], 1.0);
+  }
+
+  for (int i = 0; i < k; i++ ) {
+    int next = (i + 1) % k;
+    indices[iStart++] = baseCenter;
+    indices[iStart++] = base + i;
+    indices[iStart++] = base + next;
+    indices[iStart++] = apex;
+    indices[iStart++] = base + next;
+    indices[iStart++] = base + i;
+  }
+
+  return iStart;
+}
+
 /**
  * Generate a cylinder with a unit-radius k-gon base;
  * the cylinder is vertical, with the bases in the
  * y = -1 and y = 1 planes.
  * A cylinder requires 12*k vertices in the array points.
+ * Its temporary arrays are taken from arena.
  */
-int cylinder( int k, point4 points[], int start) {
+int cylinder( int k, point4 points[], int start,
+              ScratchArena& arena = ScratchArena::threadLocal() ) {
 
   point4 topCenter       = point4( 0.0,  1.0, 0.0, 1.0);
   point4 bottomCenter    = point4( 0.0, -1.0, 0.0, 1.0);
-  point4 *topVertices    = new point4[k];
-  point4 *bottomVertices = new point4[k];
+  ScratchScope scratch( arena );
+  point4 *topVertices    = scratch.allocate<point4>( k );
+  point4 *bottomVertices = scratch.allocate<point4>( k );
 
-  double theta = 2 * M_PI / k;
+  const RingTable ring = ringTable( k );
   for (int i = 0; i < k; i++) {
-    double angle = i * theta;
-    topVertices[i]    = point4( cos(angle),  1.0, sin(angle), 1.0);
-    bottomVertices[i] = point4( cos(angle), -1.0, sin(angle), 1.0);
+    topVertices[i]    = point4( ring.cosines[i],  1.0, ring.sines[i], 1.0);
+    bottomVertices[i] = point4( ring.cosines[i], -1.0, ring.sines[i], 1.0);
   }
 
   for (int i = 0; i < k-1; i++ ) {
@@ -171,6 +310,55 @@ int cylinder( int k, point4 points[], int start) {
 }
 
 
+/**
+ * Generate a cylinder with a unit-radius k-gon base as an indexed mesh;
+ * the cylinder is the same as the one generated above.
+ * Vertex vStart is the bottom center, vStart + 1 the top center,
+ * followed by the k bottom vertices and then the k top vertices.
+ * A cylinder requires 2*k + 2 vertices in the array vertices,
+ * beginning at position vStart, and 12*k indices in the array indices,
+ * beginning at position iStart.
+ * Returns iStart + 12*k.
+ */
+template <class Index>
+int cylinder( int k, Strided<point4> vertices, int vStart, Index indices[], int iStart ) {
+
+  const int bottomCenter = vStart;
+  const int topCenter    = vStart + 1;
+  const int bottom       = vStart + 2;
+  const int top          = vStart + 2 + k;
+
+  vertices[bottomCenter] = point4( 0.0, -1.0, 0.0, 1.0);
+  vertices[topCenter]    = point4( 0.0,  1.0, 0.0, 1.0);
+
+  const RingTable ring = ringTable( k );
+  for (int i = 0; i < k; i++) {
+    vertices[bottom + i] = point4( ring.cosines[i], -1.0, ring.sines[i], 1.0);
+    vertices[top + i]    = point4( ring.cosines[i],  1.0, ring.sines[i], 1.0);
+  }
+
+  for (int i = 0; i < k; i++ ) {
+    int next = (i + 1) % k;
+    // triangle for bottom base
+    indices[iStart++] = bottomCenter;
+    indices[iStart++] = bottom + i;
+    indices[iStart++] = bottom + next;
+    // triangle for top base
+    indices[iStart++] = topCenter;
+    indices[iStart++] = top + next;
+    indices[iStart++] = top + i;
+    // triangles for side rectangle
+    indices[iStart++] = bottom + i;
+    indices[iStart++] = top + i;
+    indices[iStart++] = top + next;
+    indices[iStart++] = bottom + i;
+    indices[iStart++] = top + next;
+    indices[iStart++] = bottom + next;
+  }
+
+  return iStart;
+}
+
 /**
  * Create a point 1.0 units from the origin
  * on the same line as the line between p and the origin.
@@ -217,6 +405,33 @@ int divideTriangle( int divs,
 }
 
 
+/**
+ * The vertices and faces of the unit octahedron subdivided by
+ * spherichedron(); faces are counterclockwise seen from outside.
+ */
+const int OctahedronNumVertices = 6;
+const int OctahedronNumFaces    = 8;
+
+const point4 octahedronVertices[OctahedronNumVertices] = {
+  point4(  0.0,  1.0,  0.0,  1.0 ), // 0 top
+  point4(  0.0,  0.0,  1.0,  1.0 ), // 1 front
+  point4(  1.0,  0.0,  0.0,  1.0 ), // 2 right
+  point4(  0.0,  0.0, -1.0,  1.0 ), // 3 back
+  point4( -1.0,  0.0,  0.0,  1.0 ), // 4 left
+  point4(  0.0, -1.0,  0.0,  1.0 ), // 5 bottom
+};
+
+const int octahedronFaceIndices[OctahedronNumFaces][3] = {
+  { 0, 1, 2 }, // 0  upper right front face
+  { 0, 2, 3 }, // 1  upper right  rear face
+  { 0, 3, 4 }, // 2  upper  left  rear face
+  { 0, 4, 1 }, // 3  upper  left front face
+  { 5, 2, 1 }, // 4  lower right front face
+  { 5, 3, 2 }, // 5  lower right  rear face
+  { 5, 4, 3 }, // 6  lower  left  rear face
+  { 5, 1, 4 }, // 7  lower  left front face
+};
+
 /**
  * Generate a spherical polyhedron with vertices at
  * unit radius, centered at the origin.
@@ -239,40 +454,269 @@ int divideTriangle( int divs,
  */
 int spherichedron( int divs, point4 points[], int start) {
 
-  const int NumVertices  = 6;
-  const int NumFaces     = 8;
-  const int VertsPerFace = 3;
-
-  point4 vertices[NumVertices] = {
-    point4(  0.0,  1.0,  0.0,  1.0 ), // 0 top
-    point4(  0.0,  0.0,  1.0,  1.0 ), // 1 front
-    point4(  1.0,  0.0,  0.0,  1.0 ), // 2 right
-    point4(  0.0,  0.0, -1.0,  1.0 ), // 3 back
-    point4( -1.0,  0.0,  0.0,  1.0 ), // 4 left
-    point4(  0.0, -1.0,  0.0,  1.0 ), // 5 bottom
-  };
-
-  int faceIndices[NumFaces][VertsPerFace] = {
-    { 0, 1, 2 }, // 0  upper right front face
-    { 0, 2, 3 }, // 1  upper right  rear face
-    { 0, 3, 4 }, // 2  upper  left  rear face
-    { 0, 4, 1 }, // 3  upper  left front face
-    { 5, 2, 1 }, // 4  lower right front face
-    { 5, 3, 2 }, // 5  lower right  rear face
-    { 5, 4, 3 }, // 6  lower  left  rear face
-    { 5, 1, 4 }, // 7  lower  left front face
-  };
-
-  for (int i = 0; i < NumFaces; i++ ) {
+  for (int i = 0; i < OctahedronNumFaces; i++ ) {
     start = divideTriangle( divs,
-                            vertices[faceIndices[i][0]],
-                            vertices[faceIndices[i][1]],
-                            vertices[faceIndices[i][2]],
+                            octahedronVertices[octahedronFaceIndices[i][0]],
+                            octahedronVertices[octahedronFaceIndices[i][1]],
+                            octahedronVertices[octahedronFaceIndices[i][2]],
                             points, start );
   }
   return start;
 }
 
+/**
+ * A cache of edge midpoints for subdividing indexed triangle meshes.
+ * Every edge of every level of the subdivision has an id, worked out
+ * from the id of the edge or triangle it came from, and a slot holding
+ * the index of the vertex unit( a + b ) at its midpoint once that has
+ * been computed.  The second triangle to use an edge finds the midpoint
+ * in the edge's slot, so each midpoint is computed only once, without
+ * searching for the edge.
+ *
+ * A level with numEdges edges and numFaces triangles gives the next
+ * level 2 * numEdges + 3 * numFaces edges: the halves of edge e are
+ * edges 2e, at its lower-numbered vertex, and 2e + 1, and the three
+ * edges inside triangle t are 2 * numEdges + 3t to 2 * numEdges + 3t + 2.
+ * The four triangles triangle t is divided into are triangles 4t to
+ * 4t + 3 of the next level.  The slots, one int for each edge of every
+ * level but the last, are taken from a ScratchArena; they are freed with
+ * the scope that the cache is created in.
+ */
+class MidpointCache {
+
+  int *slots;         // every level's, one level after another
+  int *levelStart;    // where each level's slots begin in slots
+  int  levels;
+
+  MidpointCache( const MidpointCache& );             // not copyable
+  MidpointCache& operator=( const MidpointCache& );
+
+ public:
+  /**
+   * A cache for divs subdivisions of a mesh of numFaces triangles with
+   * numEdges edges.
+   */
+  MidpointCache( int divs, int numEdges, int numFaces, ScratchArena& arena )
+    : levels(divs) {
+    levelStart = arena.allocate<int>( divs + 1 );
+    levelStart[0] = 0;
+    for (int level = 0; level < divs; level++) {
+      levelStart[level+1] = levelStart[level] + numEdges;
+      numEdges  = 2 * numEdges + 3 * numFaces;
+      numFaces *= 4;
+    }
+    slots = arena.allocate<int>( levelStart[divs] );
+    for (int i = 0; i < levelStart[divs]; i++) slots[i] = -1;
+  }
+
+  /**
+   * Returns the number of edges of the mesh after level subdivisions.
+   */
+  int numEdges( int level ) const {
+    return levelStart[level+1] - levelStart[level];
+  }
+
+  /**
+   * Returns the index of the midpoint of edge edge of level level,
+   * between vertices a and b, on the unit sphere.  The first time the
+   * edge is seen the midpoint is stored in vertices at position vNext,
+   * which is then incremented.
+   */
+  int midpoint( int level, int edge, int a, int b,
+                Strided<point4> vertices, int& vNext ) {
+    int& slot = slots[levelStart[level] + edge];
+    if (slot < 0) {
+      vertices[vNext] = unit( vertices[a] + vertices[b] );
+      slot = vNext++;
+    }
+    return slot;
+  }
+
+  /**
+   * Returns the id, at the next level, of the half at vertex p of edge
+   * edge between vertices p and q.
+   */
+  static int half( int edge, int p, int q ) { return 2 * edge + (p > q); }
+};
+
+/**
+ * Recursively divides triangle t of level level, with vertex indices
+ * a, b, c and edge ids ab, ac, bc, into 4 triangles divs times, like
+ * divideTriangle() above, storing new vertices in vertices at position
+ * vNext and the triangles' indices in indices at position start.
+ * Returns start + 3 * 4^divs
+ */
+template <class Index>
+int divideIndexedTriangle( int divs, int level, int t,
+                           int a, int b, int c, int ab, int ac, int bc,
+                           MidpointCache& cache,
+                           Strided<point4> vertices, int& vNext,
+                           Index indices[], int start ) {
+  if (divs > 0) {
+    int v1 = cache.midpoint( level, ab, a, b, vertices, vNext );
+    int v2 = cache.midpoint( level, ac, a, c, vertices, vNext );
+    int v3 = cache.midpoint( level, bc, b, c, vertices, vNext );
+    if (divs == 1) {
+      // the last level: its triangles need no edge ids
+      Index *out = indices + start;
+      out[0] =  a;  out[1]  = v1;  out[2]  = v2;
+      out[3] =  c;  out[4]  = v2;  out[5]  = v3;
+      out[6] =  b;  out[7]  = v3;  out[8]  = v1;
+      out[9] = v1;  out[10] = v3;  out[11] = v2;
+      return start + 12;
+    }
+    int inside = 2 * cache.numEdges( level ) + 3 * t;  // v1v2, v2v3, v3v1
+    start = divideIndexedTriangle( divs-1, level+1, 4*t,      a, v1, v2,
+                                   MidpointCache::half( ab, a, b ),
+                                   MidpointCache::half( ac, a, c ), inside,
+                                   cache, vertices, vNext, indices, start );
+    start = divideIndexedTriangle( divs-1, level+1, 4*t + 1,  c, v2, v3,
+                                   MidpointCache::half( ac, c, a ),
+                                   MidpointCache::half( bc, c, b ), inside + 1,
+                                   cache, vertices, vNext, indices, start );
+    start = divideIndexedTriangle( divs-1, level+1, 4*t + 2,  b, v3, v1,
+                                   MidpointCache::half( bc, b, c ),
+                                   MidpointCache::half( ab, b, a ), inside + 2,
+                                   cache, vertices, vNext, indices, start );
+    start = divideIndexedTriangle( divs-1, level+1, 4*t + 3, v1, v3, v2,
+                                   inside + 2, inside, inside + 1,
+                                   cache, vertices, vNext, indices, start );
+  } else {
+    indices[start++] = a;
+    indices[start++] = b;
+    indices[start++] = c;
+  }
+  return start;
+}
+
+/**
+ * Subdivides the closed polyhedron with numVertices vertices and
+ * numFaces triangular faces divs times, projecting new vertices
+ * onto the unit sphere, and stores it as an indexed mesh.
+ * The edges of the polyhedron are numbered first, in the order the
+ * faces use them; they and the midpoint cache are taken from arena.
+ * Returns iStart + 3 * numFaces * 4^divs
+ */
+template <class Index>
+int subdivideSphere( int divs,
+                     int numVertices, const point4 baseVertices[],
+                     int numFaces, const int faceIndices[][3],
+                     Strided<point4> vertices, int vStart,
+                     Index indices[], int iStart,
+                     ScratchArena& arena = ScratchArena::threadLocal() ) {
+  for (int i = 0; i < numVertices; i++) {
+    vertices[vStart + i] = baseVertices[i];
+  }
+  int vNext = vStart + numVertices;
+  ScratchScope scratch( arena );
+
+  // each face's edges ab, ac and bc, numbered as they are first used
+  int *faceEdges = scratch.allocate<int>( 3 * numFaces );
+  int *edgeEnds  = scratch.allocate<int>( 6 * numFaces );
+  int  numEdges  = 0;
+  const int corners[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+  for (int i = 0; i < numFaces; i++) {
+    for (int k = 0; k < 3; k++) {
+      int p = faceIndices[i][corners[k][0]], q = faceIndices[i][corners[k][1]];
+      if (p > q) { int t = p; p = q; q = t; }
+      int e = 0;
+      while (e < numEdges && (edgeEnds[2*e] != p || edgeEnds[2*e+1] != q)) e++;
+      if (e == numEdges) {
+        edgeEnds[2*e]   = p;
+        edgeEnds[2*e+1] = q;
+        numEdges++;
+      }
+      faceEdges[3*i + k] = e;
+    }
+  }
+
+  MidpointCache cache( divs, numEdges, numFaces, arena );
+  for (int i = 0; i < numFaces; i++ ) {
+    iStart = divideIndexedTriangle( divs, 0, i,
+                                    vStart + faceIndices[i][0],
+                                    vStart + faceIndices[i][1],
+                                    vStart + faceIndices[i][2],
+                                    faceEdges[3*i], faceEdges[3*i + 1],
+                                    faceEdges[3*i + 2],
+                                    cache, vertices, vNext,
+                                    indices, iStart );
+  }
+  return iStart;
+}
+
+/**
+ * Generate the spherical polyhedron above as an indexed mesh;
+ * every edge midpoint is computed once and shared by its two triangles.
+ * The number of array elements required is as follows:
+ *
+ *   divs     vertices        indices
+ *     0           6              24
+ *     1          18              96
+ *     2          66             384
+ *     k     4^(k+1) + 2      24 * 4^k
+ *
+ * GLushort indices can be used up to divs = 6; use GLuint beyond that.
+ * Its temporary arrays are taken from arena.
+ * returns iStart + 24 * 4^divs
+ */
+template <class Index>
+int spherichedron( int divs, Strided<point4> vertices, int vStart,
+                   Index indices[], int iStart,
+                   ScratchArena& arena = ScratchArena::threadLocal() ) {
+  return subdivideSphere( divs, OctahedronNumVertices, octahedronVertices,
+                          OctahedronNumFaces, octahedronFaceIndices,
+                          vertices, vStart, indices, iStart, arena );
+}
+
+/**
+ * Generate a spherical polyhedron with vertices at unit radius,
+ * centered at the origin, by subdividing the faces of an icosahedron
+ * divs times, as an indexed mesh.  Its triangles are more uniform in
+ * size than those of spherichedron().
+ * The number of array elements required is as follows:
+ *
+ *   divs     vertices        indices
+ *     0          12              60
+ *     1          42             240
+ *     2         162             960
+ *     k    10 * 4^k + 2      60 * 4^k
+ *
+ * GLushort indices can be used up to divs = 6; use GLuint beyond that.
+ * Its temporary arrays are taken from arena.
+ * returns iStart + 60 * 4^divs
+ */
+template <class Index>
+int icosphere( int divs, Strided<point4> vertices, int vStart,
+               Index indices[], int iStart,
+               ScratchArena& arena = ScratchArena::threadLocal() ) {
+
+  const GLfloat t = (1.0 + sqrt(5.0)) / 2.0;  // golden ratio
+  const point4 icosahedronVertices[12] = {
+    unit( point4( -1.0,    t,  0.0, 1.0 ) ),
+    unit( point4(  1.0,    t,  0.0, 1.0 ) ),
+    unit( point4( -1.0,   -t,  0.0, 1.0 ) ),
+    unit( point4(  1.0,   -t,  0.0, 1.0 ) ),
+    unit( point4(  0.0, -1.0,    t, 1.0 ) ),
+    unit( point4(  0.0,  1.0,    t, 1.0 ) ),
+    unit( point4(  0.0, -1.0,   -t, 1.0 ) ),
+    unit( point4(  0.0,  1.0,   -t, 1.0 ) ),
+    unit( point4(    t,  0.0, -1.0, 1.0 ) ),
+    unit( point4(    t,  0.0,  1.0, 1.0 ) ),
+    unit( point4(   -t,  0.0, -1.0, 1.0 ) ),
+    unit( point4(   -t,  0.0,  1.0, 1.0 ) )
+  };
+  const int icosahedronFaceIndices[20][3] = {
+    { 0, 11,  5 }, { 0,  5,  1 }, {  0,  1,  7 }, {  0,  7, 10 }, { 0, 10, 11 },
+    { 1,  5,  9 }, { 5, 11,  4 }, { 11, 10,  2 }, { 10,  7,  6 }, { 7,  1,  8 },
+    { 3,  9,  4 }, { 3,  4,  2 }, {  3,  2,  6 }, {  3,  6,  8 }, { 3,  8,  9 },
+    { 4,  9,  5 }, { 2,  4, 11 }, {  6,  2, 10 }, {  8,  6,  7 }, { 9,  8,  1 }
+  };
+
+  return subdivideSphere( divs, 12, icosahedronVertices,
+                          20, icosahedronFaceIndices,
+                          vertices, vStart, indices, iStart, arena );
+}
+
 /**
  * Generates triangles representing a globe divided into latitude
  * and longitude segments;
@@ -289,16 +733,19 @@ int spherichedron( int divs, point4 points[], int start) {
  * @return -1 if longDivs < 3 or latDivs < 2,
  *         start + 6 * longDivs * (latDivs - 1) otherwise
  */
-int globe( int longDivs, int latDivs, point4 points[], int start ) {
+int globe( int longDivs, int latDivs, point4 points[], int start,
+           ScratchArena& arena = ScratchArena::threadLocal() ) {
   if (longDivs < 3 || latDivs < 2) return -1;
   const int numVertices = longDivs * (latDivs + 1);
-  const GLfloat longAngleDiv = 2 * M_PI / longDivs;
-  const GLfloat latAngleDiv  = M_PI / latDivs;
+  // latitude angles are multiples of pi/latDivs, i.e. of a 2*latDivs ring
+  const RingTable longRing = ringTable( longDivs );
+  const RingTable latRing  = ringTable( 2 * latDivs );
 
   const point4 northPole = point4( 0.0,  1.0, 0.0, 1.0 );
   const point4 southPole = point4( 0.0, -1.0, 0.0, 1.0 );
 
-  point4 *vertices = new point4[numVertices];
+  ScratchScope scratch( arena );
+  point4 *vertices = scratch.allocate<point4>( numVertices );
 
   // put poles in first and last rows
   const int lastRow = numVertices - longDivs;
@@ -308,17 +755,14 @@ int globe( int longDivs, int latDivs, point4 points[], int start ) {
   }
   // generate vertices in remaining rows
   for (int row = 1; row < latDivs; row++) {
-    GLfloat latAngle = row * latAngleDiv;
-    GLfloat latCos = cos(latAngle);
-    GLfloat latSin = sin(latAngle);
+    GLfloat latCos = latRing.cosines[row];
+    GLfloat latSin = latRing.sines[row];
+    point4 *rowVertices = vertices + row * longDivs;
     for (int i = 0; i < longDivs; i++) {
-      GLfloat longAngle = i * longAngleDiv;
-      GLfloat longCos = cos(longAngle);
-      GLfloat longSin = sin(longAngle);
-      GLfloat x = latSin * longCos;
+      GLfloat x = latSin * longRing.cosines[i];
       GLfloat y = latCos;
-      GLfloat z = latSin * longSin;
-      vertices[row * longDivs + i] = point4( x, y, z, 1.0 );
+      GLfloat z = latSin * longRing.sines[i];
+      rowVertices[i] = point4( x, y, z, 1.0 );
     }
   }
 
@@ -340,11 +784,76 @@ int globe( int longDivs, int latDivs, point4 points[], int start ) {
     points[start++] = vertices[(row+1) * longDivs];
   }
 
-  delete [] vertices;
   return start;
 }
 
 
+/**
+ * Generates the globe above as an indexed mesh.
+ * Vertex vStart is the north pole and vStart + 1 the south pole;
+ * they are followed by latDivs - 1 rows of longDivs vertices each,
+ * from north to south.
+ *
+ * @param longDivs number of divisions around the circumferences (xz-plane).
+ *                 must be at least 3
+ * @param latDivs  number of divisions from pole to pole,
+ *                 must be at least 2
+ * @param vertices an array of at least 2 + longDivs * (latDivs - 1) points
+ *                 beginning at position vStart
+ * @param vStart   the position in vertices to begin storing vertices
+ * @param indices  an array of at least 6 * longDivs * (latDivs - 1) indices
+ *                 beginning at position iStart
+ * @param iStart   the position in indices to begin storing indices
+ * @return -1 if longDivs < 3 or latDivs < 2,
+ *         iStart + 6 * longDivs * (latDivs - 1) otherwise
+ */
+template <class Index>
+int globe( int longDivs, int latDivs, Strided<point4> vertices, int vStart,
+           Index indices[], int iStart ) {
+  if (longDivs < 3 || latDivs < 2) return -1;
+  // latitude angles are multiples of pi/latDivs, i.e. of a 2*latDivs ring
+  const RingTable longRing = ringTable( longDivs );
+  const RingTable latRing  = ringTable( 2 * latDivs );
+
+  const int northPole = vStart;
+  const int southPole = vStart + 1;
+  vertices[northPole] = point4( 0.0,  1.0, 0.0, 1.0 );
+  vertices[southPole] = point4( 0.0, -1.0, 0.0, 1.0 );
+
+  // generate vertices in the rows between the poles
+  for (int row = 1; row < latDivs; row++) {
+    GLfloat latCos = latRing.cosines[row];
+    GLfloat latSin = latRing.sines[row];
+    Strided<point4> rowVertices = vertices + vStart + 2 + (row-1) * longDivs;
+    for (int i = 0; i < longDivs; i++) {
+      GLfloat x = latSin * longRing.cosines[i];
+      GLfloat y = latCos;
+      GLfloat z = latSin * longRing.sines[i];
+      rowVertices[i] = point4( x, y, z, 1.0 );
+    }
+  }
+
+  // generate triangles in indices, with the same layout as globe() above;
+  // rows 0 and latDivs are the poles
+  for (int row = 1; row < latDivs; row++) {
+    for (int i = 0; i < longDivs; i++) {
+      int next = (i + 1) % longDivs;
+      int here = vStart + 2 + (row-1) * longDivs;
+      int above = (row == 1)           ? -1 : here - longDivs;
+      int below = (row == latDivs - 1) ? -1 : here + longDivs;
+      indices[iStart++] = here + i;
+      indices[iStart++] = (above < 0) ? northPole : above + i;
+      indices[iStart++] = here + next;
+      indices[iStart++] = here + i;
+      indices[iStart++] = here + next;
+      indices[iStart++] = (below < 0) ? southPole : below + next;
+    }
+  }
+
+  return iStart;
+}
+
+
 /*****************************************************************************
 /*
 /* Functions that general colors
@@ -383,7 +892,7 @@ color4 randomColor( color4 minColor, color4 maxColor ) {
  * Returns (start + k).
  * Requires colors to be at least start + k in size.
  */
-int randomColors( int k, color4 colors[], int start ) {
+int randomColors( int k, Strided<color4> colors, int start ) {
   for (int j = 0; j < k; j++) {
     for (int i = 0; i < 4; i++) {
       colors[start+j][i] = fRandom( 0.0, 1.0 );
@@ -406,7 +915,7 @@ int randomColors( int k, color4 colors[], int start ) {
  * returns (start + k) on successful completion
  * Requires colors to be at least start + k in size.
  */
-int randomColors( int k, color4 colors[], int start,
+int randomColors( int k, Strided<color4> colors, int start,
                   color4 minColor, color4 maxColor ) {
 
   // test for valid values of minColor and maxColor
@@ -499,7 +1008,8 @@ int randomTriangleColors( int k, color4 colors[], int start,
  * @return -1 if longDivs < 3 or latDivs < 2,
  *         start + 6 * longDivs * (latDivs - 1) otherwise
  */
-int globeColors( int longDivs, int latDivs, color4 colors[], int start ) {
+int globeColors( int longDivs, int latDivs, color4 colors[], int start,
+                 ScratchArena& arena = ScratchArena::threadLocal() ) {
   if (longDivs < 3 || latDivs < 2) return -1;
 
   const int numVertices = longDivs * (latDivs + 1);
@@ -507,7 +1017,8 @@ int globeColors( int longDivs, int latDivs, color4 colors[], int start ) {
   const color4 northPole = randomColor( );
   const color4 southPole = randomColor( );
 
-  point4 *vertexColors = new point4[numVertices];
+  ScratchScope scratch( arena );
+  color4 *vertexColors = scratch.allocate<color4>( numVertices );
 
   // put poles in first and last rows
   const int lastRow = numVertices - longDivs;
@@ -540,7 +1051,6 @@ int globeColors( int longDivs, int latDivs, color4 colors[], int start ) {
     colors[start++] = vertexColors[(row+1) * longDivs];
   }
 
-  delete [] vertexColors;
   return start;
 
 }
@@ -602,4 +1112,84 @@ int sphericalNormals( const int numPoints, const point4 points[],
 }
 
 
+/**
+ * Generate smooth normals for an indexed mesh: each vertex normal is the
+ * normalized sum of the normals of the triangles that use it, weighted by
+ * their areas.
+ * This requires numVertices vectors in the array normals, beginning at
+ * position vStart, matching the vertices beginning at vStart; the
+ * numIndices indices beginning at iStart refer to positions in the
+ * whole vertex array, as for the indexed shapes above.
+ * Returns vStart + numVertices.
+ */
+template <class Index>
+int vertexNormals( const int numVertices, const point4 vertices[], const int vStart,
+                   const int numIndices, const Index indices[], const int iStart,
+                   vec3 normals[] ) {
+  for (int i = 0; i < numVertices; i++) {
+    normals[vStart+i] = vec3( 0.0, 0.0, 0.0 );
+  }
+  for (int i = iStart; i < iStart + numIndices; i += 3) {
+    const point4 & a = vertices[indices[i]];
+    const point4 & b = vertices[indices[i+1]];
+    const point4 & c = vertices[indices[i+2]];
+    vec3 areaNormal = cross( b - a, c - b );    // length is twice the area
+    for (int j = 0; j < 3; j++) {
+      normals[indices[i+j]] += areaNormal;
+    }
+  }
+  for (int i = vStart; i < vStart + numVertices; i++) {
+    if (length( normals[i] ) > DivideByZeroTolerance) {
+      normals[i] = normalize( normals[i] );
+    }
+  }
+  return vStart + numVertices;
+}
+
+
+/*****************************************************************************
+/*
+/* Bounding volumes
+/*
+/*****************************************************************************/
+
+/**
+ * The bounds of a shape's vertices: the smallest axis-aligned box holding
+ * them, from lo to hi, and a sphere holding them, centered on the box.
+ */
+struct ShapeBounds {
+  vec3    lo, hi;
+  vec3    center;
+  GLfloat radius;
+};
+
+/**
+ * Compute the bounds of the numVertices vertices beginning at position
+ * start; vertices may be an array of point4 or a Strided array, so the
+ * bounds can be found as a shape is generated.
+ */
+template <class Points>
+ShapeBounds shapeBounds( const int numVertices, const Points& vertices,
+                         const int start ) {
+  ShapeBounds b;
+  b.radius = 0.0;
+  if (numVertices <= 0) return b;
+
+  const point4& first = vertices[start];
+  b.lo = b.hi = vec3( first.x, first.y, first.z );
+  for (int i = start + 1; i < start + numVertices; i++) {
+    const point4& p = vertices[i];
+    b.lo = vec3( std::min( b.lo.x, p.x ), std::min( b.lo.y, p.y ), std::min( b.lo.z, p.z ) );
+    b.hi = vec3( std::max( b.hi.x, p.x ), std::max( b.hi.y, p.y ), std::max( b.hi.z, p.z ) );
+  }
+  b.center = 0.5 * (b.lo + b.hi);
+  for (int i = start; i < start + numVertices; i++) {
+    const point4& p = vertices[i];
+    GLfloat r = length( vec3( p.x, p.y, p.z ) - b.center );
+    if (r > b.radius) b.radius = r;
+  }
+  return b;
+}
+
+
 #endif
@@ -0,0 +1,135 @@
+/*
+ * File: instancing.h
+ */
+
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+/**
+ * Instanced drawing of repeated objects: the model matrix of each copy is
+ * kept in an instance buffer rather than set as a uniform, and all the
+ * copies are drawn with one glDrawElementsInstanced (or
+ * glDrawArraysInstanced) call.  The vertex shader takes the matrix as a
+ * per-instance attribute:
+ *
+ *   in  mat4 instanceModel;
+ *   uniform mat4 model_view;       // the viewing part, shared by all
+ *   ...
+ *   gl_Position = projection * model_view * instanceModel * vPosition;
+ *
+ * and the program sets it up with
+ *
+ *   InstanceBuffer pyramids;
+ *   pyramids.create( program, "instanceModel", numPyramids );
+ *   pyramids.update( models, numPyramids );     // mat4 models[]
+ *   ...
+ *   pyramids.bind();
+ *   glDrawElementsInstanced( GL_TRIANGLES, numPyrIndices, GL_UNSIGNED_SHORT,
+ *                            BUFFER_OFFSET(...), pyramids.size() );
+ *
+ * bind() points the attribute at this buffer in the current vertex array
+ * object, so several instance buffers (for instance one per kind of
+ * object) can share one vertex array and one program.  An object drawn
+ * once is simply an instance buffer of size 1.
+ *
+ * A mat4 attribute takes 4 consecutive locations, one per column.  mat4
+ * is stored by rows, so update() converts each matrix to a mat4c (mat.h),
+ * stored by columns, as it copies it.
+ *
+ * Requires OpenGL 3.3 or ARB_instanced_arrays for glVertexAttribDivisor.
+ */
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include <vector>
+
+class InstanceBuffer {
+
+  GLuint            buffer;
+  GLint             location;     // of column 0 of the matrix attribute
+  int               capacity;
+  int               count;        // instances updated so far
+  GLenum            usage;
+  std::vector<mat4c> columns;     // the matrices by columns, ready to upload
+
+  InstanceBuffer( const InstanceBuffer& );           // not copyable
+  InstanceBuffer& operator = ( const InstanceBuffer& );
+
+ public:
+  InstanceBuffer()
+    : buffer( 0 ), location( -1 ), capacity( 0 ), count( 0 ),
+      usage( GL_DYNAMIC_DRAW ) {}
+
+  /**
+   * Creates the buffer, with room for capacity matrices, for the mat4
+   * attribute name of program.  Use GL_STATIC_DRAW for matrices that are
+   * set once and GL_DYNAMIC_DRAW (or GL_STREAM_DRAW) for ones that change
+   * every frame.  Needs a current GL context.
+   */
+  void create( GLuint program, const char *name, int capacity,
+               GLenum usage = GL_DYNAMIC_DRAW ) {
+    if (buffer == 0) glGenBuffers( 1, &buffer );
+    location       = glGetAttribLocation( program, name );
+    this->capacity = capacity;
+    this->usage    = usage;
+    count          = 0;
+    columns.resize( capacity );
+    glBindBuffer( GL_ARRAY_BUFFER, buffer );
+    glBufferData( GL_ARRAY_BUFFER, capacity * sizeof(mat4c), NULL, usage );
+  }
+
+  /**
+   * Copies n model matrices into the buffer, as instances first ...
+   * first + n - 1.  Replacing all the instances lets the driver give the
+   * buffer fresh storage instead of waiting for draws still using it.
+   * Returns false, copying nothing, if they do not fit.
+   */
+  bool update( const mat4 models[], int n, int first = 0 ) {
+    if (first < 0 || n < 0 || first + n > capacity) return false;
+    for (int i = 0; i < n; i++) columns[first + i] = mat4c( models[i] );
+    glBindBuffer( GL_ARRAY_BUFFER, buffer );
+    if (first == 0 && n >= count) {
+      glBufferData( GL_ARRAY_BUFFER, capacity * sizeof(mat4c), NULL, usage );
+    }
+    glBufferSubData( GL_ARRAY_BUFFER, first * sizeof(mat4c), n * sizeof(mat4c),
+                     &columns[first] );
+    if (first + n > count) count = first + n;
+    return true;
+  }
+
+  /**
+   * Points the matrix attribute at this buffer, advancing once per
+   * instance, in the current vertex array object.  Leaves the buffer
+   * bound to GL_ARRAY_BUFFER.
+   */
+  void bind() const {
+    if (location < 0) return;      // the program does not use it
+    glBindBuffer( GL_ARRAY_BUFFER, buffer );
+    for (int c = 0; c < 4; c++) {
+      glEnableVertexAttribArray( location + c );
+      glVertexAttribPointer( location + c, 4, GL_FLOAT, GL_FALSE, sizeof(mat4c),
+                             BUFFER_OFFSET(c * sizeof(vec4)) );
+      glVertexAttribDivisor( location + c, 1 );
+    }
+  }
+
+  /**
+   * Deletes the buffer; call it while the GL context still exists.
+   */
+  void release() {
+    if (buffer != 0) glDeleteBuffers( 1, &buffer );
+    buffer   = 0;
+    capacity = count = 0;
+    columns.clear();
+  }
+
+  /**
+   * Returns the number of instances set by update(), the instance count
+   * to draw.
+   */
+  int size() const { return count; }
+
+  int maxSize() const { return capacity; }
+};
+
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ * File: lod.h
+ */
+
+#ifndef LOD_H
+#define LOD_H
+
+/**
+ * Levels of detail: a shape generated at several resolutions, finest
+ * first, and a choice, every frame, of the coarsest one whose error would
+ * cover less than a pixel or so on the screen.  A distant or small
+ * object is then drawn with a fraction of the vertices.
+ *
+ * The levels are copied into the program's vertex and index arrays, as
+ * copyShape() (shapeCache.h) does, each with its geometric error: how
+ * far, in the shape's own units, it is from the true surface.  For the
+ * spheres, sphereMeshError() finds it:
+ *
+ *   LodChain globeLod;
+ *   for (int l = 0; l < numLevels; l++) {
+ *     const ShapeMesh *mesh = shapes.get( SHAPE_GLOBE, longDivs >> l, latDivs >> l );
+ *     iStart = globeLod.add( *mesh, sphereMeshError( *mesh ),
+ *                            points, vStart, indices, iStart );
+ *     vStart += mesh->numVertices;
+ *   }
+ *
+ * Each frame, an LodView made from the projection (as made by Frustum()
+ * or Perspective()), the viewport height and the eye turns an object's
+ * distance into pixels, and select() picks its level:
+ *
+ *   LodView view( p, viewportHeight, eye );
+ *   globeLevel = globeLod.select( view, model, bounds, globeLevel );
+ *   const LodLevel& level = globeLod.level( globeLevel );
+ *   glDrawElements( GL_TRIANGLES, level.numIndices, GL_UNSIGNED_SHORT,
+ *                   BUFFER_OFFSET(level.iStart * sizeof(GLushort)) );
+ *
+ * Passing the level chosen last frame back to select() keeps an object
+ * from flickering between two levels at the distance where they meet: it
+ * changes to a finer level as soon as it needs to, but back to a coarser
+ * one only once that level's error is well under the tolerance.  Give
+ * each level the colors of the finest, with copyNearestColors(), so that
+ * changing level does not change the colors either.
+ */
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/shapeCache.h"
+#include <cmath>
+#include <map>
+#include <vector>
+
+/**
+ * How far the faces of a mesh of the unit sphere centered at the origin
+ * (globe, spherichedron, icosphere) fall inside the sphere, at most.
+ */
+inline GLfloat sphereMeshError( const ShapeMesh& mesh ) {
+  GLfloat error = 0.0;
+  for (int i = 0; i + 2 < mesh.numIndices; i += 3) {
+    const point4& a = mesh.vertices[mesh.indices[i]];
+    const point4& b = mesh.vertices[mesh.indices[i+1]];
+    const point4& c = mesh.vertices[mesh.indices[i+2]];
+    vec3 n = cross( b - a, c - b );
+    if (length( n ) <= DivideByZeroTolerance) continue;
+    GLfloat d = std::fabs( dot( normalize( n ), vec3( a.x, a.y, a.z ) ) );
+    if (1.0 - d > error) error = 1.0 - d;
+  }
+  return error;
+}
+
+/**
+ * Gives each of the numVertices vertices beginning at vStart the color
+ * of the nearest of the numFrom vertices beginning at fromStart, in the
+ * same arrays.  Vertices at the same position, as those of one level of
+ * a subdivided sphere are in the next, get the same color.
+ */
+inline void copyNearestColors( Strided<point4> vertices, Strided<color4> colors,
+                               int vStart, int numVertices,
+                               int fromStart, int numFrom ) {
+  // Exact matches first, from the positions rounded to a fine grid
+  const GLfloat grid = 1.0e5;
+  std::map< std::vector<long>, int > at;
+  std::vector<long> key( 3 );
+  for (int i = fromStart; i < fromStart + numFrom; i++) {
+    for (int c = 0; c < 3; c++) key[c] = lround( vertices[i][c] * grid );
+    at[key] = i;
+  }
+  for (int i = vStart; i < vStart + numVertices; i++) {
+    for (int c = 0; c < 3; c++) key[c] = lround( vertices[i][c] * grid );
+    std::map< std::vector<long>, int >::const_iterator found = at.find( key );
+    int nearest = (found != at.end()) ? found->second : fromStart;
+    if (found == at.end()) {
+      GLfloat best = length( vertices[i] - vertices[fromStart] );
+      for (int j = fromStart + 1; j < fromStart + numFrom; j++) {
+        GLfloat d = length( vertices[i] - vertices[j] );
+        if (d < best) {
+          best    = d;
+          nearest = j;
+        }
+      }
+    }
+    colors[i] = colors[nearest];
+  }
+}
+
+/**
+ * One level: its triangles in the index array, and its error.
+ */
+struct LodLevel {
+  int     vStart, numVertices;
+  int     iStart, numIndices;
+  GLfloat error;                   // in the shape's units
+};
+
+/**
+ * What select() needs to know about the view: where the eye is, and how
+ * many pixels a length of 1 covers at a distance of 1 in front of it.
+ */
+struct LodView {
+  vec4    eye;
+  GLfloat pixelsPerUnit;
+  GLfloat tolerance;               // in pixels
+
+  /**
+   * For the projection p, as made by Frustum() or Perspective(), a
+   * viewport viewportHeight pixels high, and the eye in world
+   * coordinates; levels are allowed an error of tolerance pixels.
+   */
+  LodView( const mat4& p, int viewportHeight, const vec4& eye,
+           GLfloat tolerance = 1.0 )
+    : eye( eye ), pixelsPerUnit( 0.5 * viewportHeight * p[1][1] ),
+      tolerance( tolerance ) {}
+};
+
+class LodChain {
+
+  std::vector<LodLevel> levels;    // finest first
+
+ public:
+  /**
+   * Changing to a coarser level waits until its error is this fraction of
+   * the tolerance.
+   */
+  static GLfloat coarserFraction() { return 0.75; }
+
+  /**
+   * Adds mesh as the next coarser level, with error error, copying it into
+   * vertices beginning at vStart and indices beginning at iStart as
+   * copyShape() does.  Returns iStart + mesh.numIndices.
+   */
+  template <class Index>
+  int add( const ShapeMesh& mesh, GLfloat error, Strided<point4> vertices,
+           int vStart, Index indices[], int iStart ) {
+    LodLevel level = { vStart, mesh.numVertices, iStart, mesh.numIndices, error };
+    levels.push_back( level );
+    return copyShape( mesh, vertices, vStart, indices, iStart );
+  }
+
+  int size() const { return (int) levels.size(); }
+
+  const LodLevel& level( int l ) const { return levels[l]; }
+
+  /**
+   * The error, in pixels, level l would show drawn with model, for a
+   * shape with bounds.
+   */
+  GLfloat pixelError( int l, const LodView& view, const mat4& model,
+                      const ShapeBounds& bounds ) const {
+    GLfloat scale = maxScale( model );
+    vec4 center = model * vec4( bounds.center, 1.0 );
+    GLfloat distance = length( vec3( center.x - view.eye.x, center.y - view.eye.y,
+                                     center.z - view.eye.z ) )
+                     - bounds.radius * scale;
+    if (distance < DivideByZeroTolerance) return HUGE_VAL;   // the eye is inside it
+    return levels[l].error * scale * view.pixelsPerUnit / distance;
+  }
+
+  /**
+   * Returns the level to draw the shape with bounds placed by model: the
+   * coarsest whose error is within the tolerance, or level 0 if none is.
+   * current is the level chosen last frame, or -1.
+   */
+  int select( const LodView& view, const mat4& model, const ShapeBounds& bounds,
+              int current = -1 ) const {
+    int chosen = 0;
+    while (chosen + 1 < size() &&
+           pixelError( chosen + 1, view, model, bounds ) <= view.tolerance) {
+      chosen++;
+    }
+    if (current >= 0 && current < size() && chosen > current) {
+      // coarser than last frame: only as coarse as is well within it
+      int relaxed = current;
+      while (relaxed + 1 <= chosen &&
+             pixelError( relaxed + 1, view, model, bounds ) <=
+               coarserFraction() * view.tolerance) {
+        relaxed++;
+      }
+      chosen = relaxed;
+    }
+    return chosen;
+  }
+};
+
+
+#endif
@@ -9,6 +9,7 @@
 
 #include "vec.h"
 #include <stdio.h>
+#include <string.h>
 
 namespace Angel {
 
@@ -180,8 +181,9 @@ mat2 matrixCompMult( const mat2& A, const mat2& B ) {
 
 inline
 mat2 transpose( const mat2& A ) {
-    return mat2( A[0][0], A[1][0],
-		 A[0][1], A[1][1] );
+    // the constructor takes its values by column: row i of A is column i
+    return mat2( A[0][0], A[0][1],
+		 A[1][0], A[1][1] );
 }
 
 //----------------------------------------------------------------------------
@@ -366,9 +368,10 @@ mat3 matrixCompMult( const mat3& A, const mat3& B ) {
 
 inline
 mat3 transpose( const mat3& A ) {
-    return mat3( A[0][0], A[1][0], A[2][0],
-		 A[0][1], A[1][1], A[2][1],
-		 A[0][2], A[1][2], A[2][2] );
+    // the constructor takes its values by column: row i of A is column i
+    return mat3( A[0][0], A[0][1], A[0][2],
+		 A[1][0], A[1][1], A[1][2],
+		 A[2][0], A[2][1], A[2][2] );
 }
 
 //----------------------------------------------------------------------------
@@ -385,39 +388,32 @@ class mat4 {
     //  --- Constructors and Destructors ---
     //
 
-    mat4( const GLfloat d = GLfloat(1.0) )  // Create a diagional matrix
-	{ _m[0].x = d;  _m[1].y = d;  _m[2].z = d;  _m[3].w = d; }
+    //  All constexpr, so that constant matrices can be made when the
+    //    program is compiled (see "Compile-time matrix generators" below)
 
-    mat4( const vec4& a, const vec4& b, const vec4& c, const vec4& d )
-	{ _m[0] = a;  _m[1] = b;  _m[2] = c;  _m[3] = d; }
+    constexpr mat4( const GLfloat d = GLfloat(1.0) )  // Create a diagional matrix
+	: _m{ vec4( d, 0.0, 0.0, 0.0 ), vec4( 0.0, d, 0.0, 0.0 ),
+	      vec4( 0.0, 0.0, d, 0.0 ), vec4( 0.0, 0.0, 0.0, d ) } {}
 
-    mat4( GLfloat m00, GLfloat m10, GLfloat m20, GLfloat m30,
-	  GLfloat m01, GLfloat m11, GLfloat m21, GLfloat m31,
-	  GLfloat m02, GLfloat m12, GLfloat m22, GLfloat m32,
-	  GLfloat m03, GLfloat m13, GLfloat m23, GLfloat m33 )
-	{
-	    _m[0] = vec4( m00, m01, m02, m03 );
-	    _m[1] = vec4( m10, m11, m12, m13 );
-	    _m[2] = vec4( m20, m21, m22, m23 );
-	    _m[3] = vec4( m30, m31, m32, m33 );
-	}
+    constexpr mat4( const vec4& a, const vec4& b, const vec4& c, const vec4& d )
+	: _m{ a, b, c, d } {}
 
-    mat4( const mat4& m )
-	{
-	    if ( *this != m ) {
-		_m[0] = m._m[0];
-		_m[1] = m._m[1];
-		_m[2] = m._m[2];
-		_m[3] = m._m[3];
-	    } 
-	}
+    constexpr mat4( GLfloat m00, GLfloat m10, GLfloat m20, GLfloat m30,
+		    GLfloat m01, GLfloat m11, GLfloat m21, GLfloat m31,
+		    GLfloat m02, GLfloat m12, GLfloat m22, GLfloat m32,
+		    GLfloat m03, GLfloat m13, GLfloat m23, GLfloat m33 )
+	: _m{ vec4( m00, m01, m02, m03 ), vec4( m10, m11, m12, m13 ),
+	      vec4( m20, m21, m22, m23 ), vec4( m30, m31, m32, m33 ) } {}
+
+    constexpr mat4( const mat4& m )
+	: _m{ m._m[0], m._m[1], m._m[2], m._m[3] } {}
 
     //
     //  --- Indexing Operator ---
     //
 
     vec4& operator [] ( int i ) { return _m[i]; }
-    const vec4& operator [] ( int i ) const { return _m[i]; }
+    constexpr const vec4& operator [] ( int i ) const { return _m[i]; }
 
     //
     //  --- (non-modifying) Arithematic Operators ---
@@ -449,6 +445,10 @@ class mat4 {
 	{ return m * s; }
 	
     mat4 operator * ( const mat4& m ) const {
+#ifdef ANGEL_SIMD
+	mat4  a;
+	simd::mat4Mult( *this, m, a );
+#else
 	mat4  a( 0.0 );
 
 	for ( int i = 0; i < 4; ++i ) {
@@ -458,6 +458,7 @@ class mat4 {
 		}
 	    }
 	}
+#endif // ANGEL_SIMD
 
 	return a;
     }
@@ -482,6 +483,10 @@ class mat4 {
     }
 
     mat4& operator *= ( const mat4& m ) {
+#ifdef ANGEL_SIMD
+	simd::mat4Mult( *this, m, *this );
+	return *this;
+#else
 	mat4  a( 0.0 );
 
 	for ( int i = 0; i < 4; ++i ) {
@@ -493,6 +498,7 @@ class mat4 {
 	}
 
 	return *this = a;
+#endif // ANGEL_SIMD
     }
 
     mat4& operator /= ( const GLfloat s ) {
@@ -513,11 +519,17 @@ class mat4 {
     //
 
     vec4 operator * ( const vec4& v ) const {  // m * v
+#ifdef ANGEL_SIMD
+	vec4 u;
+	simd::mat4Vec( *this, v, u );
+	return u;
+#else
 	return vec4( _m[0][0]*v.x + _m[0][1]*v.y + _m[0][2]*v.z + _m[0][3]*v.w,
 		     _m[1][0]*v.x + _m[1][1]*v.y + _m[1][2]*v.z + _m[1][3]*v.w,
 		     _m[2][0]*v.x + _m[2][1]*v.y + _m[2][2]*v.z + _m[2][3]*v.w,
 		     _m[3][0]*v.x + _m[3][1]*v.y + _m[3][2]*v.z + _m[3][3]*v.w
 	    );
+#endif // ANGEL_SIMD
     }
 	
     //
@@ -561,12 +573,70 @@ mat4 matrixCompMult( const mat4& A, const mat4& B ) {
 
 inline
 mat4 transpose( const mat4& A ) {
-    return mat4( A[0][0], A[1][0], A[2][0], A[3][0],
-		 A[0][1], A[1][1], A[2][1], A[3][1],
-		 A[0][2], A[1][2], A[2][2], A[3][2],
-		 A[0][3], A[1][3], A[2][3], A[3][3] );
+    // the constructor takes its values by column: row i of A is column i
+    return mat4( A[0][0], A[0][1], A[0][2], A[0][3],
+		 A[1][0], A[1][1], A[1][2], A[1][3],
+		 A[2][0], A[2][1], A[2][2], A[2][3],
+		 A[3][0], A[3][1], A[3][2], A[3][3] );
+}
+
+//  The largest factor by which A scales a length: the longest of the
+//    columns of its upper 3 x 3 part
+inline
+GLfloat maxScale( const mat4& A ) {
+    GLfloat s = 0.0;
+    for ( int c = 0; c < 3; ++c ) {
+	GLfloat len2 = A[0][c]*A[0][c] + A[1][c]*A[1][c] + A[2][c]*A[2][c];
+	if ( len2 > s ) s = len2;
+    }
+    return std::sqrt( s );
 }
 
+//----------------------------------------------------------------------------
+//
+//  mat4c - a mat4 stored by columns, the layout GLSL uses for a mat4 in a
+//    std140 uniform block or glUniformMatrix4fv( ..., GL_FALSE, ... ), so
+//    it can be copied to the GPU as it is.  mat4 is stored by rows, which
+//    is why the samples pass GL_TRUE and make the driver transpose it.
+//    The rows of transpose( a ) hold the same values as a mat4c of a.
+//
+
+struct ANGEL_ALIGN16 mat4c {
+    GLfloat  m[16];    // column c is m[4*c] ... m[4*c + 3]
+
+    mat4c() {}
+
+    mat4c( const mat4& a ) {
+#ifdef ANGEL_SIMD
+	simd::f4 r0 = simd::load( &a[0].x ), r1 = simd::load( &a[1].x ),
+	         r2 = simd::load( &a[2].x ), r3 = simd::load( &a[3].x );
+	simd::transpose( r0, r1, r2, r3 );
+	simd::store( m, r0 );      simd::store( m + 4, r1 );
+	simd::store( m + 8, r2 );  simd::store( m + 12, r3 );
+#else
+	for ( int c = 0; c < 4; ++c ) {
+	    for ( int r = 0; r < 4; ++r ) m[4*c + r] = a[r][c];
+	}
+#endif
+    }
+
+    //  Back to a mat4, stored by rows
+    mat4 rows() const {
+	return mat4( vec4( m[0], m[4], m[8],  m[12] ),
+		     vec4( m[1], m[5], m[9],  m[13] ),
+		     vec4( m[2], m[6], m[10], m[14] ),
+		     vec4( m[3], m[7], m[11], m[15] ) );
+    }
+
+    bool operator == ( const mat4c& b ) const
+	{ return memcmp( m, b.m, sizeof(m) ) == 0; }
+    bool operator != ( const mat4c& b ) const
+	{ return !(*this == b); }
+
+    operator const GLfloat* () const
+	{ return m; }
+};
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  Helpful Matrix Methods
@@ -636,23 +706,22 @@ mat4 RotateZ( const GLfloat theta )
 //  Translation matrix generators
 //
 
-inline
+constexpr
 mat4 Translate( const GLfloat x, const GLfloat y, const GLfloat z )
 {
-    mat4 c;
-    c[0][3] = x;
-    c[1][3] = y;
-    c[2][3] = z;
-    return c;
+    return mat4( vec4( 1.0, 0.0, 0.0, x ),
+		 vec4( 0.0, 1.0, 0.0, y ),
+		 vec4( 0.0, 0.0, 1.0, z ),
+		 vec4( 0.0, 0.0, 0.0, 1.0 ) );
 }
 
-inline
+constexpr
 mat4 Translate( const vec3& v )
 {
     return Translate( v.x, v.y, v.z );
 }
 
-inline
+constexpr
 mat4 Translate( const vec4& v )
 {
     return Translate( v.x, v.y, v.z );
@@ -663,22 +732,186 @@ mat4 Translate( const vec4& v )
 //  Scale matrix generators
 //
 
-inline
+constexpr
 mat4 Scale( const GLfloat x, const GLfloat y, const GLfloat z )
 {
-    mat4 c;
-    c[0][0] = x;
-    c[1][1] = y;
-    c[2][2] = z;
-    return c;
+    return mat4( vec4(   x, 0.0, 0.0, 0.0 ),
+		 vec4( 0.0,   y, 0.0, 0.0 ),
+		 vec4( 0.0, 0.0,   z, 0.0 ),
+		 vec4( 0.0, 0.0, 0.0, 1.0 ) );
 }
 
-inline
+constexpr
 mat4 Scale( const vec3& v )
 {
     return Scale( v.x, v.y, v.z );
 }
 
+//----------------------------------------------------------------------------
+//
+//  Compile-time matrix generators
+//
+//    Translate() and Scale() are constexpr, and so are the rotations and
+//    the product below, so a transform that is fixed when the program is
+//    written is made by the compiler rather than when the program starts:
+//
+//	constexpr mat4 zRotateScaleAndTranslate =
+//	    ConstMult( Translate( dx, dy, dz ), Scale( sx, sy, sz ),
+//		       ConstRotateZ( 90.0 ) );
+//
+//    (dx, ..., sx, ... constexpr too).  ConstRotateZ( theta ) is the matrix
+//    RotateZ( theta ) makes, and ConstMult( a, b ) the one a * b does, to
+//    the bit, as long as the library's sin and cos are correctly rounded:
+//    the sine and cosine are found in double and rounded once to float,
+//    and the products are summed in the same order as operator *.
+//    Neither is meant for angles or matrices that change as the program
+//    runs; use RotateZ() and operator * for those.
+//
+
+//  The Taylor series of sin (term = x, k = 1) or cos (term = 1, k = 0),
+//    for x2 = x*x, |x| <= pi/4
+constexpr
+double ConstTaylor( const double x2, const double term, const int k,
+		    const double sum = 0.0 )
+{
+    return k > 28 ? sum
+		  : ConstTaylor( x2, -term * x2 / ((k + 1) * (k + 2)), k + 2,
+				 sum + term );
+}
+
+//  x - q*pi/2 for the nearest whole q, with pi/2 in three parts so that
+//    angles near multiples of it are reduced exactly (fdlibm's
+//    __rem_pio2); good for |q| < 2^20
+constexpr
+double ConstReduce( const double x, const double q )
+{
+    return ((x - q * 1.57079632673412561417e+00)
+	       - q * 6.07710050630396597660e-11)
+	       - q * 2.02226624879595063154e-21;
+}
+
+constexpr
+double ConstQuadrant( const double x )
+{
+    return double( (long) (x * 0.63661977236758134308 + (x >= 0.0 ? 0.5 : -0.5)) );
+}
+
+//  sin( r + q*pi/2 ), from the reduced angle r and the quadrant q % 4
+constexpr
+double ConstSinReduced( const double r, const int q )
+{
+    return q == 0 ?  ConstTaylor( r*r, r, 1 )
+	 : q == 1 ?  ConstTaylor( r*r, 1.0, 0 )
+	 : q == 2 ? -ConstTaylor( r*r, r, 1 )
+		  : -ConstTaylor( r*r, 1.0, 0 );
+}
+
+constexpr
+double ConstSin( const double x )
+{
+    return ConstSinReduced( ConstReduce( x, ConstQuadrant( x ) ),
+			    (((long) ConstQuadrant( x )) % 4 + 4) % 4 );
+}
+
+constexpr
+double ConstCos( const double x )
+{
+    return ConstSinReduced( ConstReduce( x, ConstQuadrant( x ) ),
+			    (((long) ConstQuadrant( x )) % 4 + 5) % 4 );
+}
+
+//  The rotations, for the angle in radians, as a GLfloat, as RotateX(),
+//    RotateY() and RotateZ() compute it
+constexpr
+mat4 ConstRotateXRadians( const GLfloat angle )
+{
+    return mat4( vec4( 1.0, 0.0, 0.0, 0.0 ),
+		 vec4( 0.0,  GLfloat( ConstCos( angle ) ),
+		            -GLfloat( ConstSin( angle ) ), 0.0 ),
+		 vec4( 0.0,  GLfloat( ConstSin( angle ) ),
+		             GLfloat( ConstCos( angle ) ), 0.0 ),
+		 vec4( 0.0, 0.0, 0.0, 1.0 ) );
+}
+
+constexpr
+mat4 ConstRotateYRadians( const GLfloat angle )
+{
+    return mat4( vec4(  GLfloat( ConstCos( angle ) ), 0.0,
+		        GLfloat( ConstSin( angle ) ), 0.0 ),
+		 vec4( 0.0, 1.0, 0.0, 0.0 ),
+		 vec4( -GLfloat( ConstSin( angle ) ), 0.0,
+		        GLfloat( ConstCos( angle ) ), 0.0 ),
+		 vec4( 0.0, 0.0, 0.0, 1.0 ) );
+}
+
+constexpr
+mat4 ConstRotateZRadians( const GLfloat angle )
+{
+    return mat4( vec4(  GLfloat( ConstCos( angle ) ),
+		       -GLfloat( ConstSin( angle ) ), 0.0, 0.0 ),
+		 vec4(  GLfloat( ConstSin( angle ) ),
+		        GLfloat( ConstCos( angle ) ), 0.0, 0.0 ),
+		 vec4( 0.0, 0.0, 1.0, 0.0 ),
+		 vec4( 0.0, 0.0, 0.0, 1.0 ) );
+}
+
+//  RotateX(), RotateY() and RotateZ() for a constant theta, in degrees
+constexpr
+mat4 ConstRotateX( const GLfloat theta )
+{
+    return ConstRotateXRadians( GLfloat( M_PI / 180.0 ) * theta );
+}
+
+constexpr
+mat4 ConstRotateY( const GLfloat theta )
+{
+    return ConstRotateYRadians( GLfloat( M_PI / 180.0 ) * theta );
+}
+
+constexpr
+mat4 ConstRotateZ( const GLfloat theta )
+{
+    return ConstRotateZRadians( GLfloat( M_PI / 180.0 ) * theta );
+}
+
+//  Element [i][j] of a * b, and its row i, summed as operator * does
+constexpr
+GLfloat ConstComponent( const vec4& v, const int j )
+{
+    return j == 0 ? v.x : j == 1 ? v.y : j == 2 ? v.z : v.w;
+}
+
+constexpr
+GLfloat ConstMultElement( const mat4& a, const mat4& b, const int i, const int j )
+{
+    return GLfloat( 0.0 ) + a[i].x * ConstComponent( b[0], j )
+			  + a[i].y * ConstComponent( b[1], j )
+			  + a[i].z * ConstComponent( b[2], j )
+			  + a[i].w * ConstComponent( b[3], j );
+}
+
+constexpr
+vec4 ConstMultRow( const mat4& a, const mat4& b, const int i )
+{
+    return vec4( ConstMultElement( a, b, i, 0 ), ConstMultElement( a, b, i, 1 ),
+		 ConstMultElement( a, b, i, 2 ), ConstMultElement( a, b, i, 3 ) );
+}
+
+//  a * b
+constexpr
+mat4 ConstMult( const mat4& a, const mat4& b )
+{
+    return mat4( ConstMultRow( a, b, 0 ), ConstMultRow( a, b, 1 ),
+		 ConstMultRow( a, b, 2 ), ConstMultRow( a, b, 3 ) );
+}
+
+//  a * b * c, multiplied left to right like the expression
+constexpr
+mat4 ConstMult( const mat4& a, const mat4& b, const mat4& c )
+{
+    return ConstMult( ConstMult( a, b ), c );
+}
+
 //----------------------------------------------------------------------------
 //
 //  Projection transformation matrix geneartors
@@ -799,6 +1032,107 @@ mat3 Normal( const mat4& c)
   return d;
 }
 
+//----------------------------------------------------------------------------
+//
+//  Batched transformation of vertex arrays
+//
+//    Each function transforms n elements of in into out; in and out may be
+//    the same array.  See parallel.h for versions that split large arrays
+//    across threads.
+//
+
+//  out[i] = m * in[i]
+inline
+void transformPoints( const mat4& m, const vec4* in, vec4* out, size_t n )
+{
+#ifdef ANGEL_SIMD
+    simd::mat4VecArray( m, &in[0].x, &out[0].x, n );
+#else
+    for ( size_t i = 0; i < n; ++i ) {
+	out[i] = m * in[i];
+    }
+#endif // ANGEL_SIMD
+}
+
+//  out[i] = m * vec4( in[i].x, in[i].y, in[i].z, 0.0 );  the translation
+//    part of m is ignored and the w of each result is 0 for affine m.
+inline
+void transformDirections( const mat4& m, const vec4* in, vec4* out, size_t n )
+{
+#ifdef ANGEL_SIMD
+    simd::mat4DirArray( m, &in[0].x, &out[0].x, n );
+#else
+    for ( size_t i = 0; i < n; ++i ) {
+	out[i] = m * vec4( in[i].x, in[i].y, in[i].z, 0.0 );
+    }
+#endif // ANGEL_SIMD
+}
+
+//  out[i] = normalize( Normal(m) * in[i] ), i.e. the normals are transformed
+//    by the inverse transpose of the upper 3 x 3 part of m, then rescaled
+//    to unit length.
+inline
+void transformNormals( const mat4& m, const vec3* in, vec3* out, size_t n )
+{
+    const mat3 nm = Normal( m );
+    for ( size_t i = 0; i < n; ++i ) {
+	out[i] = normalize( nm * in[i] );
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//  ViewFrustum - the six planes bounding the view volume of a matrix m,
+//    usually projection * view, taken from its rows (Gribb and Hartmann).
+//    The planes are in the space m is applied to, world space for
+//    projection * view, and normalized, so for a point p
+//    dot( plane, p ) is its distance from the plane, positive inside.
+//    (Frustum() above makes the projection matrix itself.)
+//
+
+struct ANGEL_ALIGN16 ViewFrustum {
+    vec4  planes[6];    // left, right, bottom, top, near, far
+
+    ViewFrustum() {}
+
+    explicit ViewFrustum( const mat4& m ) {
+	planes[0] = m[3] + m[0];  planes[1] = m[3] - m[0];
+	planes[2] = m[3] + m[1];  planes[3] = m[3] - m[1];
+	planes[4] = m[3] + m[2];  planes[5] = m[3] - m[2];
+	for ( int p = 0; p < 6; ++p ) {
+	    vec4& q = planes[p];
+	    GLfloat len = std::sqrt( q.x*q.x + q.y*q.y + q.z*q.z );
+	    if ( len > DivideByZeroTolerance ) q /= len;
+	}
+    }
+
+    //  False if the sphere lies wholly outside one of the planes.  A
+    //    sphere just beyond a corner of the volume is not caught, which
+    //    only means it is drawn when it need not be.
+    bool containsSphere( const vec4& center, GLfloat radius ) const {
+	for ( int p = 0; p < 6; ++p ) {
+	    const vec4& q = planes[p];
+	    GLfloat d = q.x*center.x + q.y*center.y + q.z*center.z + q.w;
+	    if ( d < -radius ) return false;
+	}
+	return true;
+    }
+
+    //  False if the axis-aligned box from lo to hi lies wholly outside one
+    //    of the planes, i.e. its corner furthest along the plane's normal
+    //    is outside.
+    bool containsBox( const vec3& lo, const vec3& hi ) const {
+	for ( int p = 0; p < 6; ++p ) {
+	    const vec4& q = planes[p];
+	    GLfloat d = q.x * (q.x >= 0.0 ? hi.x : lo.x) +
+			q.y * (q.y >= 0.0 ? hi.y : lo.y) +
+			q.z * (q.z >= 0.0 ? hi.z : lo.z) + q.w;
+	    if ( d < 0.0 ) return false;
+	}
+	return true;
+    }
+};
+
 //----------------------------------------------------------------------------
 
 inline
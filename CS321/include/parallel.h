@@ -0,0 +1,245 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- parallel.h ---
+//
+//   Helpers for splitting large, independent array loops across threads.
+//   Requires C++11 <thread>; link with -pthread.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ANGEL_PARALLEL_H__
+#define __ANGEL_PARALLEL_H__
+
+#include "Angel.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Angel {
+
+//  Arrays shorter than this are transformed on the calling thread; the cost
+//    of starting threads outweighs the work below roughly this size.
+const size_t ParallelMinElements = 1 << 16;
+
+//----------------------------------------------------------------------------
+//
+//  Returns the number of threads to use for n elements when the caller asks
+//    for numThreads; 0 means use every hardware thread.
+//
+
+inline
+unsigned int threadsFor( size_t n, unsigned int numThreads )
+{
+    if ( numThreads == 0 ) {
+	numThreads = std::thread::hardware_concurrency();
+	if ( numThreads == 0 ) numThreads = 1;
+    }
+    size_t maxUseful = n / (ParallelMinElements / 4) + 1;
+    if ( numThreads > maxUseful ) numThreads = (unsigned int) maxUseful;
+    return numThreads;
+}
+
+//----------------------------------------------------------------------------
+//
+//  Calls f( begin, end ) on numThreads contiguous, disjoint ranges that
+//    cover [0, n).  The calling thread handles the first range.  Ranges are
+//    rounded to multiples of 4 elements so that neighbouring threads never
+//    write to the same cache line of a 16-byte vertex array.
+//
+
+template <class Func>
+void parallelFor( size_t n, unsigned int numThreads, Func f )
+{
+    numThreads = threadsFor( n, numThreads );
+    if ( numThreads <= 1 ) {
+	f( size_t(0), n );
+	return;
+    }
+
+    size_t chunk = (n + numThreads - 1) / numThreads;
+    chunk = (chunk + 3) & ~size_t(3);
+
+    std::vector<std::thread> workers;
+    for ( size_t begin = chunk; begin < n; begin += chunk ) {
+	size_t end = begin + chunk < n ? begin + chunk : n;
+	workers.push_back( std::thread( f, begin, end ) );
+    }
+    f( size_t(0), chunk < n ? chunk : n );
+
+    for ( size_t i = 0; i < workers.size(); ++i ) {
+	workers[i].join();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//  ThreadPool - a fixed set of worker threads that share the items of one
+//    job at a time.  run( n, f ) calls f( i ) for every i in [0, n), on the
+//    workers and on the calling thread, and returns when all calls are done.
+//    Items are handed out one at a time, so items of different cost still
+//    balance.  Calls to run() are serialized; f must not call run() itself.
+//
+
+class ThreadPool {
+
+    std::vector<std::thread>      workers;
+    std::mutex                    runLock;    // one job at a time
+    std::mutex                    lock;       // guards the fields below
+    std::condition_variable       wake;
+    std::condition_variable       finished;
+    std::function<void(size_t)>   job;
+    size_t                        jobSize;
+    std::atomic<size_t>           next;
+    unsigned int                  busy;       // workers still in the job
+    unsigned long                 generation; // incremented for each job
+    bool                          stopping;
+
+    void work( size_t n ) {
+	size_t i;
+	while ( (i = next.fetch_add( 1 )) < n ) {
+	    job( i );
+	}
+    }
+
+    void workerLoop() {
+	unsigned long seen = 0;
+	std::unique_lock<std::mutex> guard( lock );
+	for (;;) {
+	    while ( !stopping && generation == seen ) wake.wait( guard );
+	    if ( stopping ) return;
+	    seen = generation;
+	    size_t n = jobSize;
+	    guard.unlock();
+	    work( n );
+	    guard.lock();
+	    if ( --busy == 0 ) finished.notify_all();
+	}
+    }
+
+    ThreadPool( const ThreadPool& );             // not copyable
+    ThreadPool& operator = ( const ThreadPool& );
+
+   public:
+    //  Creates numThreads - 1 workers, since the calling thread also works;
+    //    0 means use every hardware thread.
+    explicit ThreadPool( unsigned int numThreads = 0 )
+	: jobSize(0), next(0), busy(0), generation(0), stopping(false)
+    {
+	if ( numThreads == 0 ) numThreads = std::thread::hardware_concurrency();
+	for ( unsigned int i = 1; i < numThreads; ++i ) {
+	    workers.push_back( std::thread( &ThreadPool::workerLoop, this ) );
+	}
+    }
+
+    ~ThreadPool() {
+	{
+	    std::lock_guard<std::mutex> guard( lock );
+	    stopping = true;
+	}
+	wake.notify_all();
+	for ( size_t i = 0; i < workers.size(); ++i ) {
+	    workers[i].join();
+	}
+    }
+
+    //  Number of threads that work on a job, including the caller
+    unsigned int size() const { return (unsigned int) workers.size() + 1; }
+
+    template <class Func>
+    void run( size_t n, Func f ) {
+	if ( workers.empty() || n <= 1 ) {
+	    for ( size_t i = 0; i < n; ++i ) f( i );
+	    return;
+	}
+
+	std::lock_guard<std::mutex> serial( runLock );
+	std::unique_lock<std::mutex> guard( lock );
+	job     = f;
+	jobSize = n;
+	next    = 0;
+	busy    = (unsigned int) workers.size();
+	++generation;
+	guard.unlock();
+	wake.notify_all();
+
+	work( n );
+
+	guard.lock();
+	while ( busy > 0 ) finished.wait( guard );
+	job = std::function<void(size_t)>();
+    }
+
+    //  A pool with every hardware thread, created on first use
+    static ThreadPool& shared() {
+	static ThreadPool pool;
+	return pool;
+    }
+};
+
+//----------------------------------------------------------------------------
+//
+//  Threaded versions of the batched transforms in mat.h.  Arrays with
+//    fewer than ParallelMinElements elements are done on the calling thread.
+//    numThreads = 0 uses every hardware thread.
+//
+
+struct TransformPointsJob {
+    const mat4* m;  const vec4* in;  vec4* out;
+    void operator () ( size_t begin, size_t end ) const
+	{ transformPoints( *m, in + begin, out + begin, end - begin ); }
+};
+
+struct TransformDirectionsJob {
+    const mat4* m;  const vec4* in;  vec4* out;
+    void operator () ( size_t begin, size_t end ) const
+	{ transformDirections( *m, in + begin, out + begin, end - begin ); }
+};
+
+struct TransformNormalsJob {
+    const mat4* m;  const vec3* in;  vec3* out;
+    void operator () ( size_t begin, size_t end ) const
+	{ transformNormals( *m, in + begin, out + begin, end - begin ); }
+};
+
+inline
+void transformPoints( const mat4& m, const vec4* in, vec4* out, size_t n,
+		      unsigned int numThreads )
+{
+    if ( n < ParallelMinElements ) {
+	transformPoints( m, in, out, n );
+	return;
+    }
+    TransformPointsJob job = { &m, in, out };
+    parallelFor( n, numThreads, job );
+}
+
+inline
+void transformDirections( const mat4& m, const vec4* in, vec4* out, size_t n,
+			  unsigned int numThreads )
+{
+    if ( n < ParallelMinElements ) {
+	transformDirections( m, in, out, n );
+	return;
+    }
+    TransformDirectionsJob job = { &m, in, out };
+    parallelFor( n, numThreads, job );
+}
+
+inline
+void transformNormals( const mat4& m, const vec3* in, vec3* out, size_t n,
+		       unsigned int numThreads )
+{
+    if ( n < ParallelMinElements ) {
+	transformNormals( m, in, out, n );
+	return;
+    }
+    TransformNormalsJob job = { &m, in, out };
+    parallelFor( n, numThreads, job );
+}
+
+}  // namespace Angel
+
+#endif // __ANGEL_PARALLEL_H__
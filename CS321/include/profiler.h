@@ -0,0 +1,348 @@
+/*
+ * File: profiler.h
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/**
+ * Frame-time profiling: the CPU time of each phase of a frame (building
+ * matrices, uploading uniforms, submitting draws, swapping, ...) and the
+ * GPU time of the whole frame, kept for the last frames so that their
+ * mean and percentiles can be shown while the program runs and written
+ * to a CSV or JSON file.
+ *
+ * A program names its phases and marks where each one starts; a phase
+ * lasts until the next one starts or the frame ends:
+ *
+ *   enum { PHASE_MATRICES, PHASE_UPLOAD, PHASE_DRAW, PHASE_SWAP };
+ *   const char *phaseNames[] = { "matrices", "upload", "draw", "swap" };
+ *   FrameProfiler profiler( 4, phaseNames );
+ *
+ *   void display() {
+ *       profiler.beginFrame();
+ *       profiler.phase( PHASE_MATRICES );
+ *       ...
+ *       profiler.phase( PHASE_SWAP );
+ *       glutSwapBuffers();
+ *       profiler.endFrame();
+ *   }
+ *
+ * The GPU time comes from GL_TIME_ELAPSED queries (OpenGL 3.3 or
+ * ARB_timer_query), after enableGpuTimer() is called with a context.
+ * Queries are read a few frames late, when the GPU has finished them,
+ * so timing never stalls the pipeline; frames whose query is not ready
+ * have no GPU time.
+ *
+ * Statistics are over the last window frames (default 240, 4 seconds at
+ * 60 Hz).  Times are in milliseconds.
+ */
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/textOverlay.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+class FrameProfiler {
+
+  typedef std::chrono::steady_clock Clock;
+
+  enum { NUM_QUERIES = 4 };        // frames a GPU time may be late
+
+  std::vector<std::string> names;  // the phases, then "cpu" and "gpu"
+  int                      numPhases;
+  int                      window;
+  long                     frames;          // frames ended so far
+  std::vector<float>       samples;         // window rows of names.size()
+  Clock::time_point        frameStart, phaseStart;
+  int                      currentPhase;    // -1 outside a phase
+
+  bool                     gpuTimer;
+  GLuint                   queries[NUM_QUERIES];
+  long                     queryFrame[NUM_QUERIES];   // -1 if none pending
+
+  std::string              outputPath;
+  TextOverlay              overlay;
+  bool                     overlayCreated;
+  bool                     overlayShown;
+
+  FrameProfiler( const FrameProfiler& );           // not copyable
+  FrameProfiler& operator = ( const FrameProfiler& );
+
+  static double msBetween( Clock::time_point start, Clock::time_point end ) {
+    return std::chrono::duration<double, std::milli>( end - start ).count();
+  }
+
+  float *row( long frame ) { return &samples[(frame % window) * names.size()]; }
+  const float *row( long frame ) const {
+    return &samples[(frame % window) * names.size()];
+  }
+
+  void endPhase( Clock::time_point now ) {
+    if (currentPhase >= 0) {
+      row( frames )[currentPhase] += msBetween( phaseStart, now );
+    }
+  }
+
+  //  Collects the GPU times that are ready
+  void readQueries() {
+    for (int q = 0; q < NUM_QUERIES; q++) {
+      if (queryFrame[q] < 0) continue;
+      GLint available = 0;
+      glGetQueryObjectiv( queries[q], GL_QUERY_RESULT_AVAILABLE, &available );
+      if (!available) continue;
+      GLuint64 ns = 0;
+      glGetQueryObjectui64v( queries[q], GL_QUERY_RESULT, &ns );
+      if (frames - queryFrame[q] < window) row( queryFrame[q] )[numPhases + 1] = ns * 1.0e-6;
+      queryFrame[q] = -1;
+    }
+  }
+
+  //  The first frame in the window
+  long firstFrame() const { return (frames > window) ? frames - window : 0; }
+
+  static void writeAtExit() {
+    if (!writing().empty()) active()->write( writing().c_str() );
+  }
+  static FrameProfiler *&active() { static FrameProfiler *p = NULL; return p; }
+  static std::string& writing() { static std::string path; return path; }
+
+ public:
+  /**
+   * Statistics of one column (a phase, "cpu" or "gpu") over the window.
+   */
+  struct Stats {
+    int    count;                  // frames with a time
+    double mean, p50, p90, p99, max;
+  };
+
+  /**
+   * Creates a profiler for numPhases phases with the given names,
+   * keeping the last window frames.
+   */
+  FrameProfiler( int numPhases, const char *const phaseNames[], int window = 240 )
+    : numPhases( numPhases ), window( window ), frames( 0 ), currentPhase( -1 ),
+      gpuTimer( false ), overlayCreated( false ), overlayShown( false ) {
+    for (int i = 0; i < numPhases; i++) names.push_back( phaseNames[i] );
+    names.push_back( "cpu" );
+    names.push_back( "gpu" );
+    samples.assign( window * names.size(), -1.0f );
+    for (int q = 0; q < NUM_QUERIES; q++) queryFrame[q] = -1;
+  }
+
+  /**
+   * Looks for --profile file and --overlay in argv, removing them.  With
+   * --profile the statistics are written to file (JSON if it ends in
+   * .json, otherwise CSV) when the program exits; --overlay starts with
+   * the overlay shown.  Returns true if --profile was found.
+   */
+  bool parseArgs( int& argc, char **argv ) {
+    bool found = false;
+    int  kept = 1;
+    for (int i = 1; i < argc; i++) {
+      if (strcmp( argv[i], "--profile" ) == 0 && i + 1 < argc) {
+        outputPath = argv[++i];
+        found = true;
+      } else if (strcmp( argv[i], "--overlay" ) == 0) {
+        overlayShown = true;
+      } else {
+        argv[kept++] = argv[i];
+      }
+    }
+    argc = kept;
+    argv[argc] = NULL;
+    if (found) {
+      active()  = this;
+      writing() = outputPath;
+      atexit( writeAtExit );
+    }
+    return found;
+  }
+
+  /**
+   * Turns on GPU timing if the context supports GL_TIME_ELAPSED queries;
+   * needs a current context.  Returns whether it did.
+   */
+  bool enableGpuTimer() {
+    GLint major = 0, minor = 0;
+    glGetIntegerv( GL_MAJOR_VERSION, &major );
+    glGetIntegerv( GL_MINOR_VERSION, &minor );
+    bool supported = major > 3 || (major == 3 && minor >= 3);
+    for (GLint i = 0, n = 0; !supported && (i == 0 || i < n); i++) {
+      glGetIntegerv( GL_NUM_EXTENSIONS, &n );
+      const GLubyte *extension = glGetStringi( GL_EXTENSIONS, i );
+      if (extension != NULL && strcmp( (const char *) extension, "GL_ARB_timer_query" ) == 0) {
+        supported = true;
+      }
+    }
+    if (supported && !gpuTimer) glGenQueries( NUM_QUERIES, queries );
+    gpuTimer = supported;
+    return gpuTimer;
+  }
+
+  bool gpuTimerEnabled() const { return gpuTimer; }
+
+  /**
+   * Starts timing a frame.
+   */
+  void beginFrame() {
+    float *r = row( frames );
+    for (size_t i = 0; i < names.size(); i++) r[i] = (i < (size_t) numPhases) ? 0.0f : -1.0f;
+    currentPhase = -1;
+    // the first frame is not timed on the GPU: it includes the driver's
+    // setup, and some drivers report nonsense for the first query
+    if (gpuTimer && frames > 0) {
+      int q = frames % NUM_QUERIES;
+      if (queryFrame[q] >= 0) readQueries();
+      if (queryFrame[q] >= 0) queryFrame[q] = -1;    // still not ready: drop it
+      glBeginQuery( GL_TIME_ELAPSED, queries[q] );
+      queryFrame[q] = frames;
+    }
+    frameStart = phaseStart = Clock::now();
+  }
+
+  /**
+   * Ends the current phase, if any, and starts phase p; a phase may be
+   * entered more than once in a frame.
+   */
+  void phase( int p ) {
+    Clock::time_point now = Clock::now();
+    endPhase( now );
+    currentPhase = p;
+    phaseStart   = now;
+  }
+
+  /**
+   * Ends the current phase and the frame.
+   */
+  void endFrame() {
+    Clock::time_point now = Clock::now();
+    endPhase( now );
+    currentPhase = -1;
+    row( frames )[numPhases] = msBetween( frameStart, now );
+    if (gpuTimer && frames > 0) {
+      glEndQuery( GL_TIME_ELAPSED );
+      readQueries();
+    }
+    frames++;
+  }
+
+  /**
+   * Returns the number of frames ended so far.
+   */
+  long numFrames() const { return frames; }
+
+  /**
+   * Returns the statistics of column c: phases 0 ... numPhases - 1, then
+   * numPhases for the frame's CPU time and numPhases + 1 for its GPU time.
+   */
+  Stats stats( int c ) const {
+    std::vector<float> values;
+    for (long f = firstFrame(); f < frames; f++) {
+      float v = row( f )[c];
+      if (v >= 0.0f) values.push_back( v );
+    }
+    Stats s = { (int) values.size(), 0.0, 0.0, 0.0, 0.0, 0.0 };
+    if (values.empty()) return s;
+    std::sort( values.begin(), values.end() );
+    double sum = 0.0;
+    for (size_t i = 0; i < values.size(); i++) sum += values[i];
+    s.mean = sum / values.size();
+    s.p50  = values[(values.size() - 1) * 50 / 100];
+    s.p90  = values[(values.size() - 1) * 90 / 100];
+    s.p99  = values[(values.size() - 1) * 99 / 100];
+    s.max  = values.back();
+    return s;
+  }
+
+  /**
+   * Writes the frames in the window to path as CSV, one row per frame
+   * with a column per phase, the CPU total and the GPU time (empty when
+   * unknown).  Returns false if the file cannot be written.
+   */
+  bool writeCSV( const char *path ) {
+    if (gpuTimer) readQueries();
+    FILE *file = fopen( path, "w" );
+    if (file == NULL) return false;
+    fprintf( file, "frame" );
+    for (size_t i = 0; i < names.size(); i++) fprintf( file, ",%s_ms", names[i].c_str() );
+    fprintf( file, "\n" );
+    for (long f = firstFrame(); f < frames; f++) {
+      fprintf( file, "%ld", f );
+      for (size_t i = 0; i < names.size(); i++) {
+        float v = row( f )[i];
+        if (v >= 0.0f) fprintf( file, ",%.4f", v ); else fprintf( file, "," );
+      }
+      fprintf( file, "\n" );
+    }
+    return fclose( file ) == 0;
+  }
+
+  /**
+   * Writes the statistics of every column to path as JSON.  Returns
+   * false if the file cannot be written.
+   */
+  bool writeJSON( const char *path ) {
+    if (gpuTimer) readQueries();
+    FILE *file = fopen( path, "w" );
+    if (file == NULL) return false;
+    fprintf( file, "{\n  \"frames\": %ld,\n  \"window\": %ld,\n  \"gpuTimer\": %s,\n"
+                   "  \"phases\": {\n",
+             frames, frames - firstFrame(), gpuTimer ? "true" : "false" );
+    for (size_t i = 0; i < names.size(); i++) {
+      Stats s = stats( i );
+      fprintf( file, "    \"%s\": { \"count\": %d, \"mean\": %.4f, \"p50\": %.4f, "
+                     "\"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+               names[i].c_str(), s.count, s.mean, s.p50, s.p90, s.p99, s.max,
+               (i + 1 < names.size()) ? "," : "" );
+    }
+    fprintf( file, "  }\n}\n" );
+    return fclose( file ) == 0;
+  }
+
+  /**
+   * Writes to path as JSON if it ends in .json, otherwise as CSV.
+   */
+  bool write( const char *path ) {
+    size_t n = strlen( path );
+    if (n >= 5 && strcmp( path + n - 5, ".json" ) == 0) return writeJSON( path );
+    return writeCSV( path );
+  }
+
+  /**
+   * Shows or hides the overlay drawn by drawOverlay().
+   */
+  void toggleOverlay() { overlayShown = !overlayShown; }
+
+  /**
+   * Draws the statistics over the frame, at the top left of the
+   * viewport, if the overlay is shown; call it before the swap.  Needs a
+   * current context.
+   */
+  void drawOverlay( const color4& color = color4( 0.0, 0.0, 0.0, 1.0 ) ) {
+    if (!overlayShown) return;
+    if (!overlayCreated) {
+      overlay.create();
+      overlayCreated = true;
+    }
+    overlay.clear();
+    char line[128];
+    int y = overlay.print( 8, 8, "ms          mean     p50     p99" );
+    for (size_t i = 0; i < names.size(); i++) {
+      Stats s = stats( i );
+      if (s.count == 0) continue;
+      snprintf( line, sizeof(line), "%-8.8s %7.3f %7.3f %7.3f",
+                names[i].c_str(), s.mean, s.p50, s.p99 );
+      y = overlay.print( 8, y, line );
+    }
+    overlay.draw( color );
+  }
+};
+
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * File: sceneGraph.h
+ */
+
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+/**
+ * A transform hierarchy: each node has a local transform, relative to its
+ * parent, and a world (model) matrix, the product of the local transforms
+ * from the root down to it.  Instead of multiplying out
+ *
+ *   obliqueRotate * revolutionRotate * xRotation * zRotateScaleAndTranslate
+ *
+ * by hand every frame, a program builds the chain once as nodes
+ *
+ *   SceneGraph scene;
+ *   int oblique = scene.add( obliqueRotate );
+ *   int revolve = scene.add( mat4(), oblique );
+ *   int spin    = scene.add( mat4(), revolve );
+ *   int globe   = scene.add( zRotateScaleAndTranslate, spin );
+ *
+ * and then only changes what moves:
+ *
+ *   scene.setLocal( revolve, RotateZ( revolveAngle ) );
+ *   scene.setLocal( spin, RotateX( xRotationAngle ) );
+ *   scene.update();
+ *   ... scene.world( globe ) ...
+ *
+ * update() recomputes the world matrices of the changed nodes and their
+ * descendants only; the constant part above a changed node (here
+ * obliqueRotate) is not multiplied again.
+ *
+ * The nodes are kept in flat arrays, in the order they were added, and a
+ * node's parent must be added before it, so the arrays are always sorted
+ * parents first and update() is one pass straight through them.  Nodes
+ * added one after another have their world matrices next to each other,
+ * ready to be copied into an instance buffer (see instancing.h) in one
+ * call.
+ */
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include <vector>
+
+class SceneGraph {
+
+  std::vector<mat4>          locals;
+  std::vector<mat4>          worlds;
+  std::vector<int>           parents;   // NO_PARENT for a root
+  std::vector<unsigned char> dirty;     // local set since the last update
+  std::vector<unsigned char> moved;     // world recomputed by the last update
+  int                        recomputed;
+
+ public:
+  enum { NO_PARENT = -1 };
+
+  SceneGraph() : recomputed( 0 ) {}
+
+  /**
+   * Adds a node with transform local relative to parent (an earlier
+   * node, or NO_PARENT for a root) and returns its index.  The new node's
+   * world matrix is set by the next update().
+   */
+  int add( const mat4& local = mat4(), int parent = NO_PARENT ) {
+    if (parent >= (int) size()) {
+      std::cerr << "SceneGraph: a parent must be added before its children" << std::endl;
+      parent = NO_PARENT;
+    }
+    locals.push_back( local );
+    worlds.push_back( local );
+    parents.push_back( parent );
+    dirty.push_back( 1 );
+    moved.push_back( 0 );
+    return (int) size() - 1;
+  }
+
+  /**
+   * Reserves room for n nodes in all, so that adding them does not move
+   * the arrays.
+   */
+  void reserve( int n ) {
+    locals.reserve( n );  worlds.reserve( n );  parents.reserve( n );
+    dirty.reserve( n );  moved.reserve( n );
+  }
+
+  /**
+   * Changes the local transform of node; nodes with different indices
+   * may be set from different threads at once.
+   */
+  void setLocal( int node, const mat4& local ) {
+    locals[node] = local;
+    dirty[node]  = 1;
+  }
+
+  /**
+   * Recomputes the world matrix of every node whose local transform, or
+   * that of an ancestor, was set since the last update, and returns how
+   * many were recomputed.
+   */
+  int update() {
+    recomputed = 0;
+    int n = (int) size();
+    for (int i = 0; i < n; i++) {
+      int p = parents[i];
+      bool changed = dirty[i] || (p != NO_PARENT && moved[p]);
+      if (changed) {
+        worlds[i] = (p == NO_PARENT) ? locals[i] : worlds[p] * locals[i];
+        recomputed++;
+      }
+      moved[i] = changed;
+      dirty[i] = 0;
+    }
+    return recomputed;
+  }
+
+  size_t size() const { return locals.size(); }
+
+  const mat4& local( int node ) const { return locals[node]; }
+  int parent( int node ) const { return parents[node]; }
+
+  /**
+   * The world matrix of node as of the last update(); nodes added one
+   * after another are consecutive, so &world( first ) is an array of
+   * them.
+   */
+  const mat4& world( int node ) const { return worlds[node]; }
+
+  /**
+   * Returns the number of world matrices the last update() recomputed.
+   */
+  int numRecomputed() const { return recomputed; }
+};
+
+
+#endif
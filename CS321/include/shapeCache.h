@@ -0,0 +1,476 @@
+/*
+ * File: shapeCache.h
+ */
+
+#ifndef SHAPE_CACHE_H
+#define SHAPE_CACHE_H
+
+/**
+ * A process-wide cache of the indexed shapes generated by holeyShapes.h.
+ * A shape is generated the first time it is asked for with a given set of
+ * parameters; later requests return the same vertices, normals and
+ * indices, which are never changed or freed while the cache exists.
+ *
+ * The cache can be saved to a binary file and loaded from it again, so a
+ * program that needs finely divided shapes does not have to generate them
+ * every time it starts.  A loaded file is memory-mapped and its shapes are
+ * used in place, without copying.  The file is in the byte order of the
+ * machine that wrote it; a file that does not match is ignored.
+ *
+ * Shapes in the cache have GLuint indices that start at 0;
+ * copyShape() places a shape into a program's own vertex and index arrays,
+ * exactly as the indexed generators in holeyShapes.h do.
+ *
+ * Requires C++11 <mutex>.
+ */
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include "/usr/people/classes/CS321/include/holeyShapes.h"
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * The shapes that can be cached, and the meaning of their parameters
+ * a and b.
+ */
+enum ShapeKind {
+  SHAPE_CUBE          = 1,  // no parameters
+  SHAPE_PYRAMID       = 2,  // a = k, the number of base vertices
+  SHAPE_CYLINDER      = 3,  // a = k, the number of vertices around each end
+  SHAPE_GLOBE         = 4,  // a = longDivs, b = latDivs
+  SHAPE_SPHERICHEDRON = 5,  // a = divs
+  SHAPE_ICOSPHERE     = 6   // a = divs
+};
+
+/**
+ * A cached indexed shape.  The spheres have their positions as normals;
+ * the other shapes have smooth normals from vertexNormals().  The bounds
+ * of the vertices are found when the shape is generated and saved with it.
+ */
+struct ShapeMesh {
+  int           numVertices;
+  int           numIndices;
+  const point4 *vertices;
+  const vec3   *normals;
+  const GLuint *indices;
+  ShapeBounds   bounds;
+};
+
+class ShapeCache {
+
+  struct Key {
+    int kind, a, b;
+    bool operator < ( const Key& k ) const {
+      if (kind != k.kind) return kind < k.kind;
+      if (a != k.a) return a < k.a;
+      return b < k.b;
+    }
+  };
+
+  // A shape generated in this process; mesh points into the vectors
+  struct Entry {
+    ShapeMesh           mesh;
+    std::vector<point4> vertices;
+    std::vector<vec3>   normals;
+    std::vector<GLuint> indices;
+  };
+
+  // The layout of a cache file: a FileHeader, numShapes FileShapes, then
+  // the arrays, each beginning at a multiple of 16 bytes from the start.
+  struct FileHeader {
+    char         magic[8];
+    unsigned int numShapes;
+    unsigned int entrySize;   // sizeof(FileShape), as a format check
+  };
+
+  struct FileShape {
+    int                kind, a, b;
+    int                numVertices, numIndices;
+    int                unused;
+    unsigned long long verticesOffset, normalsOffset, indicesOffset;
+    ShapeBounds        bounds;
+  };
+
+  // A loaded file
+  struct Mapping {
+    void  *data;
+    size_t size;
+  };
+
+  std::map<Key, Entry>       entries;
+  std::vector<Mapping>       mappings;
+  mutable std::mutex         lock;
+  bool                       changed;
+
+  ShapeCache( const ShapeCache& );              // not copyable
+  ShapeCache& operator = ( const ShapeCache& );
+
+  static const char *fileMagic() { return "ANGSHP02"; }
+
+  static size_t align16( size_t n ) { return (n + 15) & ~size_t(15); }
+
+  /**
+   * Finds the numbers of vertices and indices of the shape for key;
+   * returns false if the parameters are not valid for the shape.
+   */
+  static bool shapeSize( const Key& key, int& numVertices, int& numIndices ) {
+    long long v, i;
+    switch (key.kind) {
+    case SHAPE_CUBE:
+      v = CubeNumVertices;
+      i = 6 * CubeNumFaces;
+      break;
+    case SHAPE_PYRAMID:
+      if (key.a < 3) return false;
+      v = key.a + 2LL;
+      i = 6LL * key.a;
+      break;
+    case SHAPE_CYLINDER:
+      if (key.a < 3) return false;
+      v = 2LL * key.a + 2;
+      i = 12LL * key.a;
+      break;
+    case SHAPE_GLOBE:
+      if (key.a < 3 || key.b < 2) return false;
+      v = (long long) key.a * (key.b - 1);
+      if (v > INT_MAX / 6) return false;
+      i = 6 * v;
+      v += 2;
+      break;
+    case SHAPE_SPHERICHEDRON:
+      if (key.a < 0 || key.a > 12) return false;
+      v = 4 * (1LL << (2 * key.a)) + 2;
+      i = 24 * (1LL << (2 * key.a));
+      break;
+    case SHAPE_ICOSPHERE:
+      if (key.a < 0 || key.a > 12) return false;
+      v = 10 * (1LL << (2 * key.a)) + 2;
+      i = 60 * (1LL << (2 * key.a));
+      break;
+    default:
+      return false;
+    }
+    if (i > INT_MAX) return false;
+    numVertices = (int) v;
+    numIndices  = (int) i;
+    return true;
+  }
+
+  /**
+   * Generates the shape for key into entry; returns false if the
+   * parameters are not valid for the shape.
+   */
+  static bool generate( const Key& key, Entry& entry ) {
+    int numVertices, numIndices;
+    if (!shapeSize( key, numVertices, numIndices )) return false;
+
+    entry.vertices.resize( numVertices );
+    entry.normals.resize( numVertices );
+    entry.indices.resize( numIndices );
+    point4 *v = &entry.vertices[0];
+    GLuint *i = &entry.indices[0];
+
+    switch (key.kind) {
+    case SHAPE_CUBE:          cube( v, 0, i, 0 );                    break;
+    case SHAPE_PYRAMID:       pyramid( key.a, v, 0, i, 0 );          break;
+    case SHAPE_CYLINDER:      cylinder( key.a, v, 0, i, 0 );         break;
+    case SHAPE_GLOBE:         globe( key.a, key.b, v, 0, i, 0 );     break;
+    case SHAPE_SPHERICHEDRON: spherichedron( key.a, v, 0, i, 0 );    break;
+    case SHAPE_ICOSPHERE:     icosphere( key.a, v, 0, i, 0 );        break;
+    }
+
+    if (key.kind == SHAPE_GLOBE || key.kind == SHAPE_SPHERICHEDRON ||
+        key.kind == SHAPE_ICOSPHERE) {
+      sphericalNormals( numVertices, v, &entry.normals[0], 0 );
+    } else {
+      vertexNormals( numVertices, v, 0, numIndices, i, 0, &entry.normals[0] );
+    }
+
+    entry.mesh.numVertices = numVertices;
+    entry.mesh.numIndices  = numIndices;
+    entry.mesh.vertices    = v;
+    entry.mesh.normals     = &entry.normals[0];
+    entry.mesh.indices     = i;
+    entry.mesh.bounds      = shapeBounds( numVertices, v, 0 );
+    return true;
+  }
+
+  /**
+   * Adds the shapes of a file, already in memory at data, that are not
+   * already in the cache; returns false if the file is not a valid cache
+   * file, in which case nothing is added.  A file is only valid if every
+   * shape in it has the numbers of vertices and indices its kind and
+   * parameters give and no index past its last vertex, so a stale or
+   * damaged file cannot make copyShape() or a draw read past a shape,
+   * or overflow arrays sized for it; its shapes are generated again.
+   */
+  bool addFile( const char *data, size_t size ) {
+    FileHeader header;
+    if (size < sizeof(header)) return false;
+    memcpy( &header, data, sizeof(header) );
+    if (memcmp( header.magic, fileMagic(), sizeof(header.magic) ) != 0 ||
+        header.entrySize != sizeof(FileShape) ||
+        header.numShapes > (size - sizeof(header)) / sizeof(FileShape)) {
+      return false;
+    }
+
+    // Check every shape before adding any
+    const FileShape *shapes = (const FileShape *) (data + sizeof(header));
+    for (unsigned int s = 0; s < header.numShapes; s++) {
+      const FileShape& f = shapes[s];
+      if (f.numVertices <= 0 || f.numIndices <= 0 ||
+          f.verticesOffset % 16 != 0 || f.normalsOffset % 4 != 0 ||
+          f.indicesOffset % 4 != 0 ||
+          f.verticesOffset > size || f.normalsOffset > size || f.indicesOffset > size ||
+          (size - f.verticesOffset) / sizeof(point4) < (size_t) f.numVertices ||
+          (size - f.normalsOffset)  / sizeof(vec3)   < (size_t) f.numVertices ||
+          (size - f.indicesOffset)  / sizeof(GLuint) < (size_t) f.numIndices) {
+        return false;
+      }
+      Key key = { f.kind, f.a, f.b };
+      int numVertices, numIndices;
+      if (!shapeSize( key, numVertices, numIndices ) ||
+          f.numVertices != numVertices || f.numIndices != numIndices) {
+        return false;
+      }
+      const GLuint *indices = (const GLuint *) (data + f.indicesOffset);
+      for (int i = 0; i < f.numIndices; i++) {
+        if (indices[i] >= (GLuint) f.numVertices) return false;
+      }
+    }
+
+    for (unsigned int s = 0; s < header.numShapes; s++) {
+      const FileShape& f = shapes[s];
+      Key key = { f.kind, f.a, f.b };
+      if (entries.count( key ) != 0) continue;
+      Entry& entry = entries[key];
+      entry.mesh.numVertices = f.numVertices;
+      entry.mesh.numIndices  = f.numIndices;
+      entry.mesh.vertices    = (const point4 *) (data + f.verticesOffset);
+      entry.mesh.normals     = (const vec3 *)   (data + f.normalsOffset);
+      entry.mesh.indices     = (const GLuint *) (data + f.indicesOffset);
+      entry.mesh.bounds      = f.bounds;
+    }
+    return true;
+  }
+
+ public:
+  ShapeCache() : changed( false ) {}
+
+  ~ShapeCache() {
+    for (size_t m = 0; m < mappings.size(); m++) {
+#ifndef _WIN32
+      munmap( mappings[m].data, mappings[m].size );
+#else
+      delete [] (point4 *) mappings[m].data;
+#endif
+    }
+  }
+
+  /**
+   * Returns the shape of the given kind and parameters, generating it
+   * if it is not in the cache yet.
+   *
+   * @param kind  the kind of shape
+   * @param a, b  the parameters of the shape, as listed for ShapeKind;
+   *              unused parameters must be 0
+   * @return      the shape, or NULL if the parameters are not valid
+   */
+  const ShapeMesh *get( ShapeKind kind, int a = 0, int b = 0 ) {
+    std::lock_guard<std::mutex> guard( lock );
+    Key key = { kind, a, b };
+    std::map<Key, Entry>::iterator found = entries.find( key );
+    if (found != entries.end()) return &found->second.mesh;
+
+    Entry entry;
+    if (!generate( key, entry )) return NULL;
+    Entry& stored = entries[key];
+    stored.vertices.swap( entry.vertices );     // swapping keeps the
+    stored.normals.swap( entry.normals );       // arrays where they are
+    stored.indices.swap( entry.indices );
+    stored.mesh = entry.mesh;
+    changed = true;
+    return &stored.mesh;
+  }
+
+  /**
+   * Loads the shapes saved in a cache file, memory-mapping the file.
+   * Shapes already in the cache are kept.
+   *
+   * @return true if the file was loaded, false if it does not exist
+   *         or is not a valid cache file
+   */
+  bool load( const char *path ) {
+    std::lock_guard<std::mutex> guard( lock );
+    Mapping mapping;
+#ifndef _WIN32
+    int fd = open( path, O_RDONLY );
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat( fd, &info ) != 0 || info.st_size <= 0) {
+      close( fd );
+      return false;
+    }
+    mapping.size = (size_t) info.st_size;
+    mapping.data = mmap( NULL, mapping.size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (mapping.data == MAP_FAILED) return false;
+    if (!addFile( (const char *) mapping.data, mapping.size )) {
+      munmap( mapping.data, mapping.size );
+      return false;
+    }
+#else
+    FILE *file = fopen( path, "rb" );
+    if (file == NULL) return false;
+    fseek( file, 0, SEEK_END );
+    long size = ftell( file );
+    fseek( file, 0, SEEK_SET );
+    if (size <= 0) {
+      fclose( file );
+      return false;
+    }
+    mapping.size = (size_t) size;
+    mapping.data = new point4[align16( mapping.size ) / sizeof(point4)];
+    bool read = fread( mapping.data, 1, mapping.size, file ) == mapping.size;
+    fclose( file );
+    if (!read || !addFile( (const char *) mapping.data, mapping.size )) {
+      delete [] (point4 *) mapping.data;
+      return false;
+    }
+#endif
+    mappings.push_back( mapping );
+    return true;
+  }
+
+  /**
+   * Saves every shape in the cache to a cache file, replacing it.
+   *
+   * @return true if the file was written
+   */
+  bool save( const char *path ) {
+    std::lock_guard<std::mutex> guard( lock );
+
+    FileHeader header;
+    memcpy( header.magic, fileMagic(), sizeof(header.magic) );
+    header.numShapes = (unsigned int) entries.size();
+    header.entrySize = sizeof(FileShape);
+
+    // Lay out the arrays after the table of shapes
+    std::vector<FileShape> shapes;
+    size_t offset = align16( sizeof(header) + entries.size() * sizeof(FileShape) );
+    for (std::map<Key, Entry>::const_iterator e = entries.begin();
+         e != entries.end(); ++e) {
+      const ShapeMesh& mesh = e->second.mesh;
+      FileShape f;
+      memset( (void *) &f, 0, sizeof(f) );   // padding too, so files are repeatable
+      f.kind = e->first.kind;  f.a = e->first.a;  f.b = e->first.b;
+      f.numVertices = mesh.numVertices;
+      f.numIndices  = mesh.numIndices;
+      f.bounds      = mesh.bounds;
+      f.verticesOffset = offset;
+      offset = align16( offset + mesh.numVertices * sizeof(point4) );
+      f.normalsOffset  = offset;
+      offset = align16( offset + mesh.numVertices * sizeof(vec3) );
+      f.indicesOffset  = offset;
+      offset = align16( offset + mesh.numIndices * sizeof(GLuint) );
+      shapes.push_back( f );
+    }
+
+    // Write to a temporary file first, so that a program that has the
+    // old file mapped, or a failed write, never sees a partial file
+    std::string temporary = std::string( path ) + ".tmp";
+    FILE *file = fopen( temporary.c_str(), "wb" );
+    if (file == NULL) return false;
+
+    static const char padding[16] = { 0 };
+    size_t written = 0;
+    bool ok = fwrite( &header, sizeof(header), 1, file ) == 1;
+    written += sizeof(header);
+    if (ok && !shapes.empty()) {
+      ok = fwrite( &shapes[0], sizeof(FileShape), shapes.size(), file ) == shapes.size();
+      written += shapes.size() * sizeof(FileShape);
+    }
+    size_t s = 0;
+    for (std::map<Key, Entry>::const_iterator e = entries.begin();
+         ok && e != entries.end(); ++e, ++s) {
+      const ShapeMesh& mesh = e->second.mesh;
+      const void  *data[3]   = { mesh.vertices, mesh.normals, mesh.indices };
+      const size_t bytes[3]  = { mesh.numVertices * sizeof(point4),
+                                 mesh.numVertices * sizeof(vec3),
+                                 mesh.numIndices  * sizeof(GLuint) };
+      const size_t offsets[3] = { (size_t) shapes[s].verticesOffset,
+                                  (size_t) shapes[s].normalsOffset,
+                                  (size_t) shapes[s].indicesOffset };
+      for (int a = 0; ok && a < 3; a++) {
+        ok = fwrite( padding, 1, offsets[a] - written, file ) == offsets[a] - written &&
+             fwrite( data[a], 1, bytes[a], file ) == bytes[a];
+        written = offsets[a] + bytes[a];
+      }
+    }
+    ok = (fclose( file ) == 0) && ok;
+    if (ok) ok = (rename( temporary.c_str(), path ) == 0);
+    if (!ok) {
+      remove( temporary.c_str() );
+      return false;
+    }
+    changed = false;
+    return true;
+  }
+
+  /**
+   * Returns true if shapes have been generated since the cache was
+   * created or last saved, so that saving would add to the file.
+   */
+  bool modified() const {
+    std::lock_guard<std::mutex> guard( lock );
+    return changed;
+  }
+
+  /**
+   * The cache shared by the whole program, created on first use.
+   */
+  static ShapeCache& shared() {
+    static ShapeCache cache;
+    return cache;
+  }
+};
+
+/**
+ * Copies a cached shape into a vertex array, which may be one attribute
+ * of an interleaved array, beginning at position vStart
+ * and an index array beginning at position iStart, offsetting the indices
+ * by vStart, as the indexed generators in holeyShapes.h do.
+ * If normals is not NULL, the normals are copied to it beginning at vStart.
+ * Returns iStart + mesh.numIndices.
+ */
+template <class Index>
+int copyShape( const ShapeMesh& mesh, Strided<point4> vertices, int vStart,
+               Index indices[], int iStart, Strided<vec3> normals = NULL ) {
+  for (int i = 0; i < mesh.numVertices; i++) {
+    vertices[vStart+i] = mesh.vertices[i];
+  }
+  if (normals != NULL) {
+    for (int i = 0; i < mesh.numVertices; i++) {
+      normals[vStart+i] = mesh.normals[i];
+    }
+  }
+  for (int i = 0; i < mesh.numIndices; i++) {
+    indices[iStart+i] = (Index) (mesh.indices[i] + vStart);
+  }
+  return iStart + mesh.numIndices;
+}
+
+
+#endif
@@ -0,0 +1,232 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+//  --- simd.h ---
+//
+//   Compile-time selection of the 4-wide SIMD backend used by vec4 and
+//   mat4.  SSE is used on x86 targets and NEON on ARM targets; define
+//   ANGEL_NO_SIMD before including Angel.h to force the scalar code.
+//
+//   The kernels below perform exactly the same float operations, in the
+//   same order, as the scalar loops in vec.h and mat.h, so both paths give
+//   bit-for-bit identical results (as long as the compiler is not allowed
+//   to contract the scalar code into fused multiply-adds).
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ANGEL_SIMD_H__
+#define __ANGEL_SIMD_H__
+
+#include <cstddef>
+
+#if !defined(ANGEL_NO_SIMD)
+#  if defined(__SSE__) || defined(_M_X64) || \
+      (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#    include <xmmintrin.h>
+#    define ANGEL_SIMD_SSE
+#  elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    include <arm_neon.h>
+#    define ANGEL_SIMD_NEON
+#  endif
+#endif
+
+#if defined(ANGEL_SIMD_SSE) || defined(ANGEL_SIMD_NEON)
+#  define ANGEL_SIMD
+#endif
+
+//  vec4 (and so mat4 rows) are always 16-byte aligned, so that the same
+//    memory layout is used whether or not the SIMD backend is enabled.
+#ifdef _MSC_VER
+#  define ANGEL_ALIGN16  __declspec(align(16))
+#else
+#  define ANGEL_ALIGN16  __attribute__((aligned(16)))
+#endif
+
+#ifdef ANGEL_SIMD
+
+namespace Angel {
+namespace simd {
+
+//----------------------------------------------------------------------------
+//
+//  --- Backend primitives ---
+//
+
+#if defined(ANGEL_SIMD_SSE)
+
+typedef __m128  f4;
+
+inline f4   load( const GLfloat* p )      { return _mm_load_ps( p ); }
+inline void store( GLfloat* p, f4 v )     { _mm_store_ps( p, v ); }
+inline f4   splat( GLfloat s )            { return _mm_set1_ps( s ); }
+inline f4   zero()                        { return _mm_setzero_ps(); }
+inline f4   add( f4 a, f4 b )             { return _mm_add_ps( a, b ); }
+inline f4   sub( f4 a, f4 b )             { return _mm_sub_ps( a, b ); }
+inline f4   mul( f4 a, f4 b )             { return _mm_mul_ps( a, b ); }
+inline f4   neg( f4 a )    { return _mm_xor_ps( a, _mm_set1_ps( -0.0f ) ); }
+
+//  Bit i set where a[i] < b[i]
+inline int  lessMask( f4 a, f4 b )        { return _mm_movemask_ps( _mm_cmplt_ps( a, b ) ); }
+
+inline void
+transpose( f4& r0, f4& r1, f4& r2, f4& r3 )
+{
+    _MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+}
+
+#elif defined(ANGEL_SIMD_NEON)
+
+typedef float32x4_t  f4;
+
+inline f4   load( const GLfloat* p )      { return vld1q_f32( p ); }
+inline void store( GLfloat* p, f4 v )     { vst1q_f32( p, v ); }
+inline f4   splat( GLfloat s )            { return vdupq_n_f32( s ); }
+inline f4   zero()                        { return vdupq_n_f32( 0.0f ); }
+inline f4   add( f4 a, f4 b )             { return vaddq_f32( a, b ); }
+inline f4   sub( f4 a, f4 b )             { return vsubq_f32( a, b ); }
+inline f4   mul( f4 a, f4 b )             { return vmulq_f32( a, b ); }
+inline f4   neg( f4 a )                   { return vnegq_f32( a ); }
+
+//  Bit i set where a[i] < b[i]
+inline int
+lessMask( f4 a, f4 b )
+{
+    uint32x4_t lt = vcltq_f32( a, b );
+    return (vgetq_lane_u32( lt, 0 ) & 1) | (vgetq_lane_u32( lt, 1 ) & 2) |
+	   (vgetq_lane_u32( lt, 2 ) & 4) | (vgetq_lane_u32( lt, 3 ) & 8);
+}
+
+inline void
+transpose( f4& r0, f4& r1, f4& r2, f4& r3 )
+{
+    float32x4x2_t t01 = vtrnq_f32( r0, r1 );
+    float32x4x2_t t23 = vtrnq_f32( r2, r3 );
+    r0 = vcombine_f32( vget_low_f32( t01.val[0] ),  vget_low_f32( t23.val[0] ) );
+    r1 = vcombine_f32( vget_low_f32( t01.val[1] ),  vget_low_f32( t23.val[1] ) );
+    r2 = vcombine_f32( vget_high_f32( t01.val[0] ), vget_high_f32( t23.val[0] ) );
+    r3 = vcombine_f32( vget_high_f32( t01.val[1] ), vget_high_f32( t23.val[1] ) );
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+//
+//  --- 4 x 4 matrix kernels ---
+//
+//    Matrices are four rows of four floats, as stored by mat4.
+//
+
+//  c = a * b.  Each row of c is accumulated from zero as
+//    a[i][0]*b[0] + a[i][1]*b[1] + a[i][2]*b[2] + a[i][3]*b[3],
+//    matching the order of the scalar triple loop.  c may alias a or b.
+inline void
+mat4Mult( const GLfloat* a, const GLfloat* b, GLfloat* c )
+{
+    f4 b0 = load( b ),     b1 = load( b + 4 ),
+       b2 = load( b + 8 ), b3 = load( b + 12 );
+    f4 r[4];
+
+    for ( int i = 0; i < 4; ++i ) {
+	const GLfloat* ai = a + 4*i;
+	f4 acc = zero();
+	acc = add( acc, mul( splat( ai[0] ), b0 ) );
+	acc = add( acc, mul( splat( ai[1] ), b1 ) );
+	acc = add( acc, mul( splat( ai[2] ), b2 ) );
+	acc = add( acc, mul( splat( ai[3] ), b3 ) );
+	r[i] = acc;
+    }
+
+    for ( int i = 0; i < 4; ++i ) {
+	store( c + 4*i, r[i] );
+    }
+}
+
+//  u = m * v, computed as the linear combination of the columns of m so
+//    every lane sums m[i][0]*v.x + m[i][1]*v.y + m[i][2]*v.z + m[i][3]*v.w
+//    in the same order as the scalar code.
+inline void
+mat4Vec( const GLfloat* m, const GLfloat* v, GLfloat* u )
+{
+    f4 c0 = load( m ),     c1 = load( m + 4 ),
+       c2 = load( m + 8 ), c3 = load( m + 12 );
+    transpose( c0, c1, c2, c3 );
+
+    f4 acc = mul( c0, splat( v[0] ) );
+    acc = add( acc, mul( c1, splat( v[1] ) ) );
+    acc = add( acc, mul( c2, splat( v[2] ) ) );
+    acc = add( acc, mul( c3, splat( v[3] ) ) );
+    store( u, acc );
+}
+
+//  out[i] = m * in[i] for n consecutive 4-float vectors.  The columns of m
+//    are formed once, then each vector costs four multiplies and three adds.
+//    in and out may be the same array.
+inline void
+mat4VecArray( const GLfloat* m, const GLfloat* in, GLfloat* out, size_t n )
+{
+    f4 c0 = load( m ),     c1 = load( m + 4 ),
+       c2 = load( m + 8 ), c3 = load( m + 12 );
+    transpose( c0, c1, c2, c3 );
+
+    for ( size_t i = 0; i < n; ++i, in += 4, out += 4 ) {
+	f4 acc = mul( c0, splat( in[0] ) );
+	acc = add( acc, mul( c1, splat( in[1] ) ) );
+	acc = add( acc, mul( c2, splat( in[2] ) ) );
+	acc = add( acc, mul( c3, splat( in[3] ) ) );
+	store( out, acc );
+    }
+}
+
+//  As mat4VecArray, but treats every input as a direction (w = 0), so the
+//    translation column of m only contributes m[i][3] * 0.  That term is
+//    still added, as the scalar code adds it, so an Inf or NaN in the
+//    column and the sign of a zero result come out the same.
+inline void
+mat4DirArray( const GLfloat* m, const GLfloat* in, GLfloat* out, size_t n )
+{
+    f4 c0 = load( m ),     c1 = load( m + 4 ),
+       c2 = load( m + 8 ), c3 = load( m + 12 );
+    transpose( c0, c1, c2, c3 );
+    f4 w0 = mul( c3, zero() );
+
+    for ( size_t i = 0; i < n; ++i, in += 4, out += 4 ) {
+	f4 acc = mul( c0, splat( in[0] ) );
+	acc = add( acc, mul( c1, splat( in[1] ) ) );
+	acc = add( acc, mul( c2, splat( in[2] ) ) );
+	acc = add( acc, w0 );
+	store( out, acc );
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//  --- Culling kernels ---
+//
+
+//  Tests four spheres, centers (x[i], y[i], z[i]) and radii r[i], against
+//    the six planes a*x + b*y + c*z + d >= 0 stored as planes[4*p] ...
+//    planes[4*p + 3].  Bit i of the result is set if sphere i is wholly
+//    outside some plane.  Each distance is summed in the order of the
+//    scalar test in mat.h.
+inline int
+spheresOutside4( const GLfloat* planes, const GLfloat* x, const GLfloat* y,
+		 const GLfloat* z, const GLfloat* r )
+{
+    f4 px = load( x ), py = load( y ), pz = load( z ), nr = neg( load( r ) );
+
+    int outside = 0;
+    for ( int p = 0; p < 6; ++p, planes += 4 ) {
+	f4 d = mul( splat( planes[0] ), px );
+	d = add( d, mul( splat( planes[1] ), py ) );
+	d = add( d, mul( splat( planes[2] ), pz ) );
+	d = add( d, splat( planes[3] ) );
+	outside |= lessMask( d, nr );
+    }
+    return outside;
+}
+
+}  // namespace simd
+}  // namespace Angel
+
+#endif // ANGEL_SIMD
+
+#endif // __ANGEL_SIMD_H__
@@ -0,0 +1,258 @@
+/*
+ * File: taskScheduler.h
+ */
+
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+/**
+ * A small work-stealing task system, for updating many independent
+ * objects (each one's rotation, revolution, compression phase, ...) in
+ * parallel.  Each thread keeps its own queue of tasks: it adds new tasks
+ * at the back and runs them from the back, so it mostly works on what it
+ * just created, while a thread that runs out takes tasks from the front of
+ * another thread's queue, where the oldest and usually biggest tasks are.
+ * Work spread unevenly over the tasks therefore still keeps every thread
+ * busy, without one shared queue that all threads contend for.
+ *
+ *   TaskScheduler& tasks = TaskScheduler::shared();
+ *
+ *   TaskScheduler::Group group;
+ *   tasks.spawn( group, updateGlobe );
+ *   tasks.spawn( group, updateBalls );
+ *   tasks.wait( group );                  // runs tasks until both are done
+ *
+ *   tasks.parallelFor( 0, numObjects, 256, []( int begin, int end ) {
+ *       for ( int i = begin; i < end; i++ ) update( i );
+ *   } );
+ *
+ * Tasks may spawn and wait for tasks of their own; a thread that waits
+ * runs other tasks meanwhile instead of blocking.  Threads that are not
+ * the scheduler's own (such as the one that created it) share one queue.
+ * parallel.h's ThreadPool, which hands out the items of one loop at a
+ * time, remains the simpler choice for a single flat loop.
+ *
+ * Requires C++11 <thread> and thread_local; link with -pthread.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskScheduler {
+
+ public:
+  typedef std::function<void()> Task;
+
+  /**
+   * A set of tasks that can be waited for together.  It must outlive
+   * its tasks, so wait() for it before it goes out of scope.
+   */
+  class Group {
+    friend class TaskScheduler;
+    std::atomic<int> pending;
+    Group( const Group& );                       // not copyable
+    Group& operator = ( const Group& );
+   public:
+    Group() : pending( 0 ) {}
+    bool done() const { return pending.load( std::memory_order_acquire ) == 0; }
+  };
+
+ private:
+  struct Entry {
+    Task   task;
+    Group *group;
+  };
+
+  struct Queue {
+    std::mutex        lock;
+    std::deque<Entry> entries;
+  };
+
+  std::vector<Queue *>     queues;       // 0 for outside threads, then one per worker
+  std::vector<std::thread> workers;
+  std::atomic<int>         queued;       // tasks in all the queues
+  std::atomic<int>         sleeping;     // workers waiting for tasks
+  std::mutex               sleepLock;
+  std::condition_variable  wake;
+  bool                     stopping;     // guarded by sleepLock
+
+  TaskScheduler( const TaskScheduler& );         // not copyable
+  TaskScheduler& operator = ( const TaskScheduler& );
+
+  //  The scheduler a thread works for, and its queue there
+  struct ThreadSlot {
+    const TaskScheduler *scheduler;
+    int                  queue;
+  };
+  static ThreadSlot& slot() {
+    static thread_local ThreadSlot s = { NULL, 0 };
+    return s;
+  }
+
+  int myQueue() const {
+    const ThreadSlot& s = slot();
+    return (s.scheduler == this) ? s.queue : 0;
+  }
+
+  //  Takes a task from the back of queue q, or the front if stealing
+  bool take( int q, bool steal, Entry& entry ) {
+    Queue& queue = *queues[q];
+    std::lock_guard<std::mutex> guard( queue.lock );
+    if (queue.entries.empty()) return false;
+    if (steal) {
+      entry = queue.entries.front();
+      queue.entries.pop_front();
+    } else {
+      entry = queue.entries.back();
+      queue.entries.pop_back();
+    }
+    queued.fetch_sub( 1 );
+    return true;
+  }
+
+  //  Finds a task for the thread with queue q: its own newest, or another
+  //    queue's oldest, trying the other queues in turn from the next one
+  bool find( int q, Entry& entry ) {
+    if (take( q, false, entry )) return true;
+    int n = (int) queues.size();
+    for (int k = 1; k < n; k++) {
+      if (take( (q + k) % n, true, entry )) return true;
+    }
+    return false;
+  }
+
+  static void run( Entry& entry ) {
+    entry.task();
+    entry.group->pending.fetch_sub( 1, std::memory_order_acq_rel );
+  }
+
+  void workerLoop( int q ) {
+    slot().scheduler = this;
+    slot().queue     = q;
+    Entry entry;
+    for (;;) {
+      if (find( q, entry )) {
+        run( entry );
+        continue;
+      }
+      std::unique_lock<std::mutex> guard( sleepLock );
+      sleeping.fetch_add( 1 );
+      while (!stopping && queued.load() == 0) wake.wait( guard );
+      sleeping.fetch_sub( 1 );
+      if (stopping) return;
+    }
+  }
+
+  //  Runs f over [begin, end), splitting off the upper half as a task
+  //    while the range is longer than grain, so idle threads can steal
+  //    big pieces
+  template <class Func>
+  void split( Group& group, int begin, int end, int grain, const Func& f ) {
+    while (end - begin > grain) {
+      int mid = begin + (end - begin) / 2;
+      spawn( group, [this, &group, mid, end, grain, &f]() {
+        split( group, mid, end, grain, f );
+      } );
+      end = mid;
+    }
+    f( begin, end );
+  }
+
+ public:
+  /**
+   * Creates numThreads - 1 worker threads, since a thread that waits for
+   * tasks also runs them; 0 means use every hardware thread.
+   */
+  explicit TaskScheduler( unsigned int numThreads = 0 )
+    : queued( 0 ), sleeping( 0 ), stopping( false ) {
+    if (numThreads == 0) numThreads = std::thread::hardware_concurrency();
+    if (numThreads == 0) numThreads = 1;
+    for (unsigned int i = 0; i < numThreads; i++) queues.push_back( new Queue );
+    for (unsigned int i = 1; i < numThreads; i++) {
+      workers.push_back( std::thread( &TaskScheduler::workerLoop, this, (int) i ) );
+    }
+  }
+
+  /**
+   * Stops the workers; tasks still queued are not run.
+   */
+  ~TaskScheduler() {
+    {
+      std::lock_guard<std::mutex> guard( sleepLock );
+      stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+    for (size_t i = 0; i < queues.size(); i++) delete queues[i];
+  }
+
+  /**
+   * Returns the number of threads that run tasks, including one that
+   * waits.
+   */
+  unsigned int size() const { return (unsigned int) queues.size(); }
+
+  /**
+   * Queues task as part of group, on the calling thread's queue.
+   */
+  void spawn( Group& group, const Task& task ) {
+    group.pending.fetch_add( 1, std::memory_order_relaxed );
+    Entry entry = { task, &group };
+    Queue& queue = *queues[myQueue()];
+    {
+      std::lock_guard<std::mutex> guard( queue.lock );
+      queue.entries.push_back( entry );
+    }
+    queued.fetch_add( 1 );
+    if (sleeping.load() > 0) {
+      std::lock_guard<std::mutex> guard( sleepLock );
+      wake.notify_one();
+    }
+  }
+
+  /**
+   * Runs tasks, of this group or any other, until all of group's tasks
+   * are done.
+   */
+  void wait( Group& group ) {
+    int q = myQueue();
+    Entry entry;
+    while (!group.done()) {
+      if (find( q, entry )) {
+        run( entry );
+      } else {
+        std::this_thread::yield();     // the rest are running elsewhere
+      }
+    }
+  }
+
+  /**
+   * Calls f( b, e ) on disjoint ranges [b, e) that cover [begin, end),
+   * each no longer than grain, in parallel, and returns when all the
+   * calls are done.
+   */
+  template <class Func>
+  void parallelFor( int begin, int end, int grain, const Func& f ) {
+    if (end <= begin) return;
+    if (grain < 1) grain = 1;
+    Group group;
+    split( group, begin, end, grain, f );
+    wait( group );
+  }
+
+  /**
+   * A scheduler with every hardware thread, created on first use.
+   */
+  static TaskScheduler& shared() {
+    static TaskScheduler scheduler;
+    return scheduler;
+  }
+};
+
+
+#endif
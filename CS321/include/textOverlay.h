@@ -0,0 +1,225 @@
+/*
+ * File: textOverlay.h
+ */
+
+#ifndef TEXT_OVERLAY_H
+#define TEXT_OVERLAY_H
+
+/**
+ * Lines of text drawn over a frame, for showing numbers such as frame
+ * times while a program runs.  The core profile has no text drawing
+ * (glutBitmapString needs the compatibility profile), so the text is
+ * drawn from a built-in 5x7 pixel font, each lit pixel of a character
+ * as a small square:
+ *
+ *   TextOverlay overlay;
+ *   overlay.create();                    // once, with a context
+ *   ...
+ *   overlay.clear();                     // in display(), after drawing
+ *   overlay.print( 8, 8, "frame 16.7 ms" );
+ *   overlay.draw();
+ *
+ * The font has digits, capital letters (lower case letters are drawn as
+ * capitals), space and . , : - % / ( ) = _.  draw() uses its own program
+ * and vertex array object and puts back the ones that were in use.
+ */
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+#ifndef color4
+typedef Angel::vec4 color4;
+#endif
+
+class TextOverlay {
+
+  GLuint            program, vao, buffer;
+  GLint             viewportLocation, colorLocation;
+  std::vector<vec2> vertices;      // 6 per lit pixel, in window pixels
+
+  TextOverlay( const TextOverlay& );               // not copyable
+  TextOverlay& operator = ( const TextOverlay& );
+
+  /**
+   * Returns the 7 rows of character c, 5 bits each with the leftmost
+   * pixel in bit 4, or NULL if the font does not have it.
+   */
+  static const unsigned char *glyph( char c ) {
+    static const char characters[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.,:-%/()=_";
+    static const unsigned char rows[][7] = {
+      { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E },  // 0
+      { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },  // 1
+      { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F },  // 2
+      { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },  // 3
+      { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 },  // 4
+      { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },  // 5
+      { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E },  // 6
+      { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },  // 7
+      { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E },  // 8
+      { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },  // 9
+      { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 },  // A
+      { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E },  // B
+      { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E },  // C
+      { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C },  // D
+      { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F },  // E
+      { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 },  // F
+      { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F },  // G
+      { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },  // H
+      { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },  // I
+      { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C },  // J
+      { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },  // K
+      { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F },  // L
+      { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 },  // M
+      { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },  // N
+      { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },  // O
+      { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 },  // P
+      { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D },  // Q
+      { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 },  // R
+      { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E },  // S
+      { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },  // T
+      { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },  // U
+      { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 },  // V
+      { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A },  // W
+      { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 },  // X
+      { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 },  // Y
+      { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F },  // Z
+      { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C },  // .
+      { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 },  // ,
+      { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 },  // :
+      { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 },  // -
+      { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },  // %
+      { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },  // /
+      { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 },  // (
+      { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 },  // )
+      { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 },  // =
+      { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F }   // _
+    };
+    if (c == '\0') return NULL;
+    const char *p = strchr( characters, toupper( (unsigned char) c ) );
+    return (p == NULL) ? NULL : rows[p - characters];
+  }
+
+  static GLuint compile( GLenum type, const char *source ) {
+    GLuint shader = glCreateShader( type );
+    glShaderSource( shader, 1, &source, NULL );
+    glCompileShader( shader );
+    GLint compiled;
+    glGetShaderiv( shader, GL_COMPILE_STATUS, &compiled );
+    if (!compiled) std::cerr << "TextOverlay: shader failed to compile" << std::endl;
+    return shader;
+  }
+
+ public:
+  TextOverlay() : program( 0 ), vao( 0 ), buffer( 0 ) {}
+
+  /**
+   * Creates the program, vertex array and buffer; needs a current
+   * context.
+   */
+  void create() {
+    static const char *vertexSource =
+      "#version 150\n"
+      "in  vec2 vPixel;\n"
+      "uniform vec2 viewport;\n"
+      "void main() {\n"
+      "  gl_Position = vec4( 2.0 * vPixel.x / viewport.x - 1.0,\n"
+      "                      1.0 - 2.0 * vPixel.y / viewport.y, 0.0, 1.0 );\n"
+      "}\n";
+    static const char *fragmentSource =
+      "#version 150\n"
+      "uniform vec4 color;\n"
+      "out vec4 fColor;\n"
+      "void main() { fColor = color; }\n";
+
+    GLint previousProgram, previousVao;
+    glGetIntegerv( GL_CURRENT_PROGRAM, &previousProgram );
+    glGetIntegerv( GL_VERTEX_ARRAY_BINDING, &previousVao );
+
+    program = glCreateProgram();
+    glAttachShader( program, compile( GL_VERTEX_SHADER, vertexSource ) );
+    glAttachShader( program, compile( GL_FRAGMENT_SHADER, fragmentSource ) );
+    glLinkProgram( program );
+    viewportLocation = glGetUniformLocation( program, "viewport" );
+    colorLocation    = glGetUniformLocation( program, "color" );
+
+    glGenVertexArrays( 1, &vao );
+    glBindVertexArray( vao );
+    glGenBuffers( 1, &buffer );
+    glBindBuffer( GL_ARRAY_BUFFER, buffer );
+    GLint location = glGetAttribLocation( program, "vPixel" );
+    glEnableVertexAttribArray( location );
+    glVertexAttribPointer( location, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0) );
+
+    glUseProgram( previousProgram );
+    glBindVertexArray( previousVao );
+  }
+
+  /**
+   * Removes all the text.
+   */
+  void clear() { vertices.clear(); }
+
+  /**
+   * Adds text with its top left corner x, y pixels from the top left of
+   * the window, each font pixel drawn scale x scale; '\n' starts a new
+   * line.  Returns the y of the line after the text.
+   */
+  int print( int x, int y, const char *text, int scale = 2 ) {
+    int column = x;
+    for (; *text != '\0'; text++) {
+      if (*text == '\n') {
+        column = x;
+        y += 9 * scale;
+        continue;
+      }
+      const unsigned char *rows = glyph( *text );
+      for (int r = 0; rows != NULL && r < 7; r++) {
+        for (int c = 0; c < 5; c++) {
+          if (!(rows[r] & (0x10 >> c))) continue;
+          GLfloat left = column + c * scale, top = y + r * scale;
+          GLfloat right = left + scale, bottom = top + scale;
+          vertices.push_back( vec2( left,  top    ) );
+          vertices.push_back( vec2( left,  bottom ) );
+          vertices.push_back( vec2( right, top    ) );
+          vertices.push_back( vec2( right, top    ) );
+          vertices.push_back( vec2( left,  bottom ) );
+          vertices.push_back( vec2( right, bottom ) );
+        }
+      }
+      column += 6 * scale;
+    }
+    return y + 9 * scale;
+  }
+
+  /**
+   * Draws the text over the current viewport, without depth testing.
+   */
+  void draw( const color4& color = color4( 0.0, 0.0, 0.0, 1.0 ) ) {
+    if (vertices.empty()) return;
+
+    GLint previousProgram, previousVao, viewport[4];
+    glGetIntegerv( GL_CURRENT_PROGRAM, &previousProgram );
+    glGetIntegerv( GL_VERTEX_ARRAY_BINDING, &previousVao );
+    glGetIntegerv( GL_VIEWPORT, viewport );
+    GLboolean depthTest = glIsEnabled( GL_DEPTH_TEST );
+
+    glUseProgram( program );
+    glBindVertexArray( vao );
+    glBindBuffer( GL_ARRAY_BUFFER, buffer );
+    glBufferData( GL_ARRAY_BUFFER, vertices.size() * sizeof(vec2), &vertices[0],
+                  GL_STREAM_DRAW );
+    glUniform2f( viewportLocation, viewport[2], viewport[3] );
+    glUniform4fv( colorLocation, 1, color );
+    glDisable( GL_DEPTH_TEST );
+    glDrawArrays( GL_TRIANGLES, 0, vertices.size() );
+
+    if (depthTest) glEnable( GL_DEPTH_TEST );
+    glUseProgram( previousProgram );
+    glBindVertexArray( previousVao );
+  }
+};
+
+
+#endif
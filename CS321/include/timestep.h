@@ -0,0 +1,176 @@
+/*
+ * File: timestep.h
+ */
+
+#ifndef TIMESTEP_H
+#define TIMESTEP_H
+
+/**
+ * Running a simulation at a fixed rate, whatever the frame rate.  A
+ * FixedTimestep adds the real time since the last frame to an
+ * accumulator and says how many whole steps to simulate; what is left
+ * over, as a fraction of a step, is used to blend the last two states
+ * when drawing, so motion stays smooth when frames and steps do not line
+ * up:
+ *
+ *   FixedTimestep timestep( 1.0 / 60.0 );
+ *
+ *   void idle() {
+ *       for ( int n = timestep.advance(); n > 0; n-- ) {
+ *           previous = current;
+ *           simulate( current );          // one step of 1/60 s
+ *       }
+ *       limiter.wait();
+ *       glutPostRedisplay();
+ *   }
+ *
+ *   void display() {
+ *       State s = blend( previous, current, timestep.alpha() );
+ *       ...
+ *
+ * The simulation is the same on every machine, since each step is the
+ * same length.  A FrameLimiter sleeps so that frames are drawn no faster
+ * than a given rate, instead of spinning the CPU at 100%.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+class FixedTimestep {
+
+  typedef std::chrono::steady_clock Clock;
+
+  double            step;           // seconds
+  int               maxSteps;
+  double            frameTime;      // seconds, or 0 for real time
+  double            accumulator;    // seconds not yet simulated
+  bool              started;
+  Clock::time_point last;
+  long              steps;          // taken so far
+
+ public:
+  /**
+   * Creates a timestep of step seconds.  After a long frame (or a stop
+   * in a debugger) at most maxSteps steps are taken at once, and the
+   * rest of the time is dropped, so the simulation slows down instead of
+   * falling further and further behind.
+   */
+  explicit FixedTimestep( double step, int maxSteps = 8 )
+    : step( step ), maxSteps( maxSteps ), frameTime( 0.0 ), accumulator( 0.0 ),
+      started( false ), steps( 0 ) {}
+
+  /**
+   * Makes every frame last seconds instead of the time that really
+   * passed, for runs that must give the same frames every time, such as
+   * headless ones; 0 goes back to real time.
+   */
+  void setFrameTime( double seconds ) { frameTime = seconds; }
+
+  /**
+   * Adds the time since the last call (none on the first call) and
+   * returns the number of steps to simulate now.
+   */
+  int advance() {
+    Clock::time_point now = Clock::now();
+    double elapsed = frameTime;
+    if (elapsed <= 0.0) {
+      elapsed = started ? std::chrono::duration<double>( now - last ).count() : 0.0;
+    }
+    last    = now;
+    started = true;
+
+    accumulator += elapsed;
+    int n = (int) (accumulator / step);
+    accumulator -= n * step;
+    if (n > maxSteps) n = maxSteps;
+    steps += n;
+    return n;
+  }
+
+  /**
+   * Returns how far the time is between the last two steps, from 0 (the
+   * previous state) to 1 (the current one).
+   */
+  double alpha() const { return accumulator / step; }
+
+  /**
+   * Forgets the time since the last call, for instance after the
+   * simulation was paused.
+   */
+  void reset() {
+    started     = false;
+    accumulator = 0.0;
+  }
+
+  double stepSeconds() const { return step; }
+
+  long numSteps() const { return steps; }
+};
+
+/**
+ * Keeps frames from being drawn faster than a given rate by sleeping
+ * until the next frame is due.
+ */
+class FrameLimiter {
+
+  typedef std::chrono::steady_clock Clock;
+
+  Clock::duration   period;         // 0 for no limit
+  Clock::time_point next;
+  bool              started;
+
+ public:
+  /**
+   * Limits frames to fps a second; 0 means no limit (for instance when
+   * vsync already limits them, or to measure how fast frames can go).
+   */
+  explicit FrameLimiter( double fps = 60.0 ) : started( false ) { setRate( fps ); }
+
+  void setRate( double fps ) {
+    period = (fps > 0.0)
+      ? std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( 1.0 / fps ) )
+      : Clock::duration::zero();
+    started = false;
+  }
+
+  /**
+   * Looks for --fps n in argv, removing it, and limits frames to n a
+   * second (0 for no limit).  Returns true if it was found.
+   */
+  bool parseArgs( int& argc, char **argv ) {
+    bool found = false;
+    int  kept = 1;
+    for (int i = 1; i < argc; i++) {
+      if (strcmp( argv[i], "--fps" ) == 0 && i + 1 < argc) {
+        setRate( atof( argv[++i] ) );
+        found = true;
+      } else {
+        argv[kept++] = argv[i];
+      }
+    }
+    argc = kept;
+    argv[argc] = NULL;
+    return found;
+  }
+
+  /**
+   * Sleeps until the next frame is due.  A frame that comes late starts
+   * the schedule over rather than letting the following ones catch up.
+   */
+  void wait() {
+    if (period == Clock::duration::zero()) return;
+    Clock::time_point now = Clock::now();
+    if (!started || now > next + period) {
+      next    = now;
+      started = true;
+    } else if (now < next) {
+      std::this_thread::sleep_until( next );
+    }
+    next += period;
+  }
+};
+
+
+#endif
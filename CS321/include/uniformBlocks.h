@@ -0,0 +1,293 @@
+/*
+ * File: uniformBlocks.h
+ */
+
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+/**
+ * Uniform blocks for the matrices a program's shaders share, instead of
+ * a glUniformMatrix4fv call (and a transpose by the driver) per matrix
+ * per frame.  The shaders declare
+ *
+ *   layout(std140) uniform Frame  { mat4 projection; mat4 view; };
+ *   layout(std140) uniform Object { mat4 objectModel; };
+ *
+ * FrameBlock holds the per-frame block.  The projection and the view are
+ * kept as mat4c (mat.h), stored by columns as std140 lays them out, and
+ * the block is copied to its buffer only when one of them has changed:
+ *
+ *   FrameBlock frameBlock;
+ *   frameBlock.create( program );            // once, with a context
+ *   ...
+ *   frameBlock.setProjection( p );           // in display()
+ *   frameBlock.setView( lookAt );
+ *   frameBlock.upload();                     // does nothing if neither changed
+ *
+ * UniformRing holds the per-object blocks of a frame, one after another,
+ * in a buffer that is mapped once and written directly (persistently
+ * mapped, with ARB_buffer_storage or OpenGL 4.4).  The buffer is split into
+ * a section per frame for the last few frames; before a frame reuses a
+ * section, it waits for the GPU to finish the draws that read it.
+ *
+ *   UniformRing objects;
+ *   objects.create( program, "Object", 64 );   // room for 64 blocks a frame
+ *   ...
+ *   objects.beginFrame();
+ *   ObjectUniforms globe = { mat4c( globeModel ) };
+ *   objects.push( globe );                   // and bind it for the next draw
+ *   glDrawElements...
+ *   objects.endFrame();
+ *
+ * Without buffer storage the blocks are copied with glBufferSubData
+ * instead.  Uniform blocks need OpenGL 3.1 (GLSL 1.40).
+ */
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include <cstddef>
+#include <cstring>
+
+/**
+ * The per-frame block, as laid out by std140.
+ */
+struct FrameUniforms {
+  mat4c projection;
+  mat4c view;
+};
+
+/**
+ * A per-object block holding just a model matrix.
+ */
+struct ObjectUniforms {
+  mat4c model;
+};
+
+//  Binding points used by the blocks below
+enum { FRAME_BLOCK_BINDING = 0, OBJECT_BLOCK_BINDING = 1 };
+
+/**
+ * Returns true if the current context has extension name.
+ */
+inline bool hasGLExtension( const char *name ) {
+  GLint n = 0;
+  glGetIntegerv( GL_NUM_EXTENSIONS, &n );
+  for (GLint i = 0; i < n; i++) {
+    const char *e = (const char *) glGetStringi( GL_EXTENSIONS, i );
+    if (e != NULL && strcmp( e, name ) == 0) return true;
+  }
+  return false;
+}
+
+class FrameBlock {
+
+  GLuint        buffer;
+  GLuint        binding;
+  FrameUniforms uniforms;
+  bool          projectionDirty, viewDirty;
+  int           uploads;           // how many times the block was copied
+
+  FrameBlock( const FrameBlock& );                 // not copyable
+  FrameBlock& operator = ( const FrameBlock& );
+
+ public:
+  FrameBlock()
+    : buffer( 0 ), binding( FRAME_BLOCK_BINDING ), projectionDirty( true ),
+      viewDirty( true ), uploads( 0 ) {}
+
+  /**
+   * Creates the buffer and connects it to the block blockName of
+   * program, at binding point binding.  Needs a current context.
+   */
+  void create( GLuint program, const char *blockName = "Frame",
+               GLuint binding = FRAME_BLOCK_BINDING ) {
+    this->binding = binding;
+    GLuint index = glGetUniformBlockIndex( program, blockName );
+    if (index != GL_INVALID_INDEX) glUniformBlockBinding( program, index, binding );
+    if (buffer == 0) glGenBuffers( 1, &buffer );
+    glBindBuffer( GL_UNIFORM_BUFFER, buffer );
+    glBufferData( GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW );
+    glBindBufferBase( GL_UNIFORM_BUFFER, binding, buffer );
+    projectionDirty = viewDirty = true;
+  }
+
+  void setProjection( const mat4& p ) {
+    mat4c c( p );
+    if (c != uniforms.projection) {
+      uniforms.projection = c;
+      projectionDirty = true;
+    }
+  }
+
+  void setView( const mat4& v ) {
+    mat4c c( v );
+    if (c != uniforms.view) {
+      uniforms.view = c;
+      viewDirty = true;
+    }
+  }
+
+  /**
+   * Copies whatever changed since the last call to the buffer, and binds
+   * it.
+   */
+  void upload() {
+    glBindBufferBase( GL_UNIFORM_BUFFER, binding, buffer );
+    if (!projectionDirty && !viewDirty) return;
+    glBindBuffer( GL_UNIFORM_BUFFER, buffer );
+    if (projectionDirty && viewDirty) {
+      glBufferSubData( GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &uniforms );
+    } else if (projectionDirty) {
+      glBufferSubData( GL_UNIFORM_BUFFER, offsetof( FrameUniforms, projection ),
+                       sizeof(mat4c), &uniforms.projection );
+    } else {
+      glBufferSubData( GL_UNIFORM_BUFFER, offsetof( FrameUniforms, view ),
+                       sizeof(mat4c), &uniforms.view );
+    }
+    projectionDirty = viewDirty = false;
+    uploads++;
+  }
+
+  /**
+   * Returns how many times upload() copied anything.
+   */
+  int numUploads() const { return uploads; }
+
+  void release() {
+    if (buffer != 0) glDeleteBuffers( 1, &buffer );
+    buffer = 0;
+  }
+};
+
+class UniformRing {
+
+  enum { NUM_SECTIONS = 3 };         // frames the GPU may still be reading
+
+  GLuint      buffer;
+  GLuint      binding;
+  GLubyte    *mapped;                // NULL without buffer storage
+  GLsizeiptr  sectionSize;
+  GLint       alignment;             // of block offsets in the buffer
+  int         section;               // the current frame's
+  GLsizeiptr  used;                  // bytes of it
+  GLsync      fences[NUM_SECTIONS];
+
+  UniformRing( const UniformRing& );               // not copyable
+  UniformRing& operator = ( const UniformRing& );
+
+  GLsizeiptr aligned( GLsizeiptr n ) const {
+    return (n + alignment - 1) / alignment * alignment;
+  }
+
+ public:
+  UniformRing()
+    : buffer( 0 ), binding( OBJECT_BLOCK_BINDING ), mapped( NULL ),
+      sectionSize( 0 ), alignment( 256 ), section( 0 ), used( 0 ) {
+    for (int i = 0; i < NUM_SECTIONS; i++) fences[i] = 0;
+  }
+
+  /**
+   * Creates the buffer, with room for maxBlocks blocks of up to
+   * blockSize bytes a frame, for the block blockName of program at
+   * binding point binding.  Needs a current context.
+   */
+  void create( GLuint program, const char *blockName, int maxBlocks,
+               GLsizeiptr blockSize = sizeof(ObjectUniforms),
+               GLuint binding = OBJECT_BLOCK_BINDING ) {
+    this->binding = binding;
+    GLuint index = glGetUniformBlockIndex( program, blockName );
+    if (index != GL_INVALID_INDEX) glUniformBlockBinding( program, index, binding );
+
+    glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment );
+    if (alignment < 16) alignment = 16;
+    sectionSize = maxBlocks * aligned( blockSize );
+    GLsizeiptr size = NUM_SECTIONS * sectionSize;
+
+    glGenBuffers( 1, &buffer );
+    glBindBuffer( GL_UNIFORM_BUFFER, buffer );
+#ifdef GL_MAP_PERSISTENT_BIT
+    if (hasGLExtension( "GL_ARB_buffer_storage" )) {
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      glBufferStorage( GL_UNIFORM_BUFFER, size, NULL, flags );
+      mapped = (GLubyte *) glMapBufferRange( GL_UNIFORM_BUFFER, 0, size, flags );
+      if (mapped == NULL) {            // storage cannot be reallocated: start over
+        glDeleteBuffers( 1, &buffer );
+        glGenBuffers( 1, &buffer );
+        glBindBuffer( GL_UNIFORM_BUFFER, buffer );
+      }
+    }
+#endif
+    if (mapped == NULL) {
+      glBufferData( GL_UNIFORM_BUFFER, size, NULL, GL_STREAM_DRAW );
+    }
+    section = 0;
+    used    = 0;
+  }
+
+  /**
+   * Returns true if the buffer is written through a persistent mapping.
+   */
+  bool persistent() const { return mapped != NULL; }
+
+  /**
+   * Starts a frame's blocks in the next section of the buffer, first
+   * waiting, if need be, for the GPU to finish with it.
+   */
+  void beginFrame() {
+    section = (section + 1) % NUM_SECTIONS;
+    used    = 0;
+    if (fences[section] != 0) {
+      glClientWaitSync( fences[section], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000 );
+      glDeleteSync( fences[section] );
+      fences[section] = 0;
+    }
+  }
+
+  /**
+   * Adds block, of size bytes, to the frame and binds it to the ring's
+   * binding point for the next draws.  Returns false if the frame has no
+   * more room.
+   */
+  bool push( const void *block, GLsizeiptr size ) {
+    if (used + size > sectionSize) return false;
+    GLintptr offset = section * sectionSize + used;
+    if (mapped != NULL) {
+      memcpy( mapped + offset, block, size );
+    } else {
+      glBindBuffer( GL_UNIFORM_BUFFER, buffer );
+      glBufferSubData( GL_UNIFORM_BUFFER, offset, size, block );
+    }
+    glBindBufferRange( GL_UNIFORM_BUFFER, binding, buffer, offset, size );
+    used += aligned( size );
+    return true;
+  }
+
+  template <class Block>
+  bool push( const Block& block ) { return push( &block, sizeof(Block) ); }
+
+  /**
+   * Ends the frame's blocks; the section is not reused until the GPU has
+   * drawn with them.
+   */
+  void endFrame() {
+    if (mapped != NULL) fences[section] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+  }
+
+  void release() {
+    for (int i = 0; i < NUM_SECTIONS; i++) {
+      if (fences[i] != 0) glDeleteSync( fences[i] );
+      fences[i] = 0;
+    }
+    if (buffer != 0) {
+      if (mapped != NULL) {
+        glBindBuffer( GL_UNIFORM_BUFFER, buffer );
+        glUnmapBuffer( GL_UNIFORM_BUFFER );
+      }
+      glDeleteBuffers( 1, &buffer );
+    }
+    buffer = 0;
+    mapped = NULL;
+  }
+};
+
+
+#endif
@@ -8,6 +8,7 @@
 #define __ANGEL_VEC_H__
 
 #include "Angel.h"
+#include "simd.h"
 
 namespace Angel {
 
@@ -15,6 +16,10 @@ namespace Angel {
 //
 //  vec2.h - 2D vector
 //
+//    The constructors of vec2, vec3 and vec4 are constexpr (C++11), so
+//    constant vectors, and the matrices built from them in mat.h, can be
+//    made when the program is compiled.
+//
 
 struct vec2 {
 
@@ -25,14 +30,14 @@ struct vec2 {
     //  --- Constructors and Destructors ---
     //
 
-    vec2( GLfloat s = GLfloat(0.0) ) :
+    constexpr vec2( GLfloat s = GLfloat(0.0) ) :
 	x(s), y(s) {}
 
-    vec2( GLfloat x, GLfloat y ) :
+    constexpr vec2( GLfloat x, GLfloat y ) :
 	x(x), y(y) {}
 
-    vec2( const vec2& v )
-	{ x = v.x;  y = v.y;  }
+    constexpr vec2( const vec2& v ) :
+	x(v.x), y(v.y) {}
 
     //
     //  --- Indexing Operator ---
@@ -164,15 +169,17 @@ struct vec3 {
     //  --- Constructors and Destructors ---
     //
 
-    vec3( GLfloat s = GLfloat(0.0) ) :
+    constexpr vec3( GLfloat s = GLfloat(0.0) ) :
 	x(s), y(s), z(s) {}
 
-    vec3( GLfloat x, GLfloat y, GLfloat z ) :
+    constexpr vec3( GLfloat x, GLfloat y, GLfloat z ) :
 	x(x), y(y), z(z) {}
 
-    vec3( const vec3& v ) { x = v.x;  y = v.y;  z = v.z; }
+    constexpr vec3( const vec3& v ) :
+	x(v.x), y(v.y), z(v.z) {}
 
-    vec3( const vec2& v, const float f ) { x = v.x;  y = v.y;  z = f; }
+    constexpr vec3( const vec2& v, const float f ) :
+	x(v.x), y(v.y), z(f) {}
 
     //
     //  --- Indexing Operator ---
@@ -301,9 +308,12 @@ vec3 cross(const vec3& a, const vec3& b )
 //
 //  vec4 - 4D vector
 //
+//    vec4 is 16-byte aligned so that its arithmetic can use the SIMD
+//    backend selected in simd.h.
+//
 //////////////////////////////////////////////////////////////////////////////
 
-struct vec4 {
+struct ANGEL_ALIGN16 vec4 {
 
     GLfloat  x;
     GLfloat  y;
@@ -314,19 +324,25 @@ struct vec4 {
     //  --- Constructors and Destructors ---
     //
 
-    vec4( GLfloat s = GLfloat(0.0) ) :
+    constexpr vec4( GLfloat s = GLfloat(0.0) ) :
 	x(s), y(s), z(s), w(s) {}
 
-    vec4( GLfloat x, GLfloat y, GLfloat z, GLfloat w ) :
+    constexpr vec4( GLfloat x, GLfloat y, GLfloat z, GLfloat w ) :
 	x(x), y(y), z(z), w(w) {}
 
-    vec4( const vec4& v ) { x = v.x;  y = v.y;  z = v.z;  w = v.w; }
+    constexpr vec4( const vec4& v ) :
+	x(v.x), y(v.y), z(v.z), w(v.w) {}
+
+    constexpr vec4( const vec3& v, const float w = 1.0 ) :
+	x(v.x), y(v.y), z(v.z), w(w) {}
 
-    vec4( const vec3& v, const float w = 1.0 ) : w(w)
-	{ x = v.x;  y = v.y;  z = v.z; }
+    constexpr vec4( const vec2& v, const float z, const float w ) :
+	x(v.x), y(v.y), z(z), w(w) {}
 
-    vec4( const vec2& v, const float z, const float w ) : z(z), w(w)
-	{ x = v.x;  y = v.y; }
+#ifdef ANGEL_SIMD
+    explicit vec4( simd::f4 v )
+	{ simd::store( &x, v ); }
+#endif // ANGEL_SIMD
 
     //
     //  --- Indexing Operator ---
@@ -339,6 +355,22 @@ struct vec4 {
     //  --- (non-modifying) Arithematic Operators ---
     //
 
+#ifdef ANGEL_SIMD
+    vec4 operator - () const  // unary minus operator
+	{ return vec4( simd::neg( simd::load( &x ) ) ); }
+
+    vec4 operator + ( const vec4& v ) const
+	{ return vec4( simd::add( simd::load( &x ), simd::load( &v.x ) ) ); }
+
+    vec4 operator - ( const vec4& v ) const
+	{ return vec4( simd::sub( simd::load( &x ), simd::load( &v.x ) ) ); }
+
+    vec4 operator * ( const GLfloat s ) const
+	{ return vec4( simd::mul( simd::splat( s ), simd::load( &x ) ) ); }
+
+    vec4 operator * ( const vec4& v ) const
+	{ return vec4( simd::mul( simd::load( &x ), simd::load( &v.x ) ) ); }
+#else
     vec4 operator - () const  // unary minus operator
 	{ return vec4( -x, -y, -z, -w ); }
 
@@ -352,7 +384,8 @@ struct vec4 {
 	{ return vec4( s*x, s*y, s*z, s*w ); }
 
     vec4 operator * ( const vec4& v ) const
-	{ return vec4( x*v.x, y*v.y, z*v.z, w*v.z ); }
+	{ return vec4( x*v.x, y*v.y, z*v.z, w*v.w ); }
+#endif // ANGEL_SIMD
 
     friend vec4 operator * ( const GLfloat s, const vec4& v )
 	{ return v * s; }
@@ -374,6 +407,27 @@ struct vec4 {
     //  --- (modifying) Arithematic Operators ---
     //
 
+#ifdef ANGEL_SIMD
+    vec4& operator += ( const vec4& v ) {
+	simd::store( &x, simd::add( simd::load( &x ), simd::load( &v.x ) ) );
+	return *this;
+    }
+
+    vec4& operator -= ( const vec4& v ) {
+	simd::store( &x, simd::sub( simd::load( &x ), simd::load( &v.x ) ) );
+	return *this;
+    }
+
+    vec4& operator *= ( const GLfloat s ) {
+	simd::store( &x, simd::mul( simd::load( &x ), simd::splat( s ) ) );
+	return *this;
+    }
+
+    vec4& operator *= ( const vec4& v ) {
+	simd::store( &x, simd::mul( simd::load( &x ), simd::load( &v.x ) ) );
+	return *this;
+    }
+#else
     vec4& operator += ( const vec4& v )
 	{ x += v.x;  y += v.y;  z += v.z;  w += v.w;  return *this; }
 
@@ -385,6 +439,7 @@ struct vec4 {
 
     vec4& operator *= ( const vec4& v )
 	{ x *= v.x, y *= v.y, z *= v.z, w *= v.w;  return *this; }
+#endif // ANGEL_SIMD
 
     vec4& operator /= ( const GLfloat s ) {
 #ifdef DEBUG
@@ -430,7 +485,7 @@ struct vec4 {
 
 inline
 GLfloat dot( const vec4& u, const vec4& v ) {
-    return u.x*v.x + u.y*v.y + u.z*v.z + u.w+v.w;
+    return u.x*v.x + u.y*v.y + u.z*v.z + u.w*v.w;
 }
 
 inline
@@ -0,0 +1,474 @@
+/*
+ * File: vertexFormat.h
+ */
+
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+/**
+ * Interleaved vertex arrays: all the attributes of a vertex (position,
+ * normal, texture coordinates, color, ...) stored together in one struct,
+ * so a vertex is read from one place in memory both by the CPU code that
+ * builds it and by the GPU's vertex fetch.
+ *
+ * A VertexFormat describes the attributes, each named after the vertex
+ * shader input it feeds, and sets up the matching glVertexAttribPointer
+ * calls.  An InterleavedVertices holds an array of vertices in a format.
+ * The shape generators in holeyShapes.h and bezier.h write their output
+ * through Strided arrays, so they can fill one attribute of an
+ * interleaved array directly:
+ *
+ *   VertexFormat format;
+ *   format.add( "vPosition", 4, GL_FLOAT ).add( "vColor", 4, GL_FLOAT );
+ *   InterleavedVertices vertices( format, numVertices );
+ *   cube( vertices.attribute<point4>( "vPosition" ), 0, indices, 0 );
+ *   randomColors( numVertices, vertices.attribute<color4>( "vColor" ), 0 );
+ *   glBufferData( GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW );
+ *   format.enable( program );
+ *
+ * Attributes can also be stored in compact types: colors as 4 normalized
+ * GL_UNSIGNED_BYTEs, normals as GL_INT_2_10_10_10_REV, positions as 3
+ * GL_FLOATs (the shader still sees w = 1) or as GL_HALF_FLOATs.  The
+ * generators write full-precision point4, vec3 and color4 values, so
+ * vertices are built in a float format and then packed into the compact
+ * one with convertVertices(), which converts each attribute by name:
+ *
+ *   VertexFormat compact;
+ *   compact.add( "vPosition", 3, GL_FLOAT )
+ *          .add( "vColor", 4, GL_UNSIGNED_BYTE, GL_TRUE );
+ *   InterleavedVertices packed( compact, numVertices );
+ *   convertVertices( vertices, packed );
+ */
+
+#include "/usr/people/classes/CS321/include/Angel.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef point4
+typedef Angel::vec4 point4;
+#endif
+
+/**
+ * An array of T whose elements are stride bytes apart: one attribute of an
+ * interleaved vertex array, or an ordinary array when stride is sizeof(T).
+ * A pointer to T converts to a Strided array, so functions that take
+ * Strided arrays can still be given ordinary arrays, or NULL.
+ */
+template <class T>
+class Strided {
+  char   *base;
+  size_t  step;
+
+ public:
+  Strided( T *array = NULL ) : base( (char *) array ), step( sizeof(T) ) {}
+  Strided( void *first, size_t stride ) : base( (char *) first ), step( stride ) {}
+
+  T& operator [] ( int i ) const { return *(T *) (base + i * step); }
+
+  // the array starting i elements later
+  Strided operator + ( int i ) const { return Strided( base + i * step, step ); }
+
+  // only meaningful against NULL
+  bool operator == ( const T *p ) const { return base == (const char *) p; }
+  bool operator != ( const T *p ) const { return base != (const char *) p; }
+
+  size_t stride() const { return step; }
+};
+
+/**
+ * Returns true for the packed types, which hold all 4 components of an
+ * attribute in one 32-bit word.
+ */
+inline bool
+isPackedVertexType( GLenum type ) {
+  return type == GL_INT_2_10_10_10_REV || type == GL_UNSIGNED_INT_2_10_10_10_REV;
+}
+
+/**
+ * The number of bytes in one component of an attribute of type type;
+ * for the packed types, the size of the whole attribute.
+ */
+inline GLsizei
+vertexComponentBytes( GLenum type ) {
+  switch (type) {
+  case GL_BYTE:  case GL_UNSIGNED_BYTE:                   return 1;
+  case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT: return 2;
+  case GL_DOUBLE:                                         return 8;
+  default:                                                return 4;
+  }
+}
+
+//----------------------------------------------------------------------------
+//
+//  Conversions between floats and the compact types
+//
+
+/**
+ * Returns f as a 16-bit half float, rounded to nearest even;
+ * values too large for a half become infinity.
+ */
+inline GLushort
+floatToHalf( GLfloat f ) {
+  GLuint bits;
+  memcpy( &bits, &f, sizeof(bits) );
+  GLuint sign     = (bits >> 16) & 0x8000;
+  GLint  exponent = (GLint) ((bits >> 23) & 0xff) - 127 + 15;
+  GLuint mantissa = bits & 0x7fffff;
+
+  if (((bits >> 23) & 0xff) == 0xff) {              // infinity or NaN
+    return (GLushort) (sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+  }
+  if (exponent >= 31) return (GLushort) (sign | 0x7c00);   // overflow
+  if (exponent <= 0) {                              // subnormal or zero
+    if (exponent < -10) return (GLushort) sign;
+    mantissa |= 0x800000;
+    int shift = 14 - exponent;
+    GLuint half = mantissa >> shift;
+    GLuint rest = mantissa & ((1u << shift) - 1);
+    GLuint halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1))) half++;
+    return (GLushort) (sign | half);
+  }
+  GLuint half = sign | (exponent << 10) | (mantissa >> 13);
+  GLuint rest = mantissa & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;  // may carry into exponent
+  return (GLushort) half;
+}
+
+/**
+ * Returns the float value of the half float h.
+ */
+inline GLfloat
+halfToFloat( GLushort h ) {
+  GLuint sign     = (GLuint) (h & 0x8000) << 16;
+  GLuint exponent = (h >> 10) & 0x1f;
+  GLuint mantissa = h & 0x3ff;
+  GLuint bits;
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {                                          // subnormal
+    GLfloat f = mantissa / 16777216.0f;             // mantissa * 2^-24
+    return sign ? -f : f;
+  }
+  GLfloat f;
+  memcpy( &f, &bits, sizeof(f) );
+  return f;
+}
+
+/**
+ * Returns x, clamped to [-1, 1], as a signed normalized integer of the
+ * given number of bits, as OpenGL converts them back (c / (2^(bits-1) - 1)).
+ */
+inline GLint
+floatToSnorm( GLfloat x, int bits ) {
+  GLfloat scale = (GLfloat) ((1 << (bits - 1)) - 1);
+  if (x > 1.0) x = 1.0;
+  if (x < -1.0) x = -1.0;
+  return (GLint) floor( x * scale + 0.5 );
+}
+
+/**
+ * Returns x, clamped to [0, 1], as an unsigned normalized integer of the
+ * given number of bits.
+ */
+inline GLuint
+floatToUnorm( GLfloat x, int bits ) {
+  GLfloat scale = (GLfloat) ((1u << bits) - 1);
+  if (x > 1.0) x = 1.0;
+  if (x < 0.0) x = 0.0;
+  return (GLuint) floor( x * scale + 0.5 );
+}
+
+/**
+ * Stores the first size components of v at dest in the given type,
+ * normalizing integers if normalized is true; for the packed types all
+ * 4 components are stored.  This is the inverse of what OpenGL does when
+ * it fetches the attribute.
+ */
+inline void
+storeVertexAttribute( void *dest, GLint size, GLenum type, GLboolean normalized,
+                      const GLfloat v[4] ) {
+  if (isPackedVertexType( type )) {
+    GLuint word;
+    if (type == GL_INT_2_10_10_10_REV) {
+      GLint c[4];
+      for (int i = 0; i < 3; i++) {
+        c[i] = normalized ? floatToSnorm( v[i], 10 ) : (GLint) floor( v[i] + 0.5 );
+      }
+      c[3] = normalized ? floatToSnorm( v[3], 2 ) : (GLint) floor( v[3] + 0.5 );
+      word = (c[0] & 0x3ff) | (c[1] & 0x3ff) << 10 | (c[2] & 0x3ff) << 20 |
+             (GLuint) (c[3] & 0x3) << 30;
+    } else {
+      GLuint c[4];
+      for (int i = 0; i < 3; i++) {
+        c[i] = normalized ? floatToUnorm( v[i], 10 ) : (GLuint) floor( v[i] + 0.5 );
+      }
+      c[3] = normalized ? floatToUnorm( v[3], 2 ) : (GLuint) floor( v[3] + 0.5 );
+      word = (c[0] & 0x3ff) | (c[1] & 0x3ff) << 10 | (c[2] & 0x3ff) << 20 |
+             (c[3] & 0x3) << 30;
+    }
+    memcpy( dest, &word, sizeof(word) );
+    return;
+  }
+
+  for (int i = 0; i < size; i++) {
+    switch (type) {
+    case GL_FLOAT:
+      ((GLfloat *) dest)[i] = v[i];
+      break;
+    case GL_HALF_FLOAT:
+      ((GLushort *) dest)[i] = floatToHalf( v[i] );
+      break;
+    case GL_UNSIGNED_BYTE:
+      ((GLubyte *) dest)[i] = normalized ? floatToUnorm( v[i], 8 ) : (GLubyte) v[i];
+      break;
+    case GL_BYTE:
+      ((GLbyte *) dest)[i] = normalized ? floatToSnorm( v[i], 8 ) : (GLbyte) v[i];
+      break;
+    case GL_UNSIGNED_SHORT:
+      ((GLushort *) dest)[i] = normalized ? floatToUnorm( v[i], 16 ) : (GLushort) v[i];
+      break;
+    case GL_SHORT:
+      ((GLshort *) dest)[i] = normalized ? floatToSnorm( v[i], 16 ) : (GLshort) v[i];
+      break;
+    }
+  }
+}
+
+/**
+ * Loads an attribute stored by storeVertexAttribute() into v, as the
+ * vertex shader would see it: missing components are (0, 0, 0, 1).
+ */
+inline void
+loadVertexAttribute( const void *src, GLint size, GLenum type, GLboolean normalized,
+                     GLfloat v[4] ) {
+  v[0] = v[1] = v[2] = 0.0;
+  v[3] = 1.0;
+  if (isPackedVertexType( type )) {
+    GLuint word;
+    memcpy( &word, src, sizeof(word) );
+    for (int i = 0; i < 4; i++) {
+      int    bits = (i < 3) ? 10 : 2;
+      GLuint c    = (word >> (10 * i)) & ((1u << bits) - 1);
+      if (type == GL_INT_2_10_10_10_REV) {
+        GLint sc = (c & (1u << (bits - 1))) ? (GLint) c - (1 << bits) : (GLint) c;
+        v[i] = normalized ? std::max( sc / (GLfloat) ((1 << (bits - 1)) - 1), -1.0f )
+                          : (GLfloat) sc;
+      } else {
+        v[i] = normalized ? c / (GLfloat) ((1u << bits) - 1) : (GLfloat) c;
+      }
+    }
+    return;
+  }
+
+  for (int i = 0; i < size; i++) {
+    switch (type) {
+    case GL_FLOAT:
+      v[i] = ((const GLfloat *) src)[i];
+      break;
+    case GL_HALF_FLOAT:
+      v[i] = halfToFloat( ((const GLushort *) src)[i] );
+      break;
+    case GL_UNSIGNED_BYTE:
+      v[i] = ((const GLubyte *) src)[i] / (normalized ? 255.0f : 1.0f);
+      break;
+    case GL_BYTE:
+      v[i] = ((const GLbyte *) src)[i];
+      if (normalized) v[i] = std::max( v[i] / 127.0f, -1.0f );
+      break;
+    case GL_UNSIGNED_SHORT:
+      v[i] = ((const GLushort *) src)[i] / (normalized ? 65535.0f : 1.0f);
+      break;
+    case GL_SHORT:
+      v[i] = ((const GLshort *) src)[i];
+      if (normalized) v[i] = std::max( v[i] / 32767.0f, -1.0f );
+      break;
+    }
+  }
+}
+
+/**
+ * The layout of an interleaved vertex.
+ */
+class VertexFormat {
+ public:
+  struct Attribute {
+    std::string name;        // the vertex shader input
+    GLint       size;        // number of components, 1 ... 4
+    GLenum      type;        // GL_FLOAT, GL_UNSIGNED_BYTE, ...
+    GLboolean   normalized;  // whether integers are mapped to [0, 1] or [-1, 1]
+    GLsizei     offset;      // bytes from the start of the vertex
+    GLsizei     bytes;
+  };
+
+ private:
+  std::vector<Attribute> attributes;
+  GLsizei                vertexBytes;
+  GLsizei                vertexAlign;   // largest attribute alignment
+
+ public:
+  VertexFormat() : vertexBytes( 0 ), vertexAlign( 1 ) {}
+
+  /**
+   * Adds an attribute after the ones already added, and returns this
+   * format, so that calls can be chained.  Each attribute is aligned to its
+   * component size (4 bytes for the packed types, whose size must be 4),
+   * and 16-byte attributes (point4, color4) to 16 bytes, so they can be
+   * written as vec4s.
+   */
+  VertexFormat& add( const char *name, GLint size, GLenum type = GL_FLOAT,
+                     GLboolean normalized = GL_FALSE ) {
+    Attribute a;
+    a.name       = name;
+    a.size       = size;
+    a.type       = type;
+    a.normalized = normalized;
+    a.bytes      = isPackedVertexType( type ) ? 4 : size * vertexComponentBytes( type );
+    GLsizei align = (a.bytes >= 16) ? 16 : vertexComponentBytes( type );
+    a.offset     = (vertexBytes + align - 1) / align * align;
+    vertexBytes  = a.offset + a.bytes;
+    if (align > vertexAlign) vertexAlign = align;
+    attributes.push_back( a );
+    return *this;
+  }
+
+  /**
+   * Returns the number of bytes from one vertex to the next: the size of
+   * the attributes, rounded up to the largest alignment of any of them
+   * (and at least 4, as OpenGL prefers) so that every vertex keeps the
+   * alignment of the first.
+   */
+  GLsizei stride() const {
+    GLsizei align = vertexAlign > 4 ? vertexAlign : 4;
+    return (vertexBytes + align - 1) / align * align;
+  }
+
+  int numAttributes() const { return (int) attributes.size(); }
+
+  const Attribute& attribute( int i ) const { return attributes[i]; }
+
+  /**
+   * Returns the index of the attribute with the given name, or -1.
+   */
+  int find( const char *name ) const {
+    for (size_t i = 0; i < attributes.size(); i++) {
+      if (attributes[i].name == name) return (int) i;
+    }
+    return -1;
+  }
+
+  /**
+   * Points the vertex shader inputs of program at the attributes of
+   * vertices stored in the GL_ARRAY_BUFFER currently bound, beginning at
+   * bufferOffset bytes, and enables them.  Attributes that program does
+   * not use are skipped.
+   */
+  void enable( GLuint program, GLsizeiptr bufferOffset = 0 ) const {
+    for (size_t i = 0; i < attributes.size(); i++) {
+      const Attribute& a = attributes[i];
+      GLint location = glGetAttribLocation( program, a.name.c_str() );
+      if (location < 0) continue;
+      glEnableVertexAttribArray( location );
+      glVertexAttribPointer( location, a.size, a.type, a.normalized, stride(),
+                             BUFFER_OFFSET(bufferOffset + a.offset) );
+    }
+  }
+};
+
+/**
+ * An array of vertices in one VertexFormat, 16-byte aligned.
+ */
+class InterleavedVertices {
+  VertexFormat  layout;
+  int           count;
+  point4       *storage;
+
+  InterleavedVertices( const InterleavedVertices& );             // not copyable
+  InterleavedVertices& operator = ( const InterleavedVertices& );
+
+ public:
+  /**
+   * Creates an array of numVertices vertices, all zero.
+   */
+  InterleavedVertices( const VertexFormat& format, int numVertices )
+    : layout( format ), count( numVertices ) {
+    size_t blocks = ((size_t) numVertices * format.stride() + 15) / 16;
+    storage = new point4[blocks > 0 ? blocks : 1];      // point4() is zero
+  }
+
+  ~InterleavedVertices() { delete [] storage; }
+
+  /**
+   * Returns the attribute with the given name as a Strided array of T,
+   * or a NULL array if the format has no such attribute.  T should be the
+   * type the attribute is stored as, such as point4 for 4 GL_FLOATs.
+   */
+  template <class T>
+  Strided<T> attribute( const char *name ) const {
+    int i = layout.find( name );
+    if (i < 0) return Strided<T>();
+    return Strided<T>( (char *) storage + layout.attribute( i ).offset, layout.stride() );
+  }
+
+  const VertexFormat& format() const { return layout; }
+
+  int numVertices() const { return count; }
+
+  const GLvoid *data() const { return storage; }
+
+  /**
+   * The size of the vertices in bytes, for glBufferData.
+   */
+  GLsizeiptr size() const { return (GLsizeiptr) count * layout.stride(); }
+
+  /**
+   * Stores v, converted to the attribute's type, as attribute a of
+   * vertex i.
+   */
+  void set( int a, int i, const vec4& v ) {
+    const VertexFormat::Attribute& attr = layout.attribute( a );
+    GLfloat value[4] = { v.x, v.y, v.z, v.w };
+    storeVertexAttribute( (char *) storage + (size_t) i * layout.stride() + attr.offset,
+                          attr.size, attr.type, attr.normalized, value );
+  }
+
+  /**
+   * Returns attribute a of vertex i as the vertex shader sees it.
+   */
+  vec4 get( int a, int i ) const {
+    const VertexFormat::Attribute& attr = layout.attribute( a );
+    GLfloat value[4];
+    loadVertexAttribute( (const char *) storage + (size_t) i * layout.stride() + attr.offset,
+                         attr.size, attr.type, attr.normalized, value );
+    return vec4( value[0], value[1], value[2], value[3] );
+  }
+};
+
+/**
+ * Copies the vertices of from into to, which must have at least as many,
+ * converting each attribute of to from the attribute of from with the
+ * same name; attributes of to that from does not have are left alone.
+ * A packed attribute takes its 2-bit w from the source's fourth component,
+ * which is 1 for a 3-component source; shaders that read the attribute as
+ * a vec3, as they do normals, ignore it.
+ */
+inline void
+convertVertices( const InterleavedVertices& from, InterleavedVertices& to ) {
+  const VertexFormat& format = to.format();
+  for (int a = 0; a < format.numAttributes(); a++) {
+    int source = from.format().find( format.attribute( a ).name.c_str() );
+    if (source < 0) continue;
+    for (int i = 0; i < from.numVertices(); i++) {
+      to.set( a, i, from.get( source, i ) );
+    }
+  }
+}
+
+
+#endif